@@ -11,6 +11,8 @@ struct Material
     sampler2D diffuse;
     sampler2D specular;
     float shininess;
+    vec3 diffuseColor;
+    vec3 specularColor;
 };
 
 struct Light
@@ -26,21 +28,24 @@ uniform Material material;
 
 void main()
 {
+    // Diffuse map tinted by the colour of the material
+    vec3 albedo = material.diffuseColor * texture(material.diffuse, fragCoord).rgb;
+
     // Ambient
-    vec3 ambientColor = ambient * texture(material.diffuse, fragCoord).rgb;
+    vec3 ambientColor = ambient * albedo;
 
     // Diffuse
     vec3 lightDir = normalize(light.position - fragPos);
 	float diffscalar = max(dot(fragNormal, lightDir), 0.0);
     
-    vec3 diffuseColor = light.diffuse * (diffscalar * texture(material.diffuse, fragCoord).rgb);
+    vec3 diffuseColor = light.diffuse * (diffscalar * albedo);
 
     // Specular
     vec3 viewDir = normalize(-fragPos);
 	vec3 reflectDir = reflect(-lightDir, fragNormal);
 	float specscalar = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
 
-    vec3 specularColor = light.specular * (specscalar * texture(material.specular, fragCoord).rgb);
+    vec3 specularColor = light.specular * (specscalar * material.specularColor * texture(material.specular, fragCoord).rgb);
 
 	// Resulting Phong shading
     outColor = vec4(ambientColor + diffuseColor + specularColor, 1.0);
@@ -0,0 +1,41 @@
+#version 450
+
+in vec3 position;
+in vec2 texCoord;
+in vec2 normal;
+
+out vec2 fragCoord;
+out vec3 fragPos;
+out vec3 fragNormal;
+
+struct Decode
+{
+    vec3 positionOffset;
+    vec3 positionScale;
+    vec2 texCoordOffset;
+    vec2 texCoordScale;
+};
+
+uniform mat4 mvpMatrix;
+uniform mat4 viewSpaceMatrix;
+uniform mat3 normalViewSpaceMatrix;
+uniform Decode decode;
+
+// Unfolds the octahedral encoded normal
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    vec3 pos = decode.positionOffset + position * decode.positionScale;
+
+    gl_Position = mvpMatrix * vec4(pos, 1.0);
+	fragPos = vec3(viewSpaceMatrix * vec4(pos, 1.0));
+	fragNormal = normalize(normalViewSpaceMatrix * octDecode(normal));
+	fragCoord = decode.texCoordOffset + texCoord * decode.texCoordScale;
+}
\ No newline at end of file
@@ -40,26 +40,28 @@ void application::updateLogic()
 
 	// Main logic
 	static int state = 0;
-	// Show a loading screen
+	// Show a loading screen and start loading the models, their placeholders take the settings right away
 	if (state == 0) {
 		gfx.setFontSize(64);
 		_texts.emplace_back(gfx.loadText("LOADING", 0.0f, 0.0f, anchor::center));
 		gfx.setFontSize();
-		state = 1;
-	}
-	// Load the models
-	else if (state == 1) {
-		_models.emplace_back(gfx.loadModel("chair"));
-		_pmodels.emplace_back(gfx.loadPlaneModel("cube"));
+
+		_models.emplace_back(gfx.loadModelAsync("chair"));
+		_pmodels.emplace_back(gfx.loadPlaneModelAsync("cube"));
 
 		glm::vec3 lightPos = { 10.f, 10.f, 10.f };
-		_pmodels.back()->modelMatrix = glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(0.3f, 0.3f, 0.3f)), glm::vec3(lightPos));
+		_pmodels.back()->setModelMatrix(glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(0.3f, 0.3f, 0.3f)), glm::vec3(lightPos)));
 		_models.back()->material.shininess = 64.0f;
 		gfx.setLightPos(lightPos);
 		gfx.setDiffuseColor(glm::vec3(1.0f, 1.0f, 1.0f));
 		gfx.setspecularColor(glm::vec3(1.0f, 1.0f, 1.0f));
 
-		state = 2;
+		state = 1;
+	}
+	// Keep rendering while the loader threads read the files, render() uploads them as they finish
+	else if (state == 1) {
+		if (!gfx.loading())
+			state = 2;
 	}
 	// Make the light cube orbit around the regular cube and display the fps
 	else {
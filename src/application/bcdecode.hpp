@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace game::bc
+{
+    /*
+     * Decoders for the block compressed formats img2tex writes, used when the driver cannot sample a format
+     * itself. Every function decodes one 4x4 block into 64 bytes of RGBA, rows top to bottom.
+     */
+
+    inline void unpack565(uint16_t c, uint8_t *rgb)
+    {
+        auto r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        rgb[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+        rgb[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+        rgb[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+    }
+
+    // The color part of BC1 and BC3, BC3 always uses four colors
+    inline void decodeColor(const uint8_t *block, uint8_t *rgba, bool alwaysFour)
+    {
+        uint16_t c0 = block[0] | block[1] << 8, c1 = block[2] | block[3] << 8;
+        uint8_t palette[4][4] = {};
+        unpack565(c0, palette[0]);
+        unpack565(c1, palette[1]);
+        palette[0][3] = palette[1][3] = 255;
+
+        if (c0 > c1 || alwaysFour) {
+            for (auto c = 0; c < 3; ++c) {
+                palette[2][c] = static_cast<uint8_t>((2*palette[0][c] + palette[1][c] + 1) / 3);
+                palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2*palette[1][c] + 1) / 3);
+            }
+            palette[2][3] = palette[3][3] = 255;
+        }
+        else {
+            for (auto c = 0; c < 3; ++c)
+                palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+            palette[2][3] = 255;
+        }
+
+        uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | uint32_t(block[7]) << 24;
+        for (auto i = 0; i < 16; ++i)
+            std::memcpy(rgba + i*4, palette[(indices >> (2*i)) & 3], 4);
+    }
+
+    inline void decodeBC1(const uint8_t *block, uint8_t *rgba)
+    {
+        decodeColor(block, rgba, false);
+    }
+
+    inline void decodeBC3(const uint8_t *block, uint8_t *rgba)
+    {
+        decodeColor(block + 8, rgba, true);
+
+        uint8_t palette[8] = {block[0], block[1]};
+        if (palette[0] > palette[1]) {
+            for (auto i = 1; i < 7; ++i)
+                palette[i+1] = static_cast<uint8_t>(((7-i)*palette[0] + i*palette[1] + 3) / 7);
+        }
+        else {
+            for (auto i = 1; i < 5; ++i)
+                palette[i+1] = static_cast<uint8_t>(((5-i)*palette[0] + i*palette[1] + 2) / 5);
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+
+        uint64_t indices = 0;
+        for (auto i = 0; i < 6; ++i)
+            indices |= uint64_t(block[2+i]) << (8*i);
+        for (auto i = 0; i < 16; ++i)
+            rgba[i*4+3] = palette[(indices >> (3*i)) & 7];
+    }
+
+    constexpr uint8_t bc7Weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    // Reads the bits of a 128 bit block from the least significant bit up
+    struct bitReader
+    {
+        const uint8_t *block;
+
+        unsigned position = 0;
+
+        unsigned read(unsigned count)
+        {
+            unsigned value = 0;
+            for (unsigned i = 0; i < count; ++i, ++position)
+                value |= ((block[position >> 3] >> (position & 7)) & 1u) << i;
+            return value;
+        }
+    };
+
+    constexpr uint8_t bc7Weights2[4] = {0, 21, 43, 64};
+
+    inline uint8_t bc7Interpolate(uint8_t e0, uint8_t e1, uint8_t w)
+    {
+        return static_cast<uint8_t>(((64-w)*e0 + w*e1 + 32) >> 6);
+    }
+
+    // Mode 5 keeps alpha on its own line, rotation swaps alpha with one of the color channels
+    inline void decodeBC7Mode5(const uint8_t *block, uint8_t *rgba)
+    {
+        bitReader bits = {block, 6};
+        auto rotation = bits.read(2);
+
+        uint8_t endpoints[2][4];
+        for (auto c = 0; c < 3; ++c) {
+            for (auto e = 0; e < 2; ++e) {
+                auto v = bits.read(7);
+                endpoints[e][c] = static_cast<uint8_t>(v << 1 | v >> 6);
+            }
+        }
+        endpoints[0][3] = static_cast<uint8_t>(bits.read(8));
+        endpoints[1][3] = static_cast<uint8_t>(bits.read(8));
+
+        for (auto i = 0; i < 16; ++i) {
+            auto w = bc7Weights2[bits.read(i == 0 ? 1 : 2)];
+            for (auto c = 0; c < 3; ++c)
+                rgba[i*4+c] = bc7Interpolate(endpoints[0][c], endpoints[1][c], w);
+        }
+        for (auto i = 0; i < 16; ++i)
+            rgba[i*4+3] = bc7Interpolate(endpoints[0][3], endpoints[1][3], bc7Weights2[bits.read(i == 0 ? 1 : 2)]);
+
+        if (rotation) {
+            for (auto i = 0; i < 16; ++i)
+                std::swap(rgba[i*4+3], rgba[i*4+rotation-1]);
+        }
+    }
+
+    // Mode 6 puts all four channels on one line with 4 bit indices
+    inline void decodeBC7Mode6(const uint8_t *block, uint8_t *rgba)
+    {
+        bitReader bits = {block, 7};
+        uint8_t endpoints[2][4];
+        for (auto c = 0; c < 4; ++c) {
+            endpoints[0][c] = static_cast<uint8_t>(bits.read(7) << 1);
+            endpoints[1][c] = static_cast<uint8_t>(bits.read(7) << 1);
+        }
+        auto p0 = bits.read(1), p1 = bits.read(1);
+        for (auto c = 0; c < 4; ++c) {
+            endpoints[0][c] |= p0;
+            endpoints[1][c] |= p1;
+        }
+
+        for (auto i = 0; i < 16; ++i) {
+            auto w = bc7Weights4[bits.read(i == 0 ? 3 : 4)];
+            for (auto c = 0; c < 4; ++c)
+                rgba[i*4+c] = bc7Interpolate(endpoints[0][c], endpoints[1][c], w);
+        }
+    }
+
+    // Only modes 5 and 6 are decoded, the modes img2tex writes. Other modes decode to transparent black
+    inline void decodeBC7(const uint8_t *block, uint8_t *rgba)
+    {
+        if ((block[0] & 0x7F) == 0x40)
+            decodeBC7Mode6(block, rgba);
+        else if ((block[0] & 0x3F) == 0x20)
+            decodeBC7Mode5(block, rgba);
+        else
+            std::memset(rgba, 0, 64);
+    }
+}
\ No newline at end of file
@@ -9,7 +9,12 @@ namespace game
     {
 		using planeModelInfo = typename opengl::ShaderInfo<opengl::ShaderType::PLANE_TEXTURED>;
 
+		// Loading packs the vertices of float meshes, which is only worth it when they were converted with obj2msh -q
+#ifdef USE_PACKED_VERTICES
+		using modelInfo = typename opengl::ShaderInfo<opengl::ShaderType::PHONG_PACKED>;
+#else
 		using modelInfo = typename opengl::ShaderInfo<opengl::ShaderType::PHONG_TEXTURED>;
+#endif
 
 		using textInfo = typename opengl::ShaderInfo<opengl::ShaderType::TEXT>;
 
@@ -24,7 +29,7 @@ namespace game
 		using anchor = typename textInfo::text::anchor;
 
         graphics(float width, float height)
-			: _modelPipeline(modelInfo::shaderName), _pmodelPipeline(planeModelInfo::shaderName), _textPipeline(textInfo::shaderName, width, height)
+			: _staging(stagingSize), _modelPipeline(modelInfo::shaderName, modelInfo::fragmentName), _pmodelPipeline(planeModelInfo::shaderName), _textPipeline(textInfo::shaderName, width, height)
 		{
 			// Setup OpenGL
 			glEnable(GL_DEPTH_TEST);
@@ -51,6 +56,16 @@ namespace game
 
 		void render()
 		{
+			// The mesh reads queued since the last frame go to the kernel at once, finished ones are handed to the
+			// loader threads
+			_reader.submit();
+			_reader.poll();
+
+			// Models that finished loading get their buffers and textures before they are drawn
+			opengl::uploadBudget budget(uploadBytes, uploadSeconds);
+			_modelPipeline.finishLoads(budget);
+			_pmodelPipeline.finishLoads(budget);
+
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 			_modelPipeline.render(proj, view);
 			_pmodelPipeline.render(proj, view);
@@ -69,6 +84,29 @@ namespace game
 			return planeModel(&_pmodelPipeline, _pmodelPipeline.loadModel(name));
 		}
 
+		// The model draws nothing until its files are read, decoded by a loader thread and uploaded by render()
+		model loadModelAsync(std::string_view name)
+		{
+			return model(&_modelPipeline, _modelPipeline.loadModelAsync(name, _loader, _reader));
+		}
+
+		planeModel loadPlaneModelAsync(std::string_view name)
+		{
+			return planeModel(&_pmodelPipeline, _pmodelPipeline.loadModelAsync(name, _loader, _reader));
+		}
+
+		// Bytes and stalls of every upload since the start, the ring is stagingSize bytes
+		const opengl::stagingBuffer::statistics& uploadStats() const
+		{
+			return _staging.stats();
+		}
+
+		// Whether any model is still waiting for its files or its upload
+		bool loading() const
+		{
+			return _modelPipeline.loading() || _pmodelPipeline.loading();
+		}
+
 		text loadText(std::string_view txt, float xpos, float ypos, anchor attachPos = anchor::bottomLeft)
 		{
 			return text(&_textPipeline, _textPipeline.loadText(txt, xpos, ypos, attachPos));
@@ -101,8 +139,24 @@ namespace game
 
 		glm::mat4 proj, view;
 
+		// Upload budget of loaded models per frame, about 1 GB/s and an eighth of a 60 Hz frame
+		size_t uploadBytes = 16 << 20;
+
+		double uploadSeconds = 0.002;
+
+		// Four frames of the upload budget, so the ring rarely has to wait for the GPU
+		static constexpr GLsizeiptr stagingSize = 64 << 20;
+
     private:
 
+		// The loader jobs queue reads, so the reader outlives them
+		native::asyncReader _reader;
+
+		jobQueue _loader;
+
+		// Goes before the pipelines, their fonts and models are uploaded through it
+		opengl::stagingBuffer _staging;
+
 		typename modelInfo::pipeline _modelPipeline;
 
 		typename planeModelInfo::pipeline _pmodelPipeline;
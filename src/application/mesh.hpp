@@ -1,14 +1,32 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
 #include <string>
 #include <vector>
 #include <fstream>
 #include <type_traits>
 #include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include "base/filemap.hpp"
+#include "application/meshcodec.hpp"
 
 namespace game
 {
+    /*
+     * Version 1 files are a header with both counts followed by the raw vertex and index arrays. Version 2 files
+     * start with a fileHeader and a directory of sections, every section starts on a 64 byte boundary.
+     *
+     * Indices are relative to the baseVertex of the submesh they belong to, a mesh without a submesh table is a
+     * single submesh with base vertex 0. The index section stores either 16 or 32 bit indices.
+     *
+     * The vertex and index sections may be compressed with the mesh codec, size is then the compressed size while
+     * count and stride still describe the decoded array. Compressed sections are decoded into the heap on load.
+     */
+
     struct meshfile
     {
         struct header
@@ -18,6 +36,151 @@ namespace game
             unsigned long long indexCount;
         };
 
+        static constexpr char magic[4] = {'M', 'S', 'H', '\0'};
+
+        static constexpr uint32_t version = 2;
+
+        static constexpr uint64_t alignment = 64;
+
+        enum class sectionType : uint32_t { vertices = 1, indices = 2, bounds = 3, lods = 4, submeshes = 5, meshlets = 6,
+            materials = 7 };
+
+        enum class sectionEncoding : uint32_t { raw = 0, codec = 1 };
+
+        // unorm16x3 is stored as four 16 bit values to keep the next attribute 4 byte aligned
+        enum class attribFormat : uint8_t { none = 0, float2 = 1, float3 = 2, unorm16x3 = 3, unorm16x2 = 4, octSnorm16 = 5 };
+
+        struct fileHeader
+        {
+            char magic[4];
+
+            uint32_t version;
+
+            uint32_t sectionCount;
+
+            uint32_t flags;
+
+            uint64_t fileSize;
+
+            uint64_t reserved;
+        };
+
+        // Describes how the attributes of a vertex section are stored and how to decode them
+        struct vertexLayout
+        {
+            attribFormat position, texcoord, normal, color;
+
+            uint32_t stride;
+
+            float positionOffset[3], positionScale[3];
+
+            float texcoordOffset[2], texcoordScale[2];
+
+            uint32_t reserved[4];
+        };
+
+        // Entry in the section directory, count elements of stride bytes are stored in size bytes at offset
+        struct section
+        {
+            sectionType type;
+
+            sectionEncoding encoding;
+
+            uint64_t offset;
+
+            uint64_t size;
+
+            uint64_t count;
+
+            uint32_t stride;
+
+            uint32_t reserved[3];
+
+            vertexLayout layout;
+
+            uint32_t padding[4];
+        };
+
+        struct boundingVolume
+        {
+            glm::vec3 min, max;
+
+            glm::vec3 center;
+
+            float radius;
+        };
+
+        // Simplified index range of a submesh, error is the rms quadric error of its collapses in object space units
+        struct lod
+        {
+            uint64_t indexOffset;
+
+            uint64_t indexCount;
+
+            float error;
+
+            uint32_t submesh;
+        };
+
+        struct submesh
+        {
+            uint64_t indexOffset;
+
+            uint64_t indexCount;
+
+            uint32_t baseVertex;
+
+            uint32_t vertexCount;
+
+            uint32_t material;
+
+            uint32_t reserved;
+        };
+
+        /*
+         * Cluster of at most 64 vertices and 124 triangles of the full detail index range of a submesh. The normal
+         * cone allows back face culling of the whole cluster: it faces away from a camera at p when
+         * dot(center - p, coneAxis) >= coneCutoff*length(center - p) + radius. A cutoff of 1 never culls.
+         */
+
+        struct meshlet
+        {
+            uint64_t indexOffset;
+
+            uint32_t indexCount;
+
+            uint32_t submesh;
+
+            glm::vec3 center;
+
+            float radius;
+
+            glm::vec3 coneAxis;
+
+            float coneCutoff;
+        };
+
+        // Material referenced by submesh::material, the map names are relative to the model directory and empty when absent
+        struct material
+        {
+            char name[64];
+
+            char diffuseMap[64];
+
+            char specularMap[64];
+
+            float diffuse[3];
+
+            float specular[3];
+
+            float shininess;
+
+            uint32_t reserved;
+        };
+
+        static_assert(sizeof(fileHeader) == 32 && sizeof(vertexLayout) == 64 && sizeof(section) == 128 && sizeof(meshlet) == 48
+            && sizeof(material) == 224, "Unexpected file struct padding");
+
         struct vertexData
         {
             bool operator==(const vertexData& rhs) const
@@ -37,152 +200,519 @@ namespace game
             glm::vec3 normal;
         };
 
+        /*
+         * Quantized vertex, half the size of vertexData. The position and texcoord are unorm16 within the bounds
+         * stored in the layout (offset + value*scale), the normal is octahedral encoded as two snorm16 values.
+         */
+
+        struct packedVertex
+        {
+            glm::u16vec4 position;
+
+            glm::u16vec2 texcoord;
+
+            glm::i16vec2 normal;
+        };
+
+        static_assert(sizeof(packedVertex) == 16, "Unexpected packedVertex padding");
+
         meshfile()
-            : head({0, 0}), data(nullptr), indices(nullptr)
+            : head({0, 0}), layout(defaultLayout()), data(nullptr), packed(nullptr), indices(nullptr),
+            shortIndices(nullptr)
         {
         }
 
-        meshfile(std::string_view path)
+        enum class loadMode { read, map };
+
+        /*
+         * Reads both version 1 and version 2 files. In map mode the file is mapped into memory and the arrays
+         * point straight into the mapping, so the only CPU side copy of the mesh is the one in the page cache.
+         * Depending on the vertex layout of the file either data or packed is set, see pack() and unpack().
+         */
+
+        meshfile(std::string_view path, loadMode mode = loadMode::read)
+            : meshfile()
         {
-            std::ifstream in(path.data(), std::ifstream::in | std::ifstream::binary);
+            if (mode == loadMode::map) {
+                _mapping = native::fileMapping(path);
+                _view = {_mapping.data(), _mapping.size()};
+                load(nullptr, _mapping.data(), _mapping.size());
+                return;
+            }
+
+            std::ifstream in(path.data(), std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
             if (!in.is_open())
                 throw std::runtime_error("unable to open model file");
-            
-            in.read(reinterpret_cast<char*>(&head), sizeof(head));
-            data = new vertexData[head.dataCount];
-            indices = new unsigned int[head.indexCount];
 
-            in.read(reinterpret_cast<char*>(data), head.dataCount*sizeof(vertexData));
-            in.read(reinterpret_cast<char*>(indices), head.indexCount*sizeof(unsigned int));
+            uint64_t fileSize = in.tellg();
+            in.seekg(0, std::ifstream::beg);
+            load(&in, nullptr, fileSize);
 
+            if (!in)
+                throw std::runtime_error("unable to read model file");
             in.close();
         }
 
+        // Loads a file that is already in memory in place, like map mode. The memory has to outlive the meshfile
+        meshfile(const char *memory, size_t size)
+            : meshfile()
+        {
+            _view = {memory, size};
+            load(nullptr, memory, size);
+        }
+
         meshfile(const meshfile& rhs)
+            : meshfile()
         {
-            if (rhs.head.dataCount) {
-                data = new vertexData[rhs.head.dataCount];
-                indices = new unsigned int[rhs.head.indexCount];
-                std::copy(rhs.data, rhs.data+rhs.head.dataCount, data);
-                std::copy(rhs.indices, rhs.indices+rhs.head.indexCount, indices);
-            }
-            else {
-                head = {0, 0};
-                data = nullptr;
-                indices = nullptr;
-            }
+            *this = rhs;
         }
 
         meshfile(meshfile&& rhs) noexcept
+            : meshfile()
         {
-            head = rhs.head;
-            rhs.head = {0, 0};
-            data = rhs.data;
-            rhs.data = nullptr;
-            indices = rhs.indices;
-            rhs.indices = nullptr;
+            *this = std::move(rhs);
         }
 
         ~meshfile()
         {
-            delete[] data;
-            delete[] indices;
+            release();
         }
 
+        // The copy always lives on the heap
         meshfile& operator=(const meshfile& rhs)
         {
-            if (head.dataCount != rhs.head.dataCount) {
-                head.dataCount = rhs.head.dataCount;
-                delete[] data;
-                data = new vertexData[head.dataCount];
-            }
-            std::copy(rhs.data, rhs.data+head.dataCount, data);
+            if (this == &rhs)
+                return *this;
+            release();
+            _mapping = native::fileMapping();
+            _view = {};
 
-            if (head.indexCount != rhs.head.indexCount) {
-                head.indexCount = rhs.head.indexCount;
-                delete[] indices;
-                indices = new unsigned int[head.indexCount];
-            }
-            std::copy(rhs.indices, rhs.indices+head.indexCount, indices);
+            head = rhs.head;
+            layout = rhs.layout;
+            data = copyArray(rhs.data, head.dataCount);
+            packed = copyArray(rhs.packed, head.dataCount);
+            indices = copyArray(rhs.indices, head.indexCount);
+            shortIndices = copyArray(rhs.shortIndices, head.indexCount);
+
+            bounds = rhs.bounds;
+            lods = rhs.lods;
+            submeshes = rhs.submeshes;
+            meshlets = rhs.meshlets;
+            materials = rhs.materials;
             return *this;
         }
 
         meshfile& operator=(meshfile&& rhs) noexcept
         {
             assert(this != &rhs);
-            delete[] data;
-            delete[] indices;
+            release();
+            _mapping = std::move(rhs._mapping);
+            _view = rhs._view;
+            rhs._view = {};
 
-            head.dataCount = rhs.head.dataCount;
-            head.indexCount = rhs.head.indexCount;
+            head = rhs.head;
             data = rhs.data;
+            packed = rhs.packed;
             indices = rhs.indices;
+            shortIndices = rhs.shortIndices;
             
-            rhs.head.dataCount = 0;
-            rhs.head.indexCount = 0;
+            rhs.head = {0, 0};
             rhs.data = nullptr;
+            rhs.packed = nullptr;
             rhs.indices = nullptr;
+            rhs.shortIndices = nullptr;
+
+            layout = rhs.layout;
+            bounds = std::move(rhs.bounds);
+            lods = std::move(rhs.lods);
+            submeshes = std::move(rhs.submeshes);
+            meshlets = std::move(rhs.meshlets);
+            materials = std::move(rhs.materials);
             return *this;
         }
 
-        void toFile(std::string_view path)
+        bool mapped() const
+        {
+            return _view.data() != nullptr;
+        }
+
+        // Writes a version 2 file, the optional tables only get a section when they are not empty
+        void toFile(std::string_view path, bool compress = false)
         {
+            struct pending
+            {
+                section s;
+
+                const void *src;
+            };
+            std::vector<pending> sections;
+            std::vector<std::vector<uint8_t>> encoded;
+
+            auto add = [&](sectionType type, const void *src, uint64_t count, uint32_t stride) {
+                section s = {};
+                s.type = type;
+                s.count = count;
+                s.stride = stride;
+                s.size = count*stride;
+                sections.push_back({s, src});
+                return &sections.back().s;
+            };
+
+            if (packed)
+                add(sectionType::vertices, packed, head.dataCount, sizeof(packedVertex))->layout = layout;
+            else
+                add(sectionType::vertices, data, head.dataCount, sizeof(vertexData))->layout = defaultLayout();
+            if (shortIndices)
+                add(sectionType::indices, shortIndices, head.indexCount, sizeof(unsigned short));
+            else
+                add(sectionType::indices, indices, head.indexCount, sizeof(unsigned int));
+            if (!bounds.empty())
+                add(sectionType::bounds, bounds.data(), bounds.size(), sizeof(boundingVolume));
+            if (!lods.empty())
+                add(sectionType::lods, lods.data(), lods.size(), sizeof(lod));
+            if (!submeshes.empty())
+                add(sectionType::submeshes, submeshes.data(), submeshes.size(), sizeof(submesh));
+            if (!meshlets.empty())
+                add(sectionType::meshlets, meshlets.data(), meshlets.size(), sizeof(meshlet));
+            if (!materials.empty())
+                add(sectionType::materials, materials.data(), materials.size(), sizeof(material));
+
+            // Only the vertices and indices are worth compressing, the tables are small
+            if (compress) {
+                encoded.reserve(2);
+                for (auto& p : sections) {
+                    if (p.s.type == sectionType::vertices)
+                        encoded.push_back(meshcodec::encodeVertices(p.src, p.s.count, p.s.stride));
+                    else if (p.s.type == sectionType::indices && p.s.stride == sizeof(unsigned short))
+                        encoded.push_back(meshcodec::encodeIndices(static_cast<const unsigned short*>(p.src), p.s.count));
+                    else if (p.s.type == sectionType::indices)
+                        encoded.push_back(meshcodec::encodeIndices(static_cast<const unsigned int*>(p.src), p.s.count));
+                    else
+                        continue;
+
+                    // Unordered indices can come out larger, those sections stay raw
+                    if (encoded.back().size() >= p.s.size)
+                        continue;
+
+                    p.s.encoding = sectionEncoding::codec;
+                    p.s.size = encoded.back().size();
+                    p.src = encoded.back().data();
+                }
+            }
+
+            // Lay out the sections after the directory
+            auto offset = align(sizeof(fileHeader) + sections.size()*sizeof(section));
+            for (auto& p : sections) {
+                p.s.offset = offset;
+                offset = align(offset + p.s.size);
+            }
+
+            fileHeader fh = {};
+            std::copy(magic, magic+sizeof(magic), fh.magic);
+            fh.version = version;
+            fh.sectionCount = static_cast<uint32_t>(sections.size());
+            fh.fileSize = offset;
+
             std::ofstream out(path.data(), std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
-            
-            out.write(reinterpret_cast<char*>(&head), sizeof(head));
-            out.write(reinterpret_cast<char*>(data), head.dataCount * sizeof(vertexData));
-            out.write(reinterpret_cast<char*>(indices), head.indexCount * sizeof(unsigned int));
+            if (!out.is_open())
+                throw std::runtime_error("unable to create model file");
+
+            out.write(reinterpret_cast<const char*>(&fh), sizeof(fh));
+            for (const auto& p : sections)
+                out.write(reinterpret_cast<const char*>(&p.s), sizeof(section));
+
+            const char zeros[alignment] = {};
+            for (const auto& p : sections) {
+                out.write(zeros, p.s.offset - out.tellp());
+                out.write(reinterpret_cast<const char*>(p.src), p.s.size);
+            }
+            out.write(zeros, offset - out.tellp());
 
             out.close();
         }
 
+        static constexpr uint64_t align(uint64_t offset)
+        {
+            return (offset + alignment-1) & ~(alignment-1);
+        }
+
+        // The layout of vertexData, used by version 1 files
+        static vertexLayout defaultLayout()
+        {
+            vertexLayout out = {};
+            out.position = attribFormat::float3;
+            out.texcoord = attribFormat::float2;
+            out.normal = attribFormat::float3;
+            out.stride = sizeof(vertexData);
+            out.positionScale[0] = out.positionScale[1] = out.positionScale[2] = 1.0f;
+            out.texcoordScale[0] = out.texcoordScale[1] = 1.0f;
+            return out;
+        }
+
+        // The layout of packedVertex, quantized against the bounds of the given vertices
+        static vertexLayout packedLayout(const vertexData *vertices, size_t count)
+        {
+            vertexLayout out = {};
+            out.position = attribFormat::unorm16x3;
+            out.texcoord = attribFormat::unorm16x2;
+            out.normal = attribFormat::octSnorm16;
+            out.stride = sizeof(packedVertex);
+            if (count == 0)
+                return out;
+
+            auto pmin = vertices[0].position, pmax = vertices[0].position;
+            auto tmin = vertices[0].texcoord, tmax = vertices[0].texcoord;
+            for (size_t i = 1; i < count; ++i) {
+                pmin = glm::min(pmin, vertices[i].position);
+                pmax = glm::max(pmax, vertices[i].position);
+                tmin = glm::min(tmin, vertices[i].texcoord);
+                tmax = glm::max(tmax, vertices[i].texcoord);
+            }
+
+            for (auto i = 0; i < 3; ++i) {
+                out.positionOffset[i] = pmin[i];
+                out.positionScale[i] = pmax[i] - pmin[i];
+            }
+            for (auto i = 0; i < 2; ++i) {
+                out.texcoordOffset[i] = tmin[i];
+                out.texcoordScale[i] = tmax[i] - tmin[i];
+            }
+            return out;
+        }
+
+        /*
+         * Bounding box and sphere of count positions, position(i) returns the i-th one. The sphere is the smaller of
+         * the one around the box center and the one grown by Ritter's method from the two most distant points.
+         */
+
+        template<class Position>
+        static boundingVolume boundsOf(size_t count, Position position)
+        {
+            boundingVolume out = {};
+            if (count == 0)
+                return out;
+
+            out.min = out.max = position(0);
+            for (size_t i = 1; i < count; ++i) {
+                out.min = glm::min(out.min, position(i));
+                out.max = glm::max(out.max, position(i));
+            }
+            out.center = (out.min + out.max) * 0.5f;
+            for (size_t i = 0; i < count; ++i)
+                out.radius = std::max(out.radius, glm::distance(out.center, position(i)));
+
+            auto farthest = [&](const glm::vec3& from) {
+                size_t best = 0;
+                auto distance = -1.0f;
+                for (size_t i = 0; i < count; ++i) {
+                    auto d = glm::distance(from, position(i));
+                    if (d > distance) {
+                        distance = d;
+                        best = i;
+                    }
+                }
+                return position(best);
+            };
+            auto a = farthest(position(0)), b = farthest(a);
+            auto center = (a + b) * 0.5f;
+            auto radius = glm::distance(a, b) * 0.5f;
+            for (size_t i = 0; i < count; ++i) {
+                auto p = position(i);
+                auto d = glm::distance(center, p);
+                if (d > radius) {
+                    radius = (radius + d) * 0.5f;
+                    center = p + (center - p) * (radius / d);
+                }
+            }
+
+            if (radius < out.radius) {
+                out.center = center;
+                out.radius = radius;
+            }
+            return out;
+        }
+
+        // Fills bounds with the volume of the whole mesh followed by one per submesh, from the vertices it indexes
+        void computeBounds()
+        {
+            auto position = [this](size_t i) {
+                return data ? data[i].position : unpackVertex(packed[i], layout).position;
+            };
+
+            bounds.clear();
+            bounds.push_back(boundsOf(head.dataCount, position));
+            for (const auto& r : submeshes) {
+                bounds.push_back(boundsOf(r.indexCount, [&](size_t i) {
+                    return position(r.baseVertex + index(r.indexOffset + i));
+                }));
+            }
+        }
+
+        static packedVertex packVertex(const vertexData& v, const vertexLayout& l)
+        {
+            packedVertex out;
+            out.position = glm::u16vec4(toUnorm16(v.position.x, l.positionOffset[0], l.positionScale[0]),
+                toUnorm16(v.position.y, l.positionOffset[1], l.positionScale[1]),
+                toUnorm16(v.position.z, l.positionOffset[2], l.positionScale[2]), 0);
+            out.texcoord = glm::u16vec2(toUnorm16(v.texcoord.x, l.texcoordOffset[0], l.texcoordScale[0]),
+                toUnorm16(v.texcoord.y, l.texcoordOffset[1], l.texcoordScale[1]));
+            out.normal = octEncode(v.normal);
+            return out;
+        }
+
+        static vertexData unpackVertex(const packedVertex& v, const vertexLayout& l)
+        {
+            vertexData out;
+            for (auto i = 0; i < 3; ++i)
+                out.position[i] = l.positionOffset[i] + v.position[i] / 65535.0f * l.positionScale[i];
+            for (auto i = 0; i < 2; ++i)
+                out.texcoord[i] = l.texcoordOffset[i] + v.texcoord[i] / 65535.0f * l.texcoordScale[i];
+            out.normal = octDecode(v.normal);
+            return out;
+        }
+
+        /*
+         * Octahedral normal encoding: the normal is projected onto the octahedron |x|+|y|+|z| = 1 and the lower
+         * half is folded over the upper one. Of the four possible roundings the one closest to the normal is used.
+         */
+
+        static glm::i16vec2 octEncode(const glm::vec3& n)
+        {
+            auto l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+            if (l1 == 0.0f)
+                return glm::i16vec2(0, 0);
+
+            glm::vec2 p(n.x / l1, n.y / l1);
+            if (n.z < 0.0f) {
+                p = glm::vec2((1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+                    (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+            }
+
+            auto normal = n / std::sqrt(glm::dot(n, n));
+            glm::i16vec2 best(0, 0);
+            auto bestDot = -2.0f;
+            for (auto i = 0; i < 4; ++i) {
+                auto x = (i & 1) ? std::ceil(p.x * 32767.0f) : std::floor(p.x * 32767.0f);
+                auto y = (i & 2) ? std::ceil(p.y * 32767.0f) : std::floor(p.y * 32767.0f);
+                glm::i16vec2 candidate(static_cast<int16_t>(std::clamp(x, -32767.0f, 32767.0f)),
+                    static_cast<int16_t>(std::clamp(y, -32767.0f, 32767.0f)));
+
+                auto d = glm::dot(octDecode(candidate), normal);
+                if (d > bestDot) {
+                    bestDot = d;
+                    best = candidate;
+                }
+            }
+            return best;
+        }
+
+        static glm::vec3 octDecode(const glm::i16vec2& e)
+        {
+            glm::vec3 n(std::max(e.x / 32767.0f, -1.0f), std::max(e.y / 32767.0f, -1.0f), 0.0f);
+            n.z = 1.0f - std::abs(n.x) - std::abs(n.y);
+
+            auto t = std::max(-n.z, 0.0f);
+            n.x += n.x >= 0.0f ? -t : t;
+            n.y += n.y >= 0.0f ? -t : t;
+            return n / std::sqrt(glm::dot(n, n));
+        }
+
+        // Quantizes data into packed, the layout gets the bounds to decode them. Files are written packed from then on
+        void pack()
+        {
+            if (packed || !data)
+                return;
+
+            layout = packedLayout(data, head.dataCount);
+            packed = new packedVertex[head.dataCount];
+            for (size_t i = 0; i < head.dataCount; ++i)
+                packed[i] = packVertex(data[i], layout);
+        }
+
+        // Decodes the quantized vertices into full precision ones, the layout still describes packed
+        void unpack()
+        {
+            if (data || !packed)
+                return;
+
+            data = new vertexData[head.dataCount];
+            for (size_t i = 0; i < head.dataCount; ++i)
+                data[i] = unpackVertex(packed[i], layout);
+        }
+
         template<class VIO>
         static constexpr bool sameVIO()
         {
-            return (VIO::positionTrait && !VIO::colorTrait && VIO::texCoordTrait && VIO::normalTrait);
+            return (VIO::positionTrait && !VIO::colorTrait && VIO::texCoordTrait && VIO::normalTrait)
+                && VIO::positionFormat::file == attribFormat::float3 && VIO::texCoordFormat::file == attribFormat::float2
+                && VIO::normalFormat::file == attribFormat::float3;
+        }
+
+        template<class VIO>
+        static constexpr bool samePackedVIO()
+        {
+            return (VIO::positionTrait && !VIO::colorTrait && VIO::texCoordTrait && VIO::normalTrait)
+                && VIO::positionFormat::file == attribFormat::unorm16x3 && VIO::texCoordFormat::file == attribFormat::unorm16x2
+                && VIO::normalFormat::file == attribFormat::octSnorm16 && sizeof(VIO) == sizeof(packedVertex);
         }
 
+        // Packs or unpacks the vertices first when the VIO needs the other representation
         template<class VIO>
         void toVertexInputObject(std::vector<VIO>& out, bool indexed = true)
         {
-            out.reserve(head.dataCount);
+            constexpr auto isPacked = [](attribFormat f) {
+                return f == attribFormat::unorm16x3 || f == attribFormat::unorm16x2 || f == attribFormat::octSnorm16;
+            };
+            constexpr auto anyPacked = isPacked(VIO::positionFormat::file) || isPacked(VIO::texCoordFormat::file)
+                || isPacked(VIO::normalFormat::file);
+            constexpr auto anyFloat = (VIO::positionTrait && !isPacked(VIO::positionFormat::file))
+                || (VIO::texCoordTrait && !isPacked(VIO::texCoordFormat::file)) || (VIO::normalTrait && !isPacked(VIO::normalFormat::file));
 
-            if (indexed) {
-                for (auto i = 0; i < head.dataCount; ++i) {
-                    VIO vio;
+            if (anyPacked && !packed)
+                pack();
+            if (anyFloat && !data)
+                unpack();
+
+            auto convert = [&](size_t i) {
+                VIO vio;
 
-                    if constexpr (VIO::positionTrait)
+                if constexpr (VIO::positionTrait) {
+                    if constexpr (isPacked(VIO::positionFormat::file))
+                        vio.inputPosition = packed[i].position;
+                    else
                         vio.inputPosition = data[i].position;
-                    
-                    if constexpr (VIO::colorTrait)
-                        vio.inputColor = glm::vec3(0.0f, 1.0f, 0.0f);
+                }
+                
+                if constexpr (VIO::colorTrait)
+                    vio.inputColor = glm::vec3(0.0f, 1.0f, 0.0f);
 
-                    if constexpr (VIO::texCoordTrait)
+                if constexpr (VIO::texCoordTrait) {
+                    if constexpr (isPacked(VIO::texCoordFormat::file))
+                        vio.inputTexCoord = packed[i].texcoord;
+                    else
                         vio.inputTexCoord = data[i].texcoord;
-                    
-                    if constexpr (VIO::normalTrait)
+                }
+                
+                if constexpr (VIO::normalTrait) {
+                    if constexpr (isPacked(VIO::normalFormat::file))
+                        vio.inputNormal = packed[i].normal;
+                    else
                         vio.inputNormal = data[i].normal;
-
-                    out.push_back(vio);
                 }
-            }
-            else {
-                for (auto i = 0; i < head.indexCount; ++i) {
-                    VIO vio;
 
-                    if constexpr (VIO::positionTrait)
-                        vio.inputPosition = data[indices[i]].position;
-                    
-                    if constexpr (VIO::colorTrait)
-                        vio.inputColor = glm::vec3(0.0f, 1.0f, 0.0f);
+                return vio;
+            };
 
-                    if constexpr (VIO::texCoordTrait)
-                        vio.inputTexCoord = data[indices[i]].texcoord;
-                    
-                    if constexpr (VIO::normalTrait)
-                        vio.inputNormal = data[indices[i]].normal;
-
-                    out.push_back(vio);
+            if (indexed) {
+                out.reserve(head.dataCount);
+                for (size_t i = 0; i < head.dataCount; ++i)
+                    out.push_back(convert(i));
+            }
+            else {
+                out.reserve(head.indexCount);
+                for (const auto& r : ranges()) {
+                    for (auto i = r.indexOffset; i < r.indexOffset + r.indexCount; ++i)
+                        out.push_back(convert(r.baseVertex + index(i)));
                 }
             }
         }
@@ -197,15 +727,325 @@ namespace game
         void toVertexIndex(std::vector<VI>& out)
         {
             out.reserve(head.indexCount);
-            for (auto i = 0; i < head.indexCount; ++i) {
-                out.push_back(indices[i]);
+            for (size_t i = 0; i < head.indexCount; ++i) {
+                out.push_back(index(i));
             }
         }
 
+        uint32_t index(size_t i) const
+        {
+            return shortIndices ? shortIndices[i] : indices[i];
+        }
+
+        // The submesh table, or the whole mesh as a single submesh when there is none
+        std::vector<submesh> ranges() const
+        {
+            if (!submeshes.empty())
+                return submeshes;
+
+            auto count = head.indexCount;
+            for (const auto& l : lods)
+                count = std::min<uint64_t>(count, l.indexOffset);
+            return {{0, count, 0, static_cast<uint32_t>(head.dataCount), 0, 0}};
+        }
+
+        /*
+         * The lod table holds one entry per submesh for every level after the full detail one, level by level.
+         * Returns the number of levels including the full detail one.
+         */
+
+        size_t lodLevels() const
+        {
+            return 1 + lods.size() / ranges().size();
+        }
+
+        /*
+         * Converts the indices to 16 bit when every submesh fits, returns whether shortIndices is set afterwards.
+         * Files are written with 16 bit indices from then on.
+         */
+
+        bool narrowIndices()
+        {
+            if (shortIndices)
+                return true;
+            if (!indices)
+                return false;
+
+            auto fits = [this](uint64_t offset, uint64_t count) {
+                return count == 0 || *std::max_element(indices + offset, indices + offset + count) <= 0xFFFF;
+            };
+            for (const auto& r : ranges()) {
+                if (!fits(r.indexOffset, r.indexCount))
+                    return false;
+            }
+            for (const auto& l : lods) {
+                if (!fits(l.indexOffset, l.indexCount))
+                    return false;
+            }
+
+            shortIndices = new unsigned short[head.indexCount];
+            std::copy(indices, indices+head.indexCount, shortIndices);
+            return true;
+        }
+
         header head;
 
+        vertexLayout layout;                    // Layout of the vertices as stored, only differs from the default when packed
+
         vertexData *data;
 
+        packedVertex *packed;
+
         unsigned int *indices;
+
+        unsigned short *shortIndices;
+
+        std::vector<boundingVolume> bounds;     // The whole mesh, followed by every submesh
+
+        std::vector<lod> lods;
+
+        std::vector<submesh> submeshes;
+
+        std::vector<meshlet> meshlets;
+
+        std::vector<material> materials;
+
+    private:
+
+        static uint16_t toUnorm16(float value, float offset, float scale)
+        {
+            auto n = scale > 0.0f ? (value - offset) / scale : 0.0f;
+            return static_cast<uint16_t>(std::lround(std::clamp(n, 0.0f, 1.0f) * 65535.0f));
+        }
+
+        template<class T>
+        static T * copyArray(const T *src, size_t count)
+        {
+            if (!src)
+                return nullptr;
+            auto out = new T[count];
+            std::copy(src, src+count, out);
+            return out;
+        }
+
+        // Arrays either point into the mapped or external memory or were allocated on the heap
+        bool inMapping(const void *p) const
+        {
+            auto base = reinterpret_cast<uintptr_t>(_view.data()), address = reinterpret_cast<uintptr_t>(p);
+            return base && address >= base && address < base + _view.size();
+        }
+
+        template<class T>
+        void release(T *&p)
+        {
+            if (!inMapping(p))
+                delete[] p;
+            p = nullptr;
+        }
+
+        void release()
+        {
+            release(data);
+            release(packed);
+            release(indices);
+            release(shortIndices);
+        }
+
+        template<class T>
+        static void checkTable(const section& s)
+        {
+            if (s.stride != sizeof(T) || (s.encoding == sectionEncoding::raw && s.size != s.count*sizeof(T)))
+                throw std::runtime_error("corrupt model file");
+        }
+
+        // Reads from the stream when there is no mapping, otherwise the arrays are pointed into the mapping
+        void load(std::istream *in, const char *mapping, uint64_t fileSize)
+        {
+            auto read = [&](uint64_t offset, void *dst, uint64_t size) {
+                if (size > fileSize || offset > fileSize - size)
+                    throw std::runtime_error("corrupt model file");
+                if (mapping) {
+                    std::copy(mapping+offset, mapping+offset+size, static_cast<char*>(dst));
+                }
+                else {
+                    in->seekg(offset, std::ifstream::beg);
+                    in->read(static_cast<char*>(dst), size);
+                }
+            };
+
+            fileHeader fh = {};
+            read(0, &fh, std::min<uint64_t>(sizeof(fh), fileSize));
+
+            if (fileSize >= sizeof(fh) && std::equal(magic, magic+sizeof(magic), fh.magic)) {
+                if (fh.version != version)
+                    throw std::runtime_error("unsupported model file version");
+
+                // The directory has to fit in the file before anything is allocated for it
+                if (sizeof(fh) + uint64_t(fh.sectionCount) * sizeof(section) > fileSize)
+                    throw std::runtime_error("corrupt model file");
+                std::vector<section> dir(fh.sectionCount);
+                read(sizeof(fh), dir.data(), dir.size()*sizeof(section));
+
+                for (const auto& s : dir) {
+                    if (s.size > fileSize || s.offset > fileSize - s.size || s.offset % alignment)
+                        throw std::runtime_error("corrupt model file");
+                    readSection(s, read, mapping);
+                }
+
+                for (const auto& r : submeshes) {
+                    if (r.indexOffset + r.indexCount > head.indexCount || uint64_t(r.baseVertex) + r.vertexCount > head.dataCount
+                        || (!materials.empty() && r.material >= materials.size()))
+                        throw std::runtime_error("corrupt model file");
+                }
+
+                if (!bounds.empty() && bounds.size() != 1 + submeshes.size())
+                    throw std::runtime_error("corrupt model file");
+
+                auto rangeCount = ranges().size();
+                for (const auto& m : meshlets) {
+                    if (m.submesh >= rangeCount || m.indexOffset + m.indexCount > head.indexCount)
+                        throw std::runtime_error("corrupt model file");
+                }
+
+                if (lods.size() % rangeCount)
+                    throw std::runtime_error("corrupt model file");
+                for (size_t i = 0; i < lods.size(); ++i) {
+                    if (lods[i].submesh != i % rangeCount || lods[i].indexOffset + lods[i].indexCount > head.indexCount)
+                        throw std::runtime_error("corrupt model file");
+                }
+            }
+            else {
+                read(0, &head, sizeof(head));
+                auto dsize = head.dataCount*sizeof(vertexData), isize = head.indexCount*sizeof(unsigned int);
+                if (sizeof(head) + dsize + isize != fileSize)
+                    throw std::runtime_error("corrupt model file");
+
+                if (mapping) {
+                    data = reinterpret_cast<vertexData*>(const_cast<char*>(mapping) + sizeof(head));
+                    indices = reinterpret_cast<unsigned int*>(const_cast<char*>(mapping) + sizeof(head) + dsize);
+                }
+                else {
+                    data = new vertexData[head.dataCount];
+                    indices = new unsigned int[head.indexCount];
+                    read(sizeof(head), data, dsize);
+                    read(sizeof(head) + dsize, indices, isize);
+                }
+            }
+        }
+
+        template<class T, class Read>
+        static T * sectionArray(const section& s, Read&& read, const char *mapping)
+        {
+            if (s.encoding == sectionEncoding::codec)
+                return decodeSection<T>(s, read, mapping);
+
+            if (mapping)
+                return reinterpret_cast<T*>(const_cast<char*>(mapping) + s.offset);
+
+            auto out = new T[s.count];
+            read(s.offset, out, s.size);
+            return out;
+        }
+
+        // Compressed sections are decoded straight from the mapping when there is one
+        template<class T, class Read>
+        static T * decodeSection(const section& s, Read&& read, const char *mapping)
+        {
+            std::vector<uint8_t> buffer;
+            auto src = reinterpret_cast<const uint8_t*>(mapping + s.offset);
+            if (!mapping) {
+                buffer.resize(s.size);
+                read(s.offset, buffer.data(), s.size);
+                src = buffer.data();
+            }
+
+            auto out = new T[s.count];
+            try {
+                if constexpr (std::is_integral_v<T>)
+                    meshcodec::decodeIndices(src, s.size, out, s.count);
+                else
+                    meshcodec::decodeVertices(src, s.size, out, s.count, sizeof(T));
+            }
+            catch (...) {
+                delete[] out;
+                throw;
+            }
+            return out;
+        }
+
+        template<class Read>
+        void readSection(const section& s, Read&& read, const char *mapping)
+        {
+            auto table = [&](auto& out) {
+                checkTable<typename std::decay_t<decltype(out)>::value_type>(s);
+                out.resize(s.count);
+                read(s.offset, out.data(), s.size);
+            };
+
+            auto compressible = s.type == sectionType::vertices || s.type == sectionType::indices;
+            if (s.encoding != sectionEncoding::raw && (s.encoding != sectionEncoding::codec || !compressible))
+                throw std::runtime_error("unsupported section encoding");
+
+            switch (s.type) {
+            case sectionType::vertices: {
+                auto sameFormats = [&s](const vertexLayout& l) {
+                    return s.layout.position == l.position && s.layout.texcoord == l.texcoord && s.layout.normal == l.normal
+                        && s.layout.color == l.color && s.layout.stride == l.stride;
+                };
+
+                if (sameFormats(defaultLayout())) {
+                    checkTable<vertexData>(s);
+                    release(data);
+                    data = sectionArray<vertexData>(s, read, mapping);
+                }
+                else if (sameFormats(packedLayout(nullptr, 0))) {
+                    checkTable<packedVertex>(s);
+                    release(packed);
+                    packed = sectionArray<packedVertex>(s, read, mapping);
+                }
+                else {
+                    throw std::runtime_error("unsupported vertex layout");
+                }
+                head.dataCount = s.count;
+                layout = s.layout;
+                break;
+            }
+            case sectionType::indices:
+                if (s.stride == sizeof(unsigned short)) {
+                    checkTable<unsigned short>(s);
+                    release(shortIndices);
+                    shortIndices = sectionArray<unsigned short>(s, read, mapping);
+                }
+                else {
+                    checkTable<unsigned int>(s);
+                    release(indices);
+                    indices = sectionArray<unsigned int>(s, read, mapping);
+                }
+                head.indexCount = s.count;
+                break;
+            case sectionType::bounds:
+                table(bounds);
+                break;
+            case sectionType::lods:
+                table(lods);
+                break;
+            case sectionType::submeshes:
+                table(submeshes);
+                break;
+            case sectionType::meshlets:
+                table(meshlets);
+                break;
+            case sectionType::materials:
+                table(materials);
+                break;
+            default:
+                // Sections written by newer converters are skipped
+                break;
+            }
+        }
+
+        native::fileMapping _mapping;
+
+        std::string_view _view;
     };
 }
\ No newline at end of file
@@ -0,0 +1,377 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace game::meshcodec
+{
+    /*
+     * Lossless codecs for the vertex and index sections of mesh files.
+     *
+     * Vertices are split in blocks of 256. Every 32 bit word of a vertex is replaced by the zigzag encoded
+     * difference with the same word of the previous vertex, after which the bytes are transposed into one plane
+     * per byte of the vertex. Coherent vertices give planes that are mostly zero or small, every group of 16
+     * bytes of a plane is stored with 0, 2, 4 or 8 bits per byte as chosen by a 2 bit header.
+     *
+     * Triangles are coded against a FIFO of the last 8 edges and a FIFO of the last 6 new vertices: a triangle
+     * that shares an edge with a recent one costs a single byte holding the edge, the rotation of the triangle and
+     * where the third vertex comes from (the next unused vertex, the vertex FIFO or an explicit varint). Other
+     * triangles code their three vertices the same way. The triangles and their rotation are kept exactly.
+     */
+
+    namespace detail
+    {
+        constexpr size_t blockVertices = 256;
+
+        constexpr size_t groupSize = 16;
+
+        constexpr size_t edgeFifo = 8;
+
+        constexpr size_t vertexFifo = 6;
+
+        inline void corrupt()
+        {
+            throw std::runtime_error("corrupt model file");
+        }
+
+        inline uint32_t zigzag(uint32_t d)
+        {
+            return (d << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(d) >> 31);
+        }
+
+        inline uint32_t unzigzag(uint32_t z)
+        {
+            return (z >> 1) ^ (0u - (z & 1));
+        }
+
+        inline void encodeGroup(const uint8_t *bytes, std::vector<uint8_t>& out, uint8_t& mode)
+        {
+            auto largest = *std::max_element(bytes, bytes + groupSize);
+            mode = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+
+            if (mode == 1) {
+                for (size_t i = 0; i < groupSize; i += 4)
+                    out.push_back(static_cast<uint8_t>(bytes[i] | bytes[i+1] << 2 | bytes[i+2] << 4 | bytes[i+3] << 6));
+            }
+            else if (mode == 2) {
+                for (size_t i = 0; i < groupSize; i += 2)
+                    out.push_back(static_cast<uint8_t>(bytes[i] | bytes[i+1] << 4));
+            }
+            else if (mode == 3) {
+                out.insert(out.end(), bytes, bytes + groupSize);
+            }
+        }
+
+        inline const uint8_t * decodeGroup(const uint8_t *src, const uint8_t *end, uint8_t mode, uint8_t *bytes)
+        {
+            static constexpr size_t sizes[4] = {0, groupSize/4, groupSize/2, groupSize};
+            if (static_cast<size_t>(end - src) < sizes[mode])
+                corrupt();
+
+            switch (mode) {
+            case 0:
+                std::memset(bytes, 0, groupSize);
+                break;
+            case 1:
+                for (size_t i = 0; i < groupSize/4; ++i) {
+                    auto b = src[i];
+                    bytes[i*4] = b & 3;
+                    bytes[i*4+1] = (b >> 2) & 3;
+                    bytes[i*4+2] = (b >> 4) & 3;
+                    bytes[i*4+3] = b >> 6;
+                }
+                break;
+            case 2:
+                for (size_t i = 0; i < groupSize/2; ++i) {
+                    bytes[i*2] = src[i] & 15;
+                    bytes[i*2+1] = src[i] >> 4;
+                }
+                break;
+            default:
+                std::memcpy(bytes, src, groupSize);
+                break;
+            }
+            return src + sizes[mode];
+        }
+
+        inline void writeVarint(std::vector<uint8_t>& out, uint64_t value)
+        {
+            while (value >= 0x80) {
+                out.push_back(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<uint8_t>(value));
+        }
+
+        inline const uint8_t * readVarint(const uint8_t *src, const uint8_t *end, uint64_t& value)
+        {
+            value = 0;
+            for (auto shift = 0; shift < 64; shift += 7) {
+                if (src == end)
+                    corrupt();
+                auto b = *src++;
+                value |= uint64_t(b & 0x7F) << shift;
+                if (!(b & 0x80))
+                    return src;
+            }
+            corrupt();
+            return src;
+        }
+
+        // State shared by the index encoder and decoder, both update it the same way for every triangle
+        struct indexState
+        {
+            indexState()
+            {
+                std::fill(&edges[0][0], &edges[0][0] + edgeFifo*2, ~0u);
+                std::fill(vertices, vertices + vertexFifo, ~0u);
+            }
+
+            int findVertex(uint32_t v) const
+            {
+                for (size_t j = 0; j < vertexFifo; ++j) {
+                    if (vertices[j] == v)
+                        return static_cast<int>(j);
+                }
+                return -1;
+            }
+
+            // Code of a vertex: 0 for the next unused one, 1 to 6 for the vertex FIFO and 7 for an explicit one
+            uint8_t code(uint32_t v) const
+            {
+                if (v == next)
+                    return 0;
+                auto j = findVertex(v);
+                return j >= 0 ? static_cast<uint8_t>(1 + j) : 7;
+            }
+
+            void useVertex(uint32_t v, uint8_t code)
+            {
+                if (code == 0 || code == 7) {
+                    std::copy_backward(vertices, vertices + vertexFifo - 1, vertices + vertexFifo);
+                    vertices[0] = v;
+                }
+                if (code == 7)
+                    last = v;
+                next = std::max(next, v + 1);
+            }
+
+            // Edges are stored reversed, as the neighbour across them walks them
+            void useTriangle(uint32_t a, uint32_t b, uint32_t c)
+            {
+                std::copy_backward(&edges[0][0], &edges[0][0] + (edgeFifo-3)*2, &edges[0][0] + edgeFifo*2);
+                edges[0][0] = a;
+                edges[0][1] = c;
+                edges[1][0] = c;
+                edges[1][1] = b;
+                edges[2][0] = b;
+                edges[2][1] = a;
+            }
+
+            uint32_t edges[edgeFifo][2];
+
+            uint32_t vertices[vertexFifo];
+
+            uint32_t next = 0, last = 0;
+        };
+    }
+
+    // Encodes count vertices of stride bytes, stride must be a multiple of 4
+    inline std::vector<uint8_t> encodeVertices(const void *data, size_t count, size_t stride)
+    {
+        using namespace detail;
+        if (stride % 4)
+            throw std::runtime_error("unsupported vertex stride");
+
+        std::vector<uint8_t> out;
+        std::vector<uint32_t> previous(stride/4, 0);
+        std::vector<uint8_t> planes(stride * blockVertices);
+        auto src = static_cast<const uint8_t*>(data);
+
+        for (size_t first = 0; first < count; first += blockVertices) {
+            auto n = std::min(blockVertices, count - first);
+            std::fill(planes.begin(), planes.end(), 0);
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t w = 0; w < stride/4; ++w) {
+                    uint32_t word;
+                    std::memcpy(&word, src + (first+i)*stride + w*4, 4);
+                    auto z = zigzag(word - previous[w]);
+                    previous[w] = word;
+                    for (size_t b = 0; b < 4; ++b)
+                        planes[(w*4+b)*blockVertices + i] = static_cast<uint8_t>(z >> (8*b));
+                }
+            }
+
+            // The 2 bit modes of all groups of a plane precede their data
+            auto groups = (n + groupSize-1) / groupSize;
+            for (size_t k = 0; k < stride; ++k) {
+                auto headerAt = out.size();
+                out.resize(out.size() + (groups+3)/4, 0);
+                for (size_t g = 0; g < groups; ++g) {
+                    uint8_t mode;
+                    encodeGroup(&planes[k*blockVertices + g*groupSize], out, mode);
+                    out[headerAt + g/4] |= static_cast<uint8_t>(mode << (g%4*2));
+                }
+            }
+        }
+        return out;
+    }
+
+    inline void decodeVertices(const uint8_t *src, size_t size, void *data, size_t count, size_t stride)
+    {
+        using namespace detail;
+        if (stride % 4)
+            corrupt();
+
+        auto end = src + size;
+        auto dst = static_cast<uint8_t*>(data);
+        std::vector<uint32_t> previous(stride/4, 0);
+        std::vector<uint8_t> planes(stride * blockVertices);
+        std::vector<uint32_t> words(stride/4 * blockVertices);
+
+        for (size_t first = 0; first < count; first += blockVertices) {
+            auto n = std::min(blockVertices, count - first);
+            auto groups = (n + groupSize-1) / groupSize;
+            for (size_t k = 0; k < stride; ++k) {
+                auto headers = src;
+                src += (groups+3)/4;
+                if (src > end)
+                    corrupt();
+                for (size_t g = 0; g < groups; ++g)
+                    src = decodeGroup(src, end, (headers[g/4] >> (g%4*2)) & 3, &planes[k*blockVertices + g*groupSize]);
+            }
+
+            // Merge the planes of every word first, these loops are contiguous and get vectorized
+            for (size_t w = 0; w < stride/4; ++w) {
+                auto p = &planes[w*4*blockVertices];
+                auto z = &words[w*blockVertices];
+                for (size_t i = 0; i < blockVertices; ++i)
+                    z[i] = unzigzag(p[i] | uint32_t(p[blockVertices+i]) << 8 | uint32_t(p[2*blockVertices+i]) << 16 | uint32_t(p[3*blockVertices+i]) << 24);
+            }
+
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t w = 0; w < stride/4; ++w) {
+                    previous[w] += words[w*blockVertices + i];
+                    std::memcpy(dst + (first+i)*stride + w*4, &previous[w], 4);
+                }
+            }
+        }
+
+        if (src != end)
+            corrupt();
+    }
+
+    template<class T>
+    std::vector<uint8_t> encodeIndices(const T *indices, size_t count)
+    {
+        using namespace detail;
+        std::vector<uint8_t> out;
+        indexState state;
+
+        auto explicitVertex = [&](uint32_t v, uint8_t code) {
+            if (code == 7)
+                writeVarint(out, zigzag(v - state.last));
+        };
+
+        for (size_t t = 0; t+2 < count; t += 3) {
+            uint32_t tri[3] = {indices[t], indices[t+1], indices[t+2]};
+
+            // The most recent edge that matches a rotation of the triangle, rotation 3 marks a triangle without one
+            size_t edge = 0, rotation = 3;
+            for (size_t i = 0; i < edgeFifo && rotation == 3; ++i) {
+                for (size_t r = 0; r < 3; ++r) {
+                    if (state.edges[i][0] == tri[r] && state.edges[i][1] == tri[(r+1)%3]) {
+                        edge = i;
+                        rotation = r;
+                        break;
+                    }
+                }
+            }
+
+            if (rotation < 3) {
+                auto third = tri[(rotation+2)%3];
+                auto code = state.code(third);
+                out.push_back(static_cast<uint8_t>(edge << 5 | rotation << 3 | code));
+                explicitVertex(third, code);
+                state.useVertex(third, code);
+            }
+            else {
+                out.push_back(3 << 3);
+                for (auto v : tri) {
+                    auto code = state.code(v);
+                    out.push_back(code);
+                    explicitVertex(v, code);
+                    state.useVertex(v, code);
+                }
+            }
+            state.useTriangle(tri[0], tri[1], tri[2]);
+        }
+
+        for (auto i = count - count%3; i < count; ++i)
+            writeVarint(out, indices[i]);
+        return out;
+    }
+
+    template<class T>
+    void decodeIndices(const uint8_t *src, size_t size, T *indices, size_t count)
+    {
+        using namespace detail;
+        auto end = src + size;
+        indexState state;
+
+        auto vertex = [&](uint8_t code) {
+            uint32_t v;
+            if (code == 0) {
+                v = state.next;
+            }
+            else if (code < 7) {
+                v = state.vertices[code-1];
+            }
+            else {
+                uint64_t z;
+                src = readVarint(src, end, z);
+                v = state.last + unzigzag(static_cast<uint32_t>(z));
+            }
+            state.useVertex(v, code);
+            return v;
+        };
+
+        for (size_t t = 0; t+2 < count; t += 3) {
+            if (src == end)
+                corrupt();
+            auto code = *src++;
+            auto edge = code >> 5, rotation = (code >> 3) & 3;
+
+            uint32_t tri[3];
+            if (rotation < 3) {
+                tri[rotation] = state.edges[edge][0];
+                tri[(rotation+1)%3] = state.edges[edge][1];
+                tri[(rotation+2)%3] = vertex(code & 7);
+            }
+            else {
+                for (auto& v : tri) {
+                    if (src == end || *src > 7)
+                        corrupt();
+                    v = vertex(*src++);
+                }
+            }
+
+            state.useTriangle(tri[0], tri[1], tri[2]);
+            indices[t] = static_cast<T>(tri[0]);
+            indices[t+1] = static_cast<T>(tri[1]);
+            indices[t+2] = static_cast<T>(tri[2]);
+        }
+
+        for (auto i = count - count%3; i < count; ++i) {
+            uint64_t v;
+            src = readVarint(src, end, v);
+            indices[i] = static_cast<T>(v);
+        }
+
+        if (src != end)
+            corrupt();
+    }
+}
\ No newline at end of file
@@ -47,6 +47,12 @@ namespace game
 			_pl->replaceModel(_id, model);
 		}
 
+		// False while a model loaded asynchronously is still a placeholder
+		bool ready() const
+		{
+			return _pl->ready(_id);
+		}
+
 		Model * operator->()
 		{
 			return _pl->getInternalObjectPtr(_id);
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "base/filemap.hpp"
+
+namespace game
+{
+    /*
+     * Texture with its complete mip chain, ready to be uploaded level by level. The file is a fileHeader, a table
+     * with one level per mip level starting with the full size image and the pixels of every level on a 64 byte
+     * boundary. Levels are stored top row first, the same order stb_image returns.
+     */
+
+    struct texfile
+    {
+        static constexpr char magic[4] = {'T', 'E', 'X', '\0'};
+
+        static constexpr uint32_t version = 1;
+
+        static constexpr uint64_t alignment = 64;
+
+        // The block compressed formats store 4x4 blocks, levels smaller than a block still take a whole block
+        enum class pixelFormat : uint32_t { rgba8 = 1, bc1 = 2, bc3 = 3, bc7 = 4 };
+
+        // The mips of srgb textures were filtered in linear space, linear textures hold data such as specular maps
+        enum headerFlags : uint32_t { srgb = 1 };
+
+        struct fileHeader
+        {
+            char magic[4];
+
+            uint32_t version;
+
+            pixelFormat format;
+
+            uint32_t flags;
+
+            uint32_t width;
+
+            uint32_t height;
+
+            uint32_t levelCount;
+
+            uint32_t reserved;
+
+            uint64_t fileSize;
+        };
+
+        struct level
+        {
+            uint64_t offset;
+
+            uint64_t size;
+
+            uint32_t width;
+
+            uint32_t height;
+        };
+
+        static_assert(sizeof(fileHeader) == 40 && sizeof(level) == 24, "Unexpected texfile padding");
+
+        texfile()
+            : head{}
+        {
+        }
+
+        // Maps the file, the levels point into the mapping
+        texfile(std::string_view path)
+            : head{}, _mapping(path)
+        {
+            load(_mapping.data(), _mapping.size());
+        }
+
+        // Uses a file that is already in memory in place, the memory has to outlive the texfile
+        texfile(const char *memory, size_t size)
+            : head{}
+        {
+            load(memory, size);
+        }
+
+        const char * pixels(size_t i) const
+        {
+            return _data + levels[i].offset;
+        }
+
+        static size_t levelSize(pixelFormat format, uint32_t width, uint32_t height)
+        {
+            switch (format) {
+            case pixelFormat::rgba8:
+                return size_t(width) * height * 4;
+            case pixelFormat::bc1:
+                return size_t((width + 3) / 4) * ((height + 3) / 4) * 8;
+            case pixelFormat::bc3:
+            case pixelFormat::bc7:
+                return size_t((width + 3) / 4) * ((height + 3) / 4) * 16;
+            }
+            return 0;
+        }
+
+        // Writes the levels, every level must be half the size of the previous one rounded down
+        static void toFile(std::string_view path, pixelFormat format, uint32_t flags, uint32_t width, uint32_t height,
+            const std::vector<std::vector<uint8_t>>& pixels)
+        {
+            fileHeader fh = {};
+            std::copy(magic, magic+sizeof(magic), fh.magic);
+            fh.version = version;
+            fh.format = format;
+            fh.flags = flags;
+            fh.width = width;
+            fh.height = height;
+            fh.levelCount = static_cast<uint32_t>(pixels.size());
+
+            std::vector<level> table(pixels.size());
+            auto offset = align(sizeof(fh) + table.size()*sizeof(level));
+            for (size_t i = 0; i < table.size(); ++i) {
+                table[i] = {offset, pixels[i].size(), std::max(1u, width >> i), std::max(1u, height >> i)};
+                if (pixels[i].size() != levelSize(format, table[i].width, table[i].height))
+                    throw std::runtime_error("texture level has the wrong size");
+                offset = align(offset + pixels[i].size());
+            }
+            fh.fileSize = offset;
+
+            std::ofstream out(path.data(), std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+            if (!out.is_open())
+                throw std::runtime_error("unable to create texture file");
+
+            out.write(reinterpret_cast<const char*>(&fh), sizeof(fh));
+            out.write(reinterpret_cast<const char*>(table.data()), table.size()*sizeof(level));
+
+            const char zeros[alignment] = {};
+            for (size_t i = 0; i < table.size(); ++i) {
+                out.write(zeros, table[i].offset - out.tellp());
+                out.write(reinterpret_cast<const char*>(pixels[i].data()), pixels[i].size());
+            }
+            out.write(zeros, offset - out.tellp());
+
+            if (!out)
+                throw std::runtime_error("unable to write texture file");
+        }
+
+        fileHeader head;
+
+        std::vector<level> levels;
+
+    private:
+
+        static constexpr uint64_t align(uint64_t offset)
+        {
+            return (offset + alignment-1) & ~(alignment-1);
+        }
+
+        void load(const char *memory, size_t size)
+        {
+            if (size < sizeof(fileHeader))
+                throw std::runtime_error("corrupt texture file");
+            std::copy(memory, memory + sizeof(head), reinterpret_cast<char*>(&head));
+            if (!std::equal(magic, magic+sizeof(magic), head.magic))
+                throw std::runtime_error("corrupt texture file");
+            if (head.version != version || levelSize(head.format, 1, 1) == 0)
+                throw std::runtime_error("unsupported texture file version");
+
+            if (head.fileSize != size || head.width == 0 || head.height == 0 || head.levelCount == 0 || head.levelCount > 32
+                || sizeof(head) + head.levelCount*sizeof(level) > size)
+                throw std::runtime_error("corrupt texture file");
+
+            levels.resize(head.levelCount);
+            std::copy(memory + sizeof(head), memory + sizeof(head) + levels.size()*sizeof(level), reinterpret_cast<char*>(levels.data()));
+            for (size_t i = 0; i < levels.size(); ++i) {
+                const auto& l = levels[i];
+                if (l.width != std::max(1u, head.width >> i) || l.height != std::max(1u, head.height >> i)
+                    || l.size != levelSize(head.format, l.width, l.height) || l.offset > size || l.size > size - l.offset)
+                    throw std::runtime_error("corrupt texture file");
+            }
+            _data = memory;
+        }
+
+        native::fileMapping _mapping;
+
+        const char *_data = nullptr;
+    };
+}
\ No newline at end of file
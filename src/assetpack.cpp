@@ -0,0 +1,66 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include "base/assetpack.hpp"
+
+using namespace std;
+using game::assetPack;
+
+int main(int argc, char *argv[])
+{
+    ios_base::sync_with_stdio(false);
+
+    if (argc == 3 && string_view(argv[1]) == "-l") {
+        try {
+            assetPack pack(argv[2]);
+            size_t total = 0;
+            for (const auto& e : pack) {
+                cout << setw(12) << e.size << "  " << pack.name(e) << endl;
+                total += e.size;
+            }
+            cout << (pack.end() - pack.begin()) << " assets, " << total << " bytes" << endl;
+        }
+        catch (const std::exception& e) {
+            cout << "Error reading pack: " << e.what() << endl;
+        }
+        return 0;
+    }
+
+    if (argc < 3) {
+        cout << "Usage: assetpack <output.pak> <file | directory>..." << endl;
+        cout << "       assetpack -l <file.pak>" << endl;
+        cout << "  assets are named by the path they are given as, run it from the directory the game runs in" << endl;
+        return 0;
+    }
+
+    // Every file is stored under the path the game would load it from
+    vector<pair<string, string>> files;
+    auto output = filesystem::weakly_canonical(argv[1]);
+    for (auto i = 2; i < argc; ++i) {
+        filesystem::path input(argv[i]);
+        if (filesystem::is_directory(input)) {
+            for (const auto& f : filesystem::recursive_directory_iterator(input)) {
+                if (f.is_regular_file() && filesystem::weakly_canonical(f.path()) != output)
+                    files.emplace_back(f.path().lexically_normal().generic_string(), f.path().string());
+            }
+        }
+        else if (filesystem::is_regular_file(input)) {
+            files.emplace_back(input.lexically_normal().generic_string(), input.string());
+        }
+        else {
+            cout << "Not a file or directory: " << argv[i] << endl;
+            return 0;
+        }
+    }
+
+    try {
+        assetPack::write(argv[1], files);
+        cout << files.size() << " assets, " << filesystem::file_size(argv[1]) << " bytes" << endl;
+    }
+    catch (const std::exception& e) {
+        cout << "Error writing pack: " << e.what() << endl;
+    }
+    return 0;
+}
\ No newline at end of file
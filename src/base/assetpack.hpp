@@ -0,0 +1,223 @@
+#pragma once
+
+#include "filemap.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace game
+{
+    /*
+     * Read only archive of all assets, mapped once at startup. The table of contents is sorted on the hash of the
+     * asset name so a lookup is a binary search over 32 byte entries followed by a name compare, no file system
+     * access at all. Every asset starts on a 64 byte boundary, meshes can therefore be loaded in place.
+     *
+     * Names are the relative paths the loose files are loaded from, e.g. data/models/chair.msh. When a pack is
+     * mounted the loaders look up their paths in it first and fall back to the loose files.
+     */
+
+    class assetPack
+    {
+    public:
+
+        struct header
+        {
+            char magic[4];
+
+            uint32_t version;
+
+            uint64_t count;
+
+            uint64_t fileSize;
+
+            uint64_t reserved;
+        };
+
+        struct entry
+        {
+            uint64_t hash;
+
+            uint64_t offset;
+
+            uint64_t size;
+
+            uint32_t name;
+
+            uint32_t nameLength;
+        };
+
+        static_assert(sizeof(header) == 32 && sizeof(entry) == 32, "Unexpected asset pack padding");
+
+        static constexpr char magic[4] = {'P', 'A', 'K', '\0'};
+
+        static constexpr uint32_t version = 1;
+
+        static constexpr uint64_t alignment = 64;
+
+        assetPack(std::string_view path)
+            : _mapping(path)
+        {
+            auto fail = [] { throw exception(except_e::NATIVE_FILE, "corrupt asset pack"); };
+
+            if (_mapping.size() < sizeof(header))
+                fail();
+            auto& h = *reinterpret_cast<const header*>(_mapping.data());
+            if (!std::equal(magic, magic+sizeof(magic), h.magic) || h.version != version || h.fileSize != _mapping.size()
+                || h.count > (_mapping.size() - sizeof(header)) / sizeof(entry))
+                fail();
+
+            _entries = reinterpret_cast<const entry*>(_mapping.data() + sizeof(header));
+            _count = h.count;
+            for (size_t i = 0; i < _count; ++i) {
+                const auto& e = _entries[i];
+                if (e.offset > _mapping.size() || e.size > _mapping.size() - e.offset || e.offset % alignment
+                    || uint64_t(e.name) + e.nameLength > _mapping.size() || (i && e.hash < _entries[i-1].hash))
+                    fail();
+            }
+        }
+
+        // The contents of the asset, data() is null when the pack does not have it
+        std::string_view find(std::string_view name) const
+        {
+            name = normalize(name);
+            auto h = hash(name);
+            auto it = std::lower_bound(_entries, _entries + _count, h, [](const entry& e, uint64_t h) {
+                return e.hash < h;
+            });
+            for (; it != _entries + _count && it->hash == h; ++it) {
+                if (this->name(*it) == name)
+                    return {_mapping.data() + it->offset, it->size};
+            }
+            return {};
+        }
+
+        std::string_view name(const entry& e) const
+        {
+            return {_mapping.data() + e.name, e.nameLength};
+        }
+
+        const entry * begin() const
+        {
+            return _entries;
+        }
+
+        const entry * end() const
+        {
+            return _entries + _count;
+        }
+
+        // FNV-1a, the names are short so a byte loop is fast enough
+        static uint64_t hash(std::string_view name)
+        {
+            uint64_t h = 0xCBF29CE484222325ull;
+            for (auto c : name) {
+                h ^= static_cast<unsigned char>(c);
+                h *= 0x100000001B3ull;
+            }
+            return h;
+        }
+
+        // ./shaders/a.glsl and shaders/a.glsl are the same asset
+        static std::string_view normalize(std::string_view name)
+        {
+            while (name.substr(0, 2) == "./")
+                name.remove_prefix(2);
+            return name;
+        }
+
+        // Maps the pack for the rest of the program, returns false when there is no file at path
+        static bool mount(std::string_view path)
+        {
+            if (!std::ifstream(path.data()).is_open())
+                return false;
+            mounted() = std::make_unique<assetPack>(path);
+            return true;
+        }
+
+        // Looks the name up in the mounted pack, data() is null without a pack or when the pack does not have it
+        static std::string_view lookup(std::string_view name)
+        {
+            return mounted() ? mounted()->find(name) : std::string_view();
+        }
+
+        /*
+         * Writes a pack of the given (name, file) pairs. The entries are sorted on their hash, then the names
+         * follow the table and the file contents follow the names.
+         */
+
+        static void write(std::string_view path, std::vector<std::pair<std::string, std::string>> files)
+        {
+            for (auto& f : files)
+                f.first = std::string(normalize(f.first));
+            std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) {
+                auto ha = hash(a.first), hb = hash(b.first);
+                return ha != hb ? ha < hb : a.first < b.first;
+            });
+
+            std::vector<entry> entries(files.size());
+            std::string names;
+            uint64_t offset = sizeof(header) + files.size()*sizeof(entry);
+            for (size_t i = 0; i < files.size(); ++i) {
+                entries[i].hash = hash(files[i].first);
+                entries[i].name = static_cast<uint32_t>(offset + names.size());
+                entries[i].nameLength = static_cast<uint32_t>(files[i].first.size());
+                names += files[i].first;
+            }
+
+            offset = align(offset + names.size());
+            std::vector<native::fileMapping> sources;
+            for (size_t i = 0; i < files.size(); ++i) {
+                sources.emplace_back(files[i].second);
+                entries[i].offset = offset;
+                entries[i].size = sources.back().size();
+                offset = align(offset + entries[i].size);
+            }
+
+            header h = {};
+            std::copy(magic, magic+sizeof(magic), h.magic);
+            h.version = version;
+            h.count = files.size();
+            h.fileSize = offset;
+
+            std::ofstream out(path.data(), std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+            if (!out.is_open())
+                throw exception(except_e::NATIVE_FILE, "unable to create asset pack");
+
+            const char zeros[alignment] = {};
+            out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+            out.write(reinterpret_cast<const char*>(entries.data()), entries.size()*sizeof(entry));
+            out.write(names.data(), names.size());
+            for (size_t i = 0; i < files.size(); ++i) {
+                out.write(zeros, entries[i].offset - out.tellp());
+                out.write(sources[i].data(), entries[i].size);
+            }
+            out.write(zeros, offset - out.tellp());
+
+            if (!out)
+                throw exception(except_e::NATIVE_FILE, "unable to write asset pack");
+        }
+
+    private:
+
+        static constexpr uint64_t align(uint64_t offset)
+        {
+            return (offset + alignment-1) & ~(alignment-1);
+        }
+
+        static std::unique_ptr<assetPack>& mounted()
+        {
+            static std::unique_ptr<assetPack> pack;
+            return pack;
+        }
+
+        native::fileMapping _mapping;
+
+        const entry *_entries = nullptr;
+
+        size_t _count = 0;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,496 @@
+#pragma once
+
+#include "exception.hpp"
+#include "jobqueue.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef __linux__
+
+#include <atomic>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#endif
+
+namespace game::native
+{
+    /*
+     * Reads whole files without blocking the caller. read() only queues a file, submit() hands everything queued
+     * so far to the kernel in a single io_uring submission, and poll() or wait() run the callbacks of the finished
+     * reads on the calling thread. Where io_uring is missing, or the kernel refuses it, a few threads read the
+     * files instead and the interface stays the same.
+     *
+     * Files are opened and sized when they are submitted, only the reads themselves are asynchronous. Reads can be
+     * queued from any thread, submit(), poll() and wait() belong to a single one.
+     */
+
+    class asyncReader
+    {
+    public:
+
+        struct result
+        {
+            std::string path;
+
+            // Holds the file unless it was read into a buffer given to read()
+            std::vector<char> data;
+
+            const char *bytes = nullptr;
+
+            size_t size = 0;
+
+            // errno of the failed open or read, 0 on success
+            int error = 0;
+
+            explicit operator bool() const
+            {
+                return error == 0;
+            }
+        };
+
+        using completion = std::function<void(result&&)>;
+
+        // Contents of several files by path, see read(paths, done)
+        using files = std::map<std::string, std::vector<char>>;
+
+        // uring can be turned off to use the threads anyway
+        explicit asyncReader(unsigned depth = 256, bool uring = true)
+        {
+#ifdef __linux__
+            _uring = uring && setup(depth);
+#endif
+            if (!_uring)
+                _workers = std::make_unique<jobQueue>();
+        }
+
+        asyncReader(const asyncReader& rhs) = delete;
+
+        asyncReader(asyncReader&& rhs) = delete;
+
+        // Reads that are still in flight are waited for, their callbacks are not called
+        ~asyncReader()
+        {
+            {
+                std::lock_guard<std::mutex> lk(_queueMtx);
+                _queued.clear();
+            }
+            if (_uring) {
+                while (!_inflight.empty())
+                    reap(true, false);
+            }
+            _workers.reset();
+#ifdef __linux__
+            if (_uring) {
+                munmap(_sqRing, _sqSize);
+                if (_cqRing != _sqRing)
+                    munmap(_cqRing, _cqSize);
+                munmap(_sqes, _sqesSize);
+                close(_fd);
+            }
+#endif
+        }
+
+        // Queues a read of the whole file into memory the result owns
+        void read(std::string_view path, completion done)
+        {
+            std::lock_guard<std::mutex> lk(_queueMtx);
+            _queued.push_back(std::make_unique<request>(path, nullptr, 0, std::move(done)));
+        }
+
+        // Queues a read into the caller's buffer, which has to stay valid until the callback ran. Files larger than
+        // capacity are cut off
+        void read(std::string_view path, char *buffer, size_t capacity, completion done)
+        {
+            std::lock_guard<std::mutex> lk(_queueMtx);
+            _queued.push_back(std::make_unique<request>(path, buffer, capacity, std::move(done)));
+        }
+
+        /*
+         * Queues reads of several files and calls done once with all of them, files that could not be read are left
+         * out. Without any paths done is called right away on the calling thread.
+         */
+
+        void read(const std::vector<std::string>& paths, std::function<void(files&&)> done)
+        {
+            if (paths.empty()) {
+                done({});
+                return;
+            }
+
+            struct gather
+            {
+                files out;
+
+                size_t remaining;
+
+                std::function<void(files&&)> done;
+            };
+            auto state = std::make_shared<gather>(gather{{}, paths.size(), std::move(done)});
+            for (const auto& path : paths) {
+                read(path, [state](result&& r) {
+                    if (r)
+                        state->out.emplace(std::move(r.path), std::move(r.data));
+                    if (--state->remaining == 0)
+                        state->done(std::move(state->out));
+                });
+            }
+        }
+
+        // Starts every queued read, returns the number of reads started
+        size_t submit()
+        {
+            std::lock_guard<std::mutex> lk(_queueMtx);
+            size_t started = 0;
+            if (!_uring) {
+                for (auto& r : _queued) {
+                    auto shared = std::shared_ptr<request>(std::move(r));
+                    ++_pending;
+                    _workers->submit([this, shared]() {
+                        readBlocking(*shared);
+                        {
+                            std::lock_guard<std::mutex> lk(_mtx);
+                            _finished.push_back(std::move(shared));
+                        }
+                        _cv.notify_one();
+                    });
+                    ++started;
+                }
+                _queued.clear();
+                return started;
+            }
+
+#ifdef __linux__
+            // Reads beyond the depth of the ring stay queued until earlier ones complete
+            while (!_queued.empty() && _inflight.size() < _depth) {
+                auto r = std::move(_queued.front());
+                _queued.pop_front();
+                // Files that fail to open and empty ones complete without a read
+                if (!openFile(*r) || r->size == 0) {
+                    _completed.push_back(std::move(r));
+                    continue;
+                }
+                prepareRead(*r);
+                _inflight.push_back(std::move(r));
+                ++started;
+            }
+            enter(0);
+#endif
+            return started;
+        }
+
+        // Runs the callbacks of the reads that finished, without waiting. Returns the number of callbacks run
+        size_t poll()
+        {
+            return reap(false, true);
+        }
+
+        // Submits what is queued and runs callbacks until every read finished
+        void wait()
+        {
+            while (busy()) {
+                submit();
+                reap(true, true);
+            }
+        }
+
+        // Whether any read is queued or has not had its callback yet
+        bool busy() const
+        {
+            return queued() || !_inflight.empty() || !_completed.empty() || _pending;
+        }
+
+        bool usesUring() const
+        {
+            return _uring;
+        }
+
+    private:
+
+        bool queued() const
+        {
+            std::lock_guard<std::mutex> lk(_queueMtx);
+            return !_queued.empty();
+        }
+
+        struct request
+        {
+            request(std::string_view path, char *buffer, size_t capacity, completion callback)
+                : callback(std::move(callback)), buffer(buffer), capacity(capacity)
+            {
+                out.path = path;
+            }
+
+            ~request()
+            {
+#ifdef __linux__
+                if (fd != -1)
+                    ::close(fd);
+#endif
+            }
+
+            result out;
+
+            completion callback;
+
+            char *buffer = nullptr;
+
+            size_t capacity = 0, size = 0, done = 0;
+
+            int fd = -1;
+
+#ifdef __linux__
+            iovec iov;
+#endif
+        };
+
+        // The buffer the file goes into, allocated in the result unless the caller gave one
+        static char * target(request& r, size_t fileSize)
+        {
+            if (r.buffer) {
+                r.size = std::min(fileSize, r.capacity);
+                return r.buffer;
+            }
+            r.size = fileSize;
+            r.out.data.resize(fileSize);
+            return r.out.data.data();
+        }
+
+        // Reads the file on a worker thread of the fallback
+        static void readBlocking(request& r)
+        {
+            std::ifstream in(r.out.path, std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+            if (!in.is_open()) {
+                r.out.error = ENOENT;
+                return;
+            }
+
+            auto bytes = target(r, static_cast<size_t>(in.tellg()));
+            in.seekg(0, std::ifstream::beg);
+            in.read(bytes, r.size);
+            if (in.bad())
+                r.out.error = EIO;
+            r.out.bytes = bytes;
+            r.out.size = static_cast<size_t>(in.gcount());
+        }
+
+        size_t reap(bool block, bool callbacks)
+        {
+            std::deque<std::unique_ptr<request>> done;
+            done.swap(_completed);
+
+            if (!_uring) {
+                std::vector<std::shared_ptr<request>> finished;
+                {
+                    std::unique_lock<std::mutex> lk(_mtx);
+                    if (block && done.empty())
+                        _cv.wait(lk, [this]() { return !_finished.empty() || !_pending; });
+                    finished.swap(_finished);
+                }
+                _pending -= finished.size();
+                for (auto& r : finished) {
+                    if (callbacks)
+                        complete(*r);
+                }
+                return finished.size() + finish(done, callbacks);
+            }
+
+#ifdef __linux__
+            if (block && done.empty() && !_inflight.empty())
+                enter(1);
+
+            auto head = *_cqHead;
+            auto tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                const auto& cqe = _cqes[head & *_cqMask];
+                auto it = std::find_if(_inflight.begin(), _inflight.end(), [&cqe](const std::unique_ptr<request>& r) {
+                    return reinterpret_cast<uint64_t>(r.get()) == cqe.user_data;
+                });
+                auto& r = **it;
+
+                if (cqe.res == -EAGAIN || cqe.res == -EINTR) {
+                    prepareRead(r);
+                    continue;
+                }
+                if (cqe.res < 0)
+                    r.out.error = -cqe.res;
+                else
+                    r.done += cqe.res;
+
+                // Short reads continue where they stopped, a read of nothing means the file shrank
+                if (cqe.res > 0 && r.done < r.size) {
+                    prepareRead(r);
+                    continue;
+                }
+                r.out.size = r.done;
+                done.push_back(std::move(*it));
+                _inflight.erase(it);
+            }
+            __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+
+            // Retried reads, and queued ones that now have room in the ring
+            if (queued() || _unsubmitted)
+                submit();
+#endif
+            return finish(done, callbacks);
+        }
+
+        static size_t finish(std::deque<std::unique_ptr<request>>& done, bool callbacks)
+        {
+            for (auto& r : done) {
+                if (callbacks)
+                    complete(*r);
+            }
+            return done.size();
+        }
+
+        // A file that shrank after it was sized comes back with what was read
+        static void complete(request& r)
+        {
+            if (!r.buffer)
+                r.out.data.resize(r.out.size);
+            r.callback(std::move(r.out));
+        }
+
+#ifdef __linux__
+
+        bool setup(unsigned depth)
+        {
+            io_uring_params params = {};
+            _fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+            if (_fd < 0)
+                return false;
+
+            _depth = params.sq_entries;
+            _sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            _cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            auto single = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (single)
+                _sqSize = _cqSize = std::max(_sqSize, _cqSize);
+
+            _sqRing = mmap(nullptr, _sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+            _cqRing = single ? _sqRing : mmap(nullptr, _cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+            _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            _sqes = static_cast<io_uring_sqe*>(mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd,
+                IORING_OFF_SQES));
+            if (_sqRing == MAP_FAILED || _cqRing == MAP_FAILED || _sqes == MAP_FAILED) {
+                close(_fd);
+                return false;
+            }
+
+            auto sq = static_cast<char*>(_sqRing);
+            _sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            _sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            _sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+            auto cq = static_cast<char*>(_cqRing);
+            _cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            _cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            _cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            return true;
+        }
+
+        static bool openFile(request& r)
+        {
+            r.fd = ::open(r.out.path.c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            if (r.fd == -1 || fstat(r.fd, &st) == -1) {
+                r.out.error = errno;
+                return false;
+            }
+
+            r.out.bytes = target(r, static_cast<size_t>(st.st_size));
+            return true;
+        }
+
+        // Fills a submission entry for the rest of the file, it goes to the kernel with the next enter()
+        void prepareRead(request& r)
+        {
+            r.iov.iov_base = const_cast<char*>(r.out.bytes) + r.done;
+            r.iov.iov_len = r.size - r.done;
+
+            auto tail = *_sqTail;
+            auto index = tail & *_sqMask;
+            auto& sqe = _sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READV;
+            sqe.fd = r.fd;
+            sqe.addr = reinterpret_cast<uint64_t>(&r.iov);
+            sqe.len = 1;
+            sqe.off = r.done;
+            sqe.user_data = reinterpret_cast<uint64_t>(&r);
+            _sqArray[index] = index;
+            __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+            ++_unsubmitted;
+        }
+
+        // Hands the prepared entries to the kernel in one system call, optionally waiting for completions
+        void enter(unsigned wait)
+        {
+            for (;;) {
+                auto flags = wait ? IORING_ENTER_GETEVENTS : 0u;
+                auto ret = syscall(__NR_io_uring_enter, _fd, _unsubmitted, wait, flags, nullptr, 0);
+                if (ret >= 0) {
+                    _unsubmitted -= static_cast<unsigned>(ret);
+                    return;
+                }
+                if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                    throw exception(except_e::NATIVE_FILE, "io_uring_enter");
+            }
+        }
+
+        int _fd = -1;
+
+        unsigned _depth = 0, _unsubmitted = 0;
+
+        void *_sqRing = nullptr, *_cqRing = nullptr;
+
+        size_t _sqSize = 0, _cqSize = 0, _sqesSize = 0;
+
+        unsigned *_sqTail = nullptr, *_sqMask = nullptr, *_sqArray = nullptr;
+
+        unsigned *_cqHead = nullptr, *_cqTail = nullptr, *_cqMask = nullptr;
+
+        io_uring_sqe *_sqes = nullptr;
+
+        io_uring_cqe *_cqes = nullptr;
+
+#endif
+
+        bool _uring = false;
+
+        std::deque<std::unique_ptr<request>> _queued, _inflight, _completed;
+
+        // Guards _queued, the only part other threads touch
+        mutable std::mutex _queueMtx;
+
+        // Fallback: reads handed to the workers and the ones they finished
+        std::unique_ptr<jobQueue> _workers;
+
+        std::mutex _mtx;
+
+        std::condition_variable _cv;
+
+        std::vector<std::shared_ptr<request>> _finished;
+
+        size_t _pending = 0;
+    };
+}
\ No newline at end of file
@@ -6,18 +6,19 @@
 
 namespace game
 {
-    enum class except_e { NATIVE_CLOCK, NATIVE_INPUT, NATIVE_WINDOW, OPENGL_BASE, GRAPHICS_BASE, FONT_BASE, APPLICATION };
+    enum class except_e { NATIVE_CLOCK, NATIVE_INPUT, NATIVE_WINDOW, NATIVE_FILE, OPENGL_BASE, GRAPHICS_BASE, FONT_BASE, APPLICATION };
 
     class exception : public std::exception
     {
     public:
 
-        exception(except_e ecode, std::string_view msg = nullptr)
+        exception(except_e ecode, std::string_view msg = {})
             : ecode(ecode)
         {
             const char cstr[] = "Error in ui::native_clock: ";
             const char istr[] = "Error in ui::native_input: ";
             const char wstr[] = "Error in ui::native_window: ";
+            const char fistr[] = "Error in ui::native_file: ";
             const char gstr[] = "Error in ui::opengl_base: ";
 			const char gfxstr[] = "Error in ui::graphics_base: ";
 			const char fstr[] = "Error in ui::font_base: ";
@@ -37,6 +38,10 @@ namespace game
                 len = sizeof(wstr)-1;
                 std::copy(wstr, wstr+len, _buffer);
                 break;
+            case except_e::NATIVE_FILE:
+                len = sizeof(fistr)-1;
+                std::copy(fistr, fistr+len, _buffer);
+                break;
             case except_e::OPENGL_BASE:
                 len = sizeof(gstr)-1;
                 std::copy(gstr, gstr+len, _buffer);
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "exception.hpp"
+#include <cstddef>
+#include <string>
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace game::native
+{
+    /*
+     * Private (copy on write) read mapping of a whole file. As long as nobody writes to it the pages are shared
+     * with the page cache, so mapped files take no heap memory at all.
+     */
+
+    class fileMapping
+    {
+    public:
+
+        fileMapping()
+        {
+        }
+
+        fileMapping(std::string_view path)
+        {
+            int fd = open(std::string(path).c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd == -1)
+                throw exception(except_e::NATIVE_FILE, "open");
+
+            struct stat st;
+            if (fstat(fd, &st) == -1) {
+                close(fd);
+                throw exception(except_e::NATIVE_FILE, "fstat");
+            }
+
+            _size = static_cast<size_t>(st.st_size);
+            if (_size) {
+                auto ptr = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+                if (ptr == MAP_FAILED) {
+                    close(fd);
+                    throw exception(except_e::NATIVE_FILE, "mmap");
+                }
+                _data = static_cast<char*>(ptr);
+                madvise(_data, _size, MADV_WILLNEED);
+            }
+            close(fd);
+        }
+
+        fileMapping(const fileMapping& rhs) = delete;
+
+        fileMapping(fileMapping&& rhs) noexcept
+            : _data(rhs._data), _size(rhs._size)
+        {
+            rhs._data = nullptr;
+            rhs._size = 0;
+        }
+
+        ~fileMapping()
+        {
+            if (_data)
+                munmap(_data, _size);
+        }
+
+        fileMapping& operator=(fileMapping&& rhs) noexcept
+        {
+            if (_data)
+                munmap(_data, _size);
+            _data = rhs._data;
+            _size = rhs._size;
+            rhs._data = nullptr;
+            rhs._size = 0;
+            return *this;
+        }
+
+        char * data() const
+        {
+            return _data;
+        }
+
+        size_t size() const
+        {
+            return _size;
+        }
+
+    private:
+
+        char *_data = nullptr;
+
+        size_t _size = 0;
+    };
+}
+
+#elif defined(_WIN32)
+
+#define WINDOWS_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace game::native
+{
+	class fileMapping
+	{
+	public:
+
+		fileMapping()
+		{
+		}
+
+		fileMapping(std::string_view path)
+		{
+			auto file = CreateFileA(std::string(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+				FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+				throw exception(except_e::NATIVE_FILE, "CreateFileA");
+
+			LARGE_INTEGER size;
+			if (GetFileSizeEx(file, &size) == FALSE) {
+				CloseHandle(file);
+				throw exception(except_e::NATIVE_FILE, "GetFileSizeEx");
+			}
+
+			_size = static_cast<size_t>(size.QuadPart);
+			if (_size) {
+				auto mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+				CloseHandle(file);
+				if (!mapping)
+					throw exception(except_e::NATIVE_FILE, "CreateFileMappingA");
+
+				_data = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0));
+				CloseHandle(mapping);
+				if (!_data)
+					throw exception(except_e::NATIVE_FILE, "MapViewOfFile");
+			}
+			else {
+				CloseHandle(file);
+			}
+		}
+
+		fileMapping(const fileMapping& rhs) = delete;
+
+		fileMapping(fileMapping&& rhs) noexcept
+			: _data(rhs._data), _size(rhs._size)
+		{
+			rhs._data = nullptr;
+			rhs._size = 0;
+		}
+
+		~fileMapping()
+		{
+			if (_data)
+				UnmapViewOfFile(_data);
+		}
+
+		fileMapping& operator=(fileMapping&& rhs) noexcept
+		{
+			if (_data)
+				UnmapViewOfFile(_data);
+			_data = rhs._data;
+			_size = rhs._size;
+			rhs._data = nullptr;
+			rhs._size = 0;
+			return *this;
+		}
+
+		char * data() const
+		{
+			return _data;
+		}
+
+		size_t size() const
+		{
+			return _size;
+		}
+
+	private:
+
+		char *_data = nullptr;
+
+		size_t _size = 0;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace game
+{
+    /*
+     * Worker threads for loading work that does not need the OpenGL context, such as reading and decoding assets.
+     * Jobs start in the order they were submitted. Jobs that have not started when the queue is destroyed are
+     * dropped, their futures report a broken promise.
+     */
+
+    class jobQueue
+    {
+    public:
+
+        explicit jobQueue(unsigned threads = defaultThreads())
+        {
+            for (unsigned i = 0; i < threads; ++i)
+                _threads.emplace_back(&jobQueue::work, this);
+        }
+
+        jobQueue(const jobQueue& rhs) = delete;
+
+        jobQueue(jobQueue&& rhs) = delete;
+
+        ~jobQueue()
+        {
+            {
+                std::lock_guard<std::mutex> lk(_mtx);
+                _stop = true;
+                _jobs.clear();
+            }
+            _cv.notify_all();
+            for (auto& t : _threads)
+                t.join();
+        }
+
+        template<class F>
+        auto submit(F&& f) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+        {
+            using result = std::invoke_result_t<std::decay_t<F>>;
+
+            // std::function needs a copyable target, the task itself is not
+            auto task = std::make_shared<std::packaged_task<result()>>(std::forward<F>(f));
+            auto future = task->get_future();
+            {
+                std::lock_guard<std::mutex> lk(_mtx);
+                _jobs.emplace_back([task]() { (*task)(); });
+            }
+            _cv.notify_one();
+            return future;
+        }
+
+        // Leaves a core each to the window and the render thread
+        static unsigned defaultThreads()
+        {
+            auto cores = std::thread::hardware_concurrency();
+            return std::clamp(cores > 2 ? cores - 2 : 1u, 1u, 4u);
+        }
+
+    private:
+
+        void work()
+        {
+            for (;;) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lk(_mtx);
+                    _cv.wait(lk, [this]() { return _stop || !_jobs.empty(); });
+                    if (_stop)
+                        return;
+                    job = std::move(_jobs.front());
+                    _jobs.pop_front();
+                }
+                job();
+            }
+        }
+
+        std::mutex _mtx;
+
+        std::condition_variable _cv;
+
+        std::deque<std::function<void()>> _jobs;
+
+        std::vector<std::thread> _threads;
+
+        bool _stop = false;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,337 @@
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <filesystem>
+#include <unordered_map>
+#include "application/mesh.hpp"
+#include "converter/weld.hpp"
+
+using namespace std;
+using game::meshfile;
+
+namespace
+{
+    uint32_t rotl(const uint32_t value, int shift)
+    {
+        if ((shift &= sizeof(value)*8 - 1) == 0)
+            return value;
+        return (value << shift) | (value >> (sizeof(value)*8 - shift));
+    }
+
+    // The SHA-1 like hash that obj2msh used before the weld table, kept around as the baseline
+    struct legacyHash
+    {
+        uint64_t operator()(const meshfile::vertexData& v) const
+        {
+            uint32_t block[80] = {};
+            std::copy(reinterpret_cast<const char*>(&v), reinterpret_cast<const char*>(&v)+sizeof(v), block);
+            block[sizeof(v)/4] = 0x80;
+            block[14] = sizeof(v);
+
+            uint32_t h0 = 0x67452301, h1 = 0xEFCDAB89, h2 = 0x98BADCFE, h3 = 0x10325476, h4 = 0xC3D2E1F0;
+            for (auto i = 16; i < 80; ++i) {
+                block[i] = rotl(block[i-3] ^ block[i-8] ^ block[i-14] ^ block[i-16], 1);
+            }
+
+            uint32_t a = h0, b = h1, c = h2, d = h3, e = h4, f, k;
+            for (auto i = 0; i < 80; ++i) {
+                if (i < 20) {
+                    f = (b & c) | ((~b) & d);
+                    k = 0x5A827999;
+                }
+                else if (i < 40) {
+                    f = b ^ c ^ d;
+                    k = 0x6ED9EBA1;
+                }
+                else if (i < 60) {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8F1BBCDC;
+                }
+                else {
+                    f = b ^ c ^ d;
+                    k = 0xCA62C1D6;
+                }
+
+                uint32_t tmp = rotl(a, 5) + f + e + k + block[i];
+                e = d;
+                d = c;
+                c = rotl(b, 30);
+                b = a;
+                a = tmp;
+            }
+
+            h0 = h0 + a;
+            h1 = h1 + b;
+            h2 = h2 + c;
+            h3 = h3 + d;
+            h4 = h4 + e;
+            return (static_cast<uint64_t>(h0 ^ h4 ) << 32) | static_cast<uint64_t>(((h1 ^ h2) << 15) ^ h3);
+        }
+    };
+
+    template<class F>
+    double measure(F&& f)
+    {
+        auto start = chrono::steady_clock::now();
+        f();
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    void report(string_view name, double seconds, size_t items, string_view unit)
+    {
+        cout << setw(12) << left << name << fixed << setprecision(3) << setw(12) << right << seconds*1000.0 << " ms"
+            << setprecision(2) << setw(12) << (items / seconds / 1e6) << " M" << unit << "/s" << endl;
+    }
+
+    // Corners of a triangulated grid, every interior vertex is shared by six triangles like in a typical scan
+    vector<meshfile::vertexData> makeGrid(size_t corners)
+    {
+        size_t side = 2;
+        while (6*(side-1)*(side-1) < corners)
+            ++side;
+
+        auto vertex = [side](size_t x, size_t y) {
+            meshfile::vertexData v;
+            v.position = glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>((x*y) % 7));
+            v.texcoord = glm::vec2(static_cast<float>(x)/side, static_cast<float>(y)/side);
+            v.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+            return v;
+        };
+
+        vector<meshfile::vertexData> out;
+        out.reserve(6*(side-1)*(side-1));
+        for (size_t y = 0; y+1 < side; ++y) {
+            for (size_t x = 0; x+1 < side; ++x) {
+                out.push_back(vertex(x, y));
+                out.push_back(vertex(x+1, y));
+                out.push_back(vertex(x+1, y+1));
+                out.push_back(vertex(x, y));
+                out.push_back(vertex(x+1, y+1));
+                out.push_back(vertex(x, y+1));
+            }
+        }
+        return out;
+    }
+
+    int benchWeld(size_t corners)
+    {
+        auto input = makeGrid(corners);
+        cout << "welding " << input.size() << " corners" << endl;
+
+        vector<unsigned int> legacyIndices, indices;
+        vector<meshfile::vertexData> legacyData, data;
+        legacyIndices.reserve(input.size());
+        indices.reserve(input.size());
+
+        auto legacy = measure([&]() {
+            unordered_map<meshfile::vertexData, unsigned int, legacyHash> outhash;
+            for (const auto& v : input) {
+                if (outhash.count(v) == 0) {
+                    outhash[v] = outhash.size();
+                    legacyData.push_back(v);
+                }
+                legacyIndices.push_back(outhash[v]);
+            }
+        });
+
+        auto table = measure([&]() {
+            game::converter::weldTable outhash;
+            for (const auto& v : input)
+                indices.push_back(outhash.weld(v));
+            data = outhash.release();
+        });
+
+        report("legacy", legacy, input.size(), "corners");
+        report("weldTable", table, input.size(), "corners");
+        cout << "speedup: " << setprecision(1) << (legacy / table) << "x" << endl;
+
+        if (indices != legacyIndices || data != legacyData) {
+            cout << "output mismatch" << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Reads every vertex and index, the same amount of work the buffer upload does with the data
+    float touch(const meshfile& mesh)
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < mesh.head.dataCount; ++i)
+            sum += mesh.data[i].position.x;
+        for (size_t i = 0; i < mesh.head.indexCount; ++i)
+            sum += static_cast<float>(mesh.indices[i]);
+        return sum;
+    }
+
+    int benchLoad(const vector<size_t>& sizes)
+    {
+        auto path = (filesystem::temp_directory_path() / "meshbench.msh").string();
+        float sink = 0.0f;
+
+        for (auto corners : sizes) {
+            auto grid = makeGrid(corners);
+            vector<unsigned int> indices;
+            game::converter::weldTable table;
+            for (const auto& v : grid)
+                indices.push_back(table.weld(v));
+            auto vertices = table.release();
+
+            meshfile mf;
+            mf.head = {vertices.size(), indices.size()};
+            mf.data = vertices.data();
+            mf.indices = indices.data();
+            mf.toFile(path);
+            mf.data = nullptr;
+            mf.indices = nullptr;
+
+            auto bytes = vertices.size()*sizeof(meshfile::vertexData) + indices.size()*sizeof(unsigned int);
+            auto runs = max<size_t>(3, 1'000'000'000 / bytes);
+            cout << vertices.size() << " vertices, " << indices.size() << " indices, " << runs << " runs (warm page cache)" << endl;
+
+            auto stream = measure([&]() {
+                for (size_t r = 0; r < runs; ++r)
+                    sink += touch(meshfile(path));
+            });
+            auto mapped = measure([&]() {
+                for (size_t r = 0; r < runs; ++r)
+                    sink += touch(meshfile(path, meshfile::loadMode::map));
+            });
+
+            report("ifstream", stream / runs, bytes, "B");
+            report("mmap", mapped / runs, bytes, "B");
+        }
+
+        filesystem::remove(path);
+        return sink == 0.0f;
+    }
+
+    // Decodes the same buffer until roughly a gigabyte came out, the decoders are meant to run at memory speed
+    template<class Decode>
+    double decodeRate(size_t bytes, Decode&& decode)
+    {
+        auto runs = max<size_t>(3, 1'000'000'000 / max<size_t>(bytes, 1));
+        auto seconds = measure([&]() {
+            for (size_t r = 0; r < runs; ++r)
+                decode();
+        });
+        return seconds / runs;
+    }
+
+    // Compresses the mesh of a .msh file or a welded grid and times decoding and loading both files
+    int benchCodec(string_view input)
+    {
+        meshfile mf;
+        vector<meshfile::vertexData> vertices;
+        vector<unsigned int> indices;
+        if (!input.empty() && input.find_first_not_of("0123456789'") != string_view::npos) {
+            mf = meshfile(input);
+        }
+        else {
+            auto grid = makeGrid(input.empty() ? 6'000'000 : stoull(string(input)));
+            game::converter::weldTable table;
+            for (const auto& v : grid)
+                indices.push_back(table.weld(v));
+            vertices = table.release();
+            mf.head = {vertices.size(), indices.size()};
+            mf.data = vertices.data();
+            mf.indices = indices.data();
+        }
+
+        auto vertexStride = mf.packed ? sizeof(meshfile::packedVertex) : sizeof(meshfile::vertexData);
+        auto indexStride = mf.shortIndices ? sizeof(unsigned short) : sizeof(unsigned int);
+        const void *vertexSource = mf.packed ? static_cast<const void*>(mf.packed) : mf.data;
+        const void *indexSource = mf.shortIndices ? static_cast<const void*>(mf.shortIndices) : mf.indices;
+        auto vertexBytes = mf.head.dataCount * vertexStride, indexBytes = mf.head.indexCount * indexStride;
+        cout << mf.head.dataCount << " vertices of " << vertexStride << " bytes, " << mf.head.indexCount << " indices of "
+            << indexStride << " bytes" << endl;
+
+        auto encodedVertices = game::meshcodec::encodeVertices(vertexSource, mf.head.dataCount, vertexStride);
+        auto encodedIndices = mf.shortIndices ? game::meshcodec::encodeIndices(mf.shortIndices, mf.head.indexCount)
+            : game::meshcodec::encodeIndices(mf.indices, mf.head.indexCount);
+
+        vector<char> decodedVertices(vertexBytes), decodedIndices(indexBytes);
+        auto decodeVertices = [&]() {
+            game::meshcodec::decodeVertices(encodedVertices.data(), encodedVertices.size(), decodedVertices.data(), mf.head.dataCount, vertexStride);
+        };
+        auto decodeIndices = [&]() {
+            if (mf.shortIndices)
+                game::meshcodec::decodeIndices(encodedIndices.data(), encodedIndices.size(), reinterpret_cast<unsigned short*>(decodedIndices.data()), mf.head.indexCount);
+            else
+                game::meshcodec::decodeIndices(encodedIndices.data(), encodedIndices.size(), reinterpret_cast<unsigned int*>(decodedIndices.data()), mf.head.indexCount);
+        };
+
+        auto vertexTime = decodeRate(vertexBytes, decodeVertices), indexTime = decodeRate(indexBytes, decodeIndices);
+        if (memcmp(decodedVertices.data(), vertexSource, vertexBytes) || memcmp(decodedIndices.data(), indexSource, indexBytes)) {
+            cout << "output mismatch" << endl;
+            return 1;
+        }
+
+        auto ratio = [](size_t raw, size_t encoded) { return static_cast<double>(raw) / max<size_t>(encoded, 1); };
+        cout << "vertices: " << vertexBytes << " -> " << encodedVertices.size() << " bytes, " << fixed << setprecision(2)
+            << ratio(vertexBytes, encodedVertices.size()) << "x, decode " << vertexBytes / vertexTime / 1e9 << " GB/s" << defaultfloat << endl;
+        cout << "indices: " << indexBytes << " -> " << encodedIndices.size() << " bytes, " << fixed << setprecision(2)
+            << ratio(indexBytes, encodedIndices.size()) << "x, decode " << indexBytes / indexTime / 1e9 << " GB/s" << defaultfloat << endl;
+
+        // Whole files through the loader, the raw one is mapped since that is the fastest way to load it
+        auto raw = (filesystem::temp_directory_path() / "meshbench.msh").string();
+        auto compressed = (filesystem::temp_directory_path() / "meshbench.z.msh").string();
+        mf.toFile(raw);
+        mf.toFile(compressed, true);
+        if (!vertices.empty()) {
+            mf.data = nullptr;
+            mf.indices = nullptr;
+        }
+
+        auto rawSize = filesystem::file_size(raw), compressedSize = filesystem::file_size(compressed);
+        auto runs = max<size_t>(3, 1'000'000'000 / (vertexBytes + indexBytes));
+        volatile size_t sink = 0;
+        auto mapped = measure([&]() {
+            for (size_t r = 0; r < runs; ++r)
+                sink = sink + meshfile(raw, meshfile::loadMode::map).head.dataCount;
+        });
+        auto decoded = measure([&]() {
+            for (size_t r = 0; r < runs; ++r)
+                sink = sink + meshfile(compressed, meshfile::loadMode::map).head.dataCount;
+        });
+
+        cout << "files: " << rawSize << " -> " << compressedSize << " bytes, " << runs << " runs (warm page cache)" << endl;
+        report("mmap", mapped / runs, vertexBytes + indexBytes, "B");
+        report("decode", decoded / runs, vertexBytes + indexBytes, "B");
+
+        filesystem::remove(raw);
+        filesystem::remove(compressed);
+        return 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    ios_base::sync_with_stdio(false);
+
+    string_view mode = argc > 1 ? argv[1] : "";
+    if (mode == "weld") {
+        return benchWeld(argc > 2 ? stoull(argv[2]) : 6'000'000);
+    }
+    else if (mode == "load") {
+        vector<size_t> sizes;
+        for (auto i = 2; i < argc; ++i)
+            sizes.push_back(stoull(argv[i]));
+        if (sizes.empty())
+            sizes = {6'000, 60'000, 600'000, 6'000'000};
+        return benchLoad(sizes);
+    }
+
+    else if (mode == "codec") {
+        return benchCodec(argc > 2 ? argv[2] : "");
+    }
+
+    cout << "Usage: meshbench weld [corners]" << endl;
+    cout << "       meshbench load [corners...]" << endl;
+    cout << "       meshbench codec [corners | file.msh]" << endl;
+    return 0;
+}
\ No newline at end of file
@@ -1,152 +1,504 @@
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
 #include <glm/glm.hpp>
 
 #include <iostream>
+#include <iomanip>
 #include <algorithm>
-#include <unordered_map>
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <mutex>
+#include <fstream>
+#include <filesystem>
 #include "application/mesh.hpp"
+#include "converter/obj.hpp"
+#include "converter/weld.hpp"
+#include "converter/vcache.hpp"
+#include "converter/overdraw.hpp"
+#include "converter/vfetch.hpp"
+#include "converter/split.hpp"
+#include "converter/simplify.hpp"
+#include "converter/meshlet.hpp"
+#include "converter/stream.hpp"
+#include "converter/batch.hpp"
+#include "converter/stats.hpp"
 
 using namespace std;
 
-static uint32_t rotl(const uint32_t value, int shift) 
+namespace
 {
-    if ((shift &= sizeof(value)*8 - 1) == 0)
-      return value;
-    return (value << shift) | (value >> (sizeof(value)*8 - shift));
-}
-
-namespace std
-{
-    // SHA-1 like function on game::meshfile::vertexData
-    template<>
-    struct hash<game::meshfile::vertexData> 
+    struct options
     {
-        uint64_t operator()(const game::meshfile::vertexData& v) const
+        bool vertexCache = false, overdraw = false, vertexFetch = false, quantize = false, wide = false, lods = false, meshlets = false;
+
+        bool compress = false;
+
+        bool info = false, json = false;
+
+        game::converter::weldGrid grid;
+
+        // Raised whenever the converter writes different files for the same input and options
+        static constexpr unsigned version = 2;
+
+        // Everything that changes the output file, batch mode converts files again when it changes
+        string key() const
         {
-            static_assert(sizeof(v) % 4 == 0 && sizeof(v) <= 512-96);
-            
-            // Prep the data stream
-            uint32_t block[80] = {};
-            std::copy(reinterpret_cast<const char*>(&v), reinterpret_cast<const char*>(&v)+sizeof(v), block);
-            block[sizeof(v)/4] = 0x80;
-            block[14] = sizeof(v);
-
-            // Initialize the variables
-            uint32_t h0 = 0x67452301, h1 = 0xEFCDAB89, h2 = 0x98BADCFE, h3 = 0x10325476, h4 = 0xC3D2E1F0;
-            for (auto i = 16; i < 80; ++i) {
-                block[i] = rotl(block[i-3] ^ block[i-8] ^ block[i-14] ^ block[i-16], 1);
-            }
+            ostringstream out;
+            out << version << ' ' << game::meshfile::version << vertexCache << overdraw << vertexFetch << quantize << wide << lods << meshlets << compress
+                << json << hexfloat << ' ' << grid.position << ' ' << grid.texcoord << ' ' << grid.normal;
+            return out.str();
+        }
+    };
 
-            // Main algorithm
-            uint32_t a = h0, b = h1, c = h2, d = h3, e = h4, f, k;
-            for (auto i = 0; i < 80; ++i) {
-                if (i < 20) {
-                    f = (b & c) | ((~b) & d);
-                    k = 0x5A827999;
-                }
-                else if (i < 40) {
-                    f = b ^ c ^ d;
-                    k = 0x6ED9EBA1;
-                }
-                else if (i < 60) {
-                    f = (b & c) | (b & d) | (c & d);
-                    k = 0x8F1BBCDC;
+    // Converts one obj file and reports the mtl libraries it referenced, returns false when it could not be loaded
+    bool convertObj(const string& name, const string& outname, const options& opt, unsigned threads, ostream& log,
+        vector<string>& libraries)
+    {
+        game::converter::objMesh obj;
+        try {
+            obj = game::converter::loadObj(name, threads);
+        }
+        catch (const std::exception& e) {
+            log << "Error loading file: " << e.what() << endl;
+            return false;
+        }
+
+        // One range of triangles per material, the later passes keep every triangle inside its range
+        auto materialRanges = game::converter::sortByMaterial(obj);
+        if (!obj.materials.empty())
+            log << "materials: " << obj.materials.size() << ", " << materialRanges.size() << " used" << endl;
+
+        std::vector<game::meshfile::vertexData> outdata;
+        std::vector<unsigned int> outindices;
+
+        auto corner = [&obj](size_t i) {
+            return obj.vertex(obj.corners[i]);
+        };
+        if (opt.grid.position > 0.0f) {
+            auto snapped = [&](size_t i) {
+                return game::converter::snapVertex(corner(i), opt.grid);
+            };
+            game::converter::weld(obj.corners.size(), snapped, threads, outdata, outindices);
+
+            // Weld once more without the grid to show what the snapping saved
+            game::converter::weldTable exact(outdata.size());
+            for (size_t i = 0; i < obj.corners.size(); ++i)
+                exact.weld(corner(i));
+            log << "grid weld: " << exact.size() << " exact vertices -> " << outdata.size() << " vertices, " << fixed << setprecision(1)
+                << 100.0 * (exact.size() - outdata.size()) / max<size_t>(exact.size(), 1) << "% fewer" << defaultfloat;
+
+            // Snapping collapses triangles smaller than the grid, drop them without mixing the material ranges
+            size_t kept = 0;
+            auto compact = [&](size_t begin, size_t end) {
+                auto first = kept;
+                for (auto t = begin; t+2 < end; t += 3) {
+                    auto a = outindices[t], b = outindices[t+1], c = outindices[t+2];
+                    if (a != b && b != c && a != c) {
+                        outindices[kept++] = a;
+                        outindices[kept++] = b;
+                        outindices[kept++] = c;
+                    }
                 }
-                else if (i < 80) {
-                    f = b ^ c ^ d;
-                    k = 0xCA62C1D6;
+                return first;
+            };
+            if (materialRanges.empty())
+                compact(0, outindices.size());
+            for (auto& r : materialRanges) {
+                auto first = compact(r.indexOffset, r.indexOffset + r.indexCount);
+                r.indexOffset = first;
+                r.indexCount = kept - first;
+            }
+            log << ", " << (outindices.size() - kept) / 3 << " collapsed triangles removed" << endl;
+            outindices.resize(kept);
+        }
+        else {
+            game::converter::weld(obj.corners.size(), corner, threads, outdata, outindices);
+        }
+
+        for (auto& r : materialRanges)
+            r.vertexCount = static_cast<uint32_t>(outdata.size());
+        auto forRanges = [&](auto&& pass) {
+            if (materialRanges.empty())
+                pass(outindices.data(), outindices.size());
+            for (const auto& r : materialRanges)
+                pass(outindices.data() + r.indexOffset, r.indexCount);
+        };
+
+        // Reorder the triangles for the post-transform cache
+        if (opt.vertexCache) {
+            auto before = game::converter::analyzeVertexCache(outindices.data(), outindices.size(), outdata.size());
+            forRanges([&](uint32_t *indices, size_t count) {
+                game::converter::optimizeVertexCache(indices, count, outdata.size());
+            });
+            auto after = game::converter::analyzeVertexCache(outindices.data(), outindices.size(), outdata.size());
+
+            log << fixed << setprecision(3) << "vertex cache: ACMR " << before.acmr << " -> " << after.acmr
+                << ", ATVR " << before.atvr << " -> " << after.atvr << endl;
+        }
+
+        // Sort clusters of the cache optimized triangles to reduce overdraw
+        if (opt.overdraw) {
+            auto before = game::converter::analyzeOverdraw(outindices.data(), outindices.size(), outdata.data(), outdata.size());
+            forRanges([&](uint32_t *indices, size_t count) {
+                game::converter::optimizeOverdraw(indices, count, outdata.data(), outdata.size());
+            });
+            auto after = game::converter::analyzeOverdraw(outindices.data(), outindices.size(), outdata.data(), outdata.size());
+            auto cache = game::converter::analyzeVertexCache(outindices.data(), outindices.size(), outdata.size());
+
+            log << fixed << setprecision(3) << "overdraw: " << before.overdraw << " -> " << after.overdraw
+                << ", ACMR " << cache.acmr << endl;
+        }
+
+        // Lay the vertices out in the order the index buffer uses them
+        if (opt.vertexFetch) {
+            auto vsize = sizeof(game::meshfile::vertexData);
+            auto before = game::converter::analyzeVertexFetch(outindices.data(), outindices.size(), outdata.size(), vsize);
+            game::converter::optimizeVertexFetch(outindices.data(), outindices.size(), outdata);
+            auto after = game::converter::analyzeVertexFetch(outindices.data(), outindices.size(), outdata.size(), vsize);
+
+            log << fixed << setprecision(3) << "vertex fetch: overfetch " << before.overfetch << " -> " << after.overfetch << endl;
+        }
+
+        // Split the mesh so every submesh can use 16 bit indices
+        auto submeshes = materialRanges;
+        if (!opt.wide) {
+            auto before = outdata.size();
+            submeshes = game::converter::splitMesh(outdata, outindices, materialRanges);
+            if (!submeshes.empty() && submeshes.back().baseVertex > 0)
+                log << "split: " << submeshes.size() << " submeshes, " << before << " -> " << outdata.size() << " vertices" << endl;
+        }
+
+        auto ranges = submeshes;
+        if (ranges.empty())
+            ranges.push_back({0, outindices.size(), 0, static_cast<uint32_t>(outdata.size()), 0, 0});
+
+        // Clusters of the full detail triangles for culling at runtime
+        std::vector<game::meshfile::meshlet> meshletTable;
+        if (opt.meshlets) {
+            for (uint32_t i = 0; i < ranges.size(); ++i) {
+                const auto& r = ranges[i];
+                auto built = game::converter::buildMeshlets(outindices.data(), r.indexOffset, r.indexCount, outdata.data() + r.baseVertex,
+                    r.vertexCount, i);
+                meshletTable.insert(meshletTable.end(), built.begin(), built.end());
+            }
+
+            size_t cones = count_if(meshletTable.begin(), meshletTable.end(), [](const game::meshfile::meshlet& m) {
+                return m.coneCutoff < 1.0f;
+            });
+            log << "meshlets: " << meshletTable.size() << " clusters, " << fixed << setprecision(1)
+                << static_cast<double>(outindices.size()) / 3 / max<size_t>(1, meshletTable.size()) << " triangles each, "
+                << cones << " with a normal cone" << endl;
+        }
+
+        // Every level is simplified from the previous one, per submesh so the indices stay relative to its base vertex
+        std::vector<game::meshfile::lod> lodTable;
+        if (opt.lods) {
+            std::vector<std::vector<uint32_t>> previous;
+            std::vector<float> errors(ranges.size(), 0.0f);
+            for (const auto& r : ranges)
+                previous.emplace_back(outindices.begin() + r.indexOffset, outindices.begin() + r.indexOffset + r.indexCount);
+
+            for (unsigned level = 1; level <= 3; ++level) {
+                size_t triangles = 0;
+                float levelError = 0.0f;
+
+                for (uint32_t i = 0; i < ranges.size(); ++i) {
+                    const auto& r = ranges[i];
+                    auto target = (r.indexCount / 3 >> level) * 3;
+
+                    float error;
+                    auto simplified = game::converter::simplifyMesh(previous[i].data(), previous[i].size(), outdata.data() + r.baseVertex,
+                        r.vertexCount, target, error);
+                    if (opt.vertexCache)
+                        game::converter::optimizeVertexCache(simplified.data(), simplified.size(), r.vertexCount);
+                    errors[i] = max(errors[i], error);
+
+                    lodTable.push_back({outindices.size(), simplified.size(), errors[i], i});
+                    outindices.insert(outindices.end(), simplified.begin(), simplified.end());
+                    triangles += simplified.size() / 3;
+                    levelError = max(levelError, errors[i]);
+                    previous[i] = std::move(simplified);
                 }
 
-                uint32_t tmp = rotl(a, 5) + f + e + k + block[i];
-                e = d;
-                d = c;
-                c = rotl(b, 30);
-                b = a;
-                a = tmp;
+                log << "lod " << level << ": " << triangles << " triangles, error " << scientific << setprecision(2) << levelError
+                    << defaultfloat << endl;
+            }
+        }
+
+        game::meshfile mf;
+        mf.head.dataCount = outdata.size();
+        mf.head.indexCount = outindices.size();
+        mf.data = outdata.data();
+        mf.indices = outindices.data();
+
+        // The vertex and index arrays belong to the vectors, the meshfile must not free them however it goes out of scope
+        struct borrowed
+        {
+            game::meshfile& mesh;
+
+            ~borrowed()
+            {
+                mesh.data = nullptr;
+                mesh.indices = nullptr;
             }
+        } guard{mf};
+
+        mf.submeshes = std::move(submeshes);
+        mf.lods = std::move(lodTable);
+        mf.meshlets = std::move(meshletTable);
+        mf.materials = std::move(obj.materials);
+        libraries = std::move(obj.libraries);
 
-            h0 = h0 + a;
-            h1 = h1 + b;
-            h2 = h2 + c;
-            h3 = h3 + d;
-            h4 = h4 + e;
+        // Box and sphere of the mesh and of every submesh, so models can be culled without touching the vertices
+        mf.computeBounds();
+        const auto& b = mf.bounds.front();
+        log << "bounds: " << fixed << setprecision(3) << "(" << b.min.x << ", " << b.min.y << ", " << b.min.z << ") - ("
+            << b.max.x << ", " << b.max.y << ", " << b.max.z << "), radius " << b.radius << defaultfloat << endl;
 
-            // Only line that differs from the original algorithm (64 bit output should be fine for input that is only 32 bytes)
-            return (static_cast<uint64_t>(h0 ^ h4 ) << 32) | static_cast<uint64_t>(((h1 ^ h2) << 15) ^ h3);
+        if (!opt.wide)
+            mf.narrowIndices();
+
+        // Store 16 byte vertices, the packed array is owned by the meshfile
+        if (opt.quantize) {
+            mf.pack();
+
+            float error = 0.0f;
+            for (size_t i = 0; i < outdata.size(); ++i)
+                error = max(error, glm::distance(outdata[i].position, game::meshfile::unpackVertex(mf.packed[i], mf.layout).position));
+            log << "quantized: " << sizeof(game::meshfile::vertexData) << " -> " << sizeof(game::meshfile::packedVertex)
+                << " bytes per vertex, max position error " << scientific << setprecision(2) << error << endl;
         }
-    };
+
+        mf.toFile(outname, opt.compress);
+
+        if (opt.compress) {
+            auto vertexSize = mf.head.dataCount * (mf.packed ? sizeof(game::meshfile::packedVertex) : sizeof(game::meshfile::vertexData));
+            auto indexSize = mf.head.indexCount * (mf.shortIndices ? sizeof(unsigned short) : sizeof(unsigned int));
+            auto fileSize = filesystem::file_size(outname);
+            log << "compressed: " << vertexSize + indexSize << " bytes of vertices and indices -> " << fileSize << " byte file, "
+                << fixed << setprecision(2) << double(vertexSize + indexSize) / fileSize << "x" << defaultfloat << endl;
+        }
+
+        // Measured on the file that was written, the same way mshinfo does
+        if (opt.info || opt.json) {
+            game::meshfile written(outname, game::meshfile::loadMode::map);
+            auto stats = game::converter::analyzeMesh(written, filesystem::file_size(outname));
+            if (opt.info)
+                game::converter::printStats(log, stats);
+
+            if (opt.json) {
+                auto jsonName = filesystem::path(outname).replace_extension(".stats.json").string();
+                ofstream out(jsonName, ofstream::out | ofstream::trunc);
+                game::converter::writeJson(out, outname, stats);
+                out << endl;
+                if (!out)
+                    throw runtime_error("unable to write " + jsonName);
+            }
+        }
+
+        return true;
+    }
+
+    /*
+     * Converts every obj file below dir that changed since the last run, several files at a time. The manifest
+     * in dir remembers the hashes of the inputs and the options of every file that converted successfully.
+     */
+
+    void convertDirectory(const string& dir, const options& opt, unsigned threads)
+    {
+        using game::converter::manifest;
+
+        auto start = chrono::steady_clock::now();
+        auto files = game::converter::findObjFiles(dir);
+        auto manifestPath = (filesystem::path(dir) / "obj2msh.manifest").string();
+        manifest previous(manifestPath), next;
+
+        auto key = opt.key();
+        auto optionsHash = game::converter::hashBytes(key.data(), key.size());
+
+        // Small files convert one per thread, the threads left over go to the conversions themselves
+        auto workers = static_cast<unsigned>(max<size_t>(1, min<size_t>(threads, files.size())));
+        auto perFile = max(1u, threads / workers);
+
+        enum class result { skipped, converted, failed };
+        vector<result> results(files.size(), result::failed);
+        vector<manifest::entry> entries(files.size());
+        mutex output;
+
+        game::converter::parallelEach(workers, files.size(), [&](size_t i, unsigned) {
+            auto path = filesystem::path(dir) / files[i];
+            auto outname = filesystem::path(path).replace_extension(".msh").string();
+            auto& e = entries[i];
+            e.hash = game::converter::hashFile(path.string());
+            e.options = optionsHash;
+
+            auto old = previous.find(files[i]);
+            if (old && e.hash && old->hash == e.hash && old->options == e.options && filesystem::exists(outname)
+                && all_of(old->libraries.begin(), old->libraries.end(), [&](const auto& l) {
+                    return game::converter::hashFile((filesystem::path(dir) / l.first).string()) == l.second;
+                })) {
+                e = *old;
+                results[i] = result::skipped;
+                return;
+            }
+
+            ostringstream log;
+            vector<string> libraries;
+            try {
+                if (convertObj(path.string(), outname, opt, perFile, log, libraries))
+                    results[i] = result::converted;
+            }
+            catch (const std::exception& ex) {
+                log << "Error converting file: " << ex.what() << endl;
+            }
+
+            auto parent = filesystem::path(files[i]).parent_path();
+            for (const auto& l : libraries) {
+                auto library = (parent / l).lexically_normal().generic_string();
+                e.libraries.emplace_back(library, game::converter::hashFile((filesystem::path(dir) / library).string()));
+            }
+
+            lock_guard<mutex> lock(output);
+            cout << files[i] << ":" << endl << log.str();
+        });
+
+        size_t counts[3] = {};
+        for (size_t i = 0; i < files.size(); ++i) {
+            ++counts[static_cast<int>(results[i])];
+            if (results[i] != result::failed)
+                next.set(files[i], std::move(entries[i]));
+        }
+        next.save(manifestPath);
+
+        auto seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "batch: " << counts[static_cast<int>(result::converted)] << " converted, " << counts[static_cast<int>(result::skipped)]
+            << " up to date, " << counts[static_cast<int>(result::failed)] << " failed in " << fixed << setprecision(2) << seconds << " s"
+            << defaultfloat << endl;
+    }
 }
 
 int main(int argc, char *argv[])
 {
     ios_base::sync_with_stdio(false);
 
-    if (argc < 2) {
-        cout << "No input file given" << endl;
-        return 0;
+    const char *input = nullptr;
+    unsigned threads = game::converter::defaultThreads();
+    options opt;
+    size_t streamBudget = 0;
+
+    for (auto i = 1; i < argc; ++i) {
+        string_view arg(argv[i]);
+        if (arg == "-j" && i+1 < argc) {
+            threads = static_cast<unsigned>(max(1, atoi(argv[++i])));
+        }
+        else if (arg == "-c") {
+            opt.vertexCache = true;
+        }
+        else if (arg == "-o") {
+            opt.vertexCache = true;
+            opt.overdraw = true;
+        }
+        else if (arg == "-f") {
+            opt.vertexFetch = true;
+        }
+        else if (arg == "-q") {
+            opt.quantize = true;
+        }
+        else if (arg == "-w") {
+            opt.wide = true;
+        }
+        else if (arg == "-l") {
+            opt.lods = true;
+        }
+        else if (arg == "-m") {
+            opt.meshlets = true;
+        }
+        else if (arg == "-z") {
+            opt.compress = true;
+        }
+        else if (arg == "-i") {
+            opt.info = true;
+        }
+        else if (arg == "-J") {
+            opt.json = true;
+        }
+        else if (arg == "-e" && i+1 < argc) {
+            // Position step, optionally followed by the texcoord and normal steps
+            char *next = argv[++i];
+            opt.grid.position = strtof(next, &next);
+            opt.grid.texcoord = *next == ',' ? strtof(next+1, &next) : 1.0f / 4096.0f;
+            opt.grid.normal = *next == ',' ? strtof(next+1, &next) : 1.0f / 1024.0f;
+            if (opt.grid.position <= 0.0f || opt.grid.texcoord < 0.0f || opt.grid.normal < 0.0f) {
+                cout << "Weld steps must be positive" << endl;
+                return 0;
+            }
+        }
+        else if (arg == "-s" && i+1 < argc) {
+            streamBudget = static_cast<size_t>(max(1, atoi(argv[++i]))) << 20;
+        }
+        else if (!input && arg[0] != '-') {
+            input = argv[i];
+        }
+        else {
+            cout << "Unexpected input" << endl;
+            cout << "Usage: obj2msh [-j threads] [-c] [-o] [-f] [-q] [-w] [-l] [-m] [-z] [-i] [-J] [-e step[,uv[,normal]]] [-s megabytes] <file.obj | directory>" << endl;
+            cout << "  -c  vertex cache order, -o  overdraw order (implies -c), -f  vertex fetch order, -q  quantize vertices" << endl;
+            cout << "  -w  keep 32 bit indices instead of splitting the mesh into submeshes of at most 65536 vertices" << endl;
+            cout << "  -l  add three simplified levels of detail with 50, 25 and 12.5% of the triangles" << endl;
+            cout << "  -m  add clusters of 64 vertices and 124 triangles with culling bounds, best combined with -c" << endl;
+            cout << "  -z  compress the vertices and indices with the lossless mesh codec, decoded when the file is loaded" << endl;
+            cout << "  -i  report vertex cache, overdraw, dedup and bounds figures of the written file, -J  write them to <file>.stats.json" << endl;
+            cout << "  -e  weld vertices on a grid of the given position step, texcoords and normals use 1/4096 and 1/1024 by default" << endl;
+            cout << "  -s  stream files larger than memory through spill files within the given budget, without the other passes" << endl;
+            cout << "  a directory converts every obj file below it that changed since the last run, see obj2msh.manifest" << endl;
+            return 0;
+        }
     }
-    else if (argc > 2) {
-        cout << "Unexpected input" << endl;
+
+    if (!input) {
+        cout << "No input file given" << endl;
         return 0;
     }
 
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
+    if (filesystem::is_directory(input)) {
+        if (streamBudget)
+            cout << "Streaming is not available for directories, converting in memory" << endl;
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, argv[1])) {
-        cout << "Error loading file: " << err << endl;
+        try {
+            convertDirectory(input, opt, threads);
+        }
+        catch (const std::exception& e) {
+            cout << "Error converting directory: " << e.what() << endl;
+        }
         return 0;
     }
 
-    std::unordered_map<game::meshfile::vertexData, unsigned int> outhash;
-    std::vector<game::meshfile::vertexData> outdata;
-    std::vector<unsigned int> outindices;
-
-    for (const auto& shape : shapes) {
-        for (const auto& index : shape.mesh.indices) {
-            game::meshfile::vertexData tmp;
-
-            tmp.position = {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
-            };
-
-            tmp.texcoord = {
-                attrib.texcoords[2 * index.texcoord_index + 0],
-                1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-            };
+    std::string name(input);
+    std::string outname = name.substr(0, name.find_last_of('.')).append(".msh");
 
-			tmp.normal = {
-				attrib.normals[3 * index.normal_index + 0],
-				attrib.normals[3 * index.normal_index + 1],
-				attrib.normals[3 * index.normal_index + 2]
-			};
+    if (streamBudget) {
+        if (opt.vertexCache || opt.vertexFetch || opt.quantize || opt.wide || opt.lods || opt.meshlets || opt.compress || opt.info || opt.json
+            || opt.grid.position > 0.0f)
+            cout << "Streaming writes plain 32 bit meshes, the other options are ignored" << endl;
 
-            if (outhash.count(tmp) == 0) {
-                outhash[tmp] = outhash.size();
-                outdata.push_back(tmp);
-            }
-            outindices.push_back(outhash[tmp]);
+        try {
+            auto stats = game::converter::convertStreaming(name, outname, streamBudget, threads);
+            cout << "streamed: " << stats.corners / 3 << " triangles, " << stats.positions << " positions -> " << stats.vertices
+                << " vertices, " << stats.partitions << " partitions, " << stats.windows << " windows, "
+                << (stats.spillBytes >> 20) << " MB spilled" << endl;
         }
+        catch (const std::exception& e) {
+            cout << "Error converting file: " << e.what() << endl;
+        }
+        return 0;
     }
 
-    std::string name(argv[1]);
-    std::string outname = name.substr(0, name.find_last_of('.')).append(".msh");
-    
-    game::meshfile mf;
-    mf.head.dataCount = outdata.size();
-    mf.head.indexCount = outindices.size();
-    mf.data = outdata.data();
-    mf.indices = outindices.data();
-
-    mf.toFile(outname);
-
-    mf.data = nullptr;
-    mf.indices = nullptr;
+    try {
+        vector<string> libraries;
+        convertObj(name, outname, opt, threads, cout, libraries);
+    }
+    catch (const std::exception& e) {
+        cout << "Error converting file: " << e.what() << endl;
+    }
 
     return 0;
 }
\ No newline at end of file
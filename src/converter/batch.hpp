@@ -0,0 +1,161 @@
+#pragma once
+
+#include "weld.hpp"
+#include "base/filemap.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace game::converter
+{
+    // Same mixing as hashVertex over 8 byte words, the tail and the length go into the last word
+    inline uint64_t hashBytes(const char *data, size_t size)
+    {
+        // Nothing to read, data may be null
+        if (size == 0)
+            return 0;
+
+        uint64_t h = 0x9E3779B97F4A7C15ull ^ size;
+        auto mix = [&h](uint64_t w) {
+            w *= 0x87C37B91114253D5ull;
+            w = rotl64(w, 31);
+            w *= 0x4CF5AD432745937Full;
+            h ^= w;
+            h = rotl64(h, 27) * 5 + 0x52DCE729;
+        };
+
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t w;
+            std::memcpy(&w, data + i, 8);
+            mix(w);
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, data + i, size - i);
+        mix(tail);
+
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // Hash of the file contents, 0 when the file cannot be read so a missing file never matches an entry
+    inline uint64_t hashFile(const std::string& path)
+    {
+        try {
+            native::fileMapping file(path);
+            return std::max<uint64_t>(1, hashBytes(file.data(), file.size()));
+        }
+        catch (const std::exception&) {
+            return 0;
+        }
+    }
+
+    /*
+     * Content hashes of the inputs of every converted file, stored next to the assets. A file is up to date when
+     * the obj file, every mtl library it used and the converter options still hash to the stored values and the
+     * msh file exists. The file is plain text with one line per obj file and one indented line per library:
+     *
+     *     <obj hash> <options hash> <obj path>
+     *       <mtl hash> <mtl path>
+     *
+     * Paths are relative to the directory of the manifest.
+     */
+
+    class manifest
+    {
+    public:
+
+        struct entry
+        {
+            uint64_t hash = 0;
+
+            uint64_t options = 0;
+
+            std::vector<std::pair<std::string, uint64_t>> libraries;
+        };
+
+        static constexpr const char *header = "obj2msh manifest 1";
+
+        manifest()
+        {
+        }
+
+        // A missing or unreadable manifest is an empty one, everything then gets converted
+        manifest(const std::string& path)
+        {
+            std::ifstream in(path);
+            std::string line;
+            if (!std::getline(in, line) || line != header)
+                return;
+
+            entry *current = nullptr;
+            while (std::getline(in, line)) {
+                unsigned long long hash, options;
+                int used = 0;
+                if (line.compare(0, 2, "  ") == 0 && current && std::sscanf(line.c_str(), " %llx %n", &hash, &used) == 1) {
+                    current->libraries.emplace_back(line.substr(used), hash);
+                }
+                else if (std::sscanf(line.c_str(), "%llx %llx %n", &hash, &options, &used) == 2) {
+                    current = &_entries[line.substr(used)];
+                    *current = {hash, options, {}};
+                }
+            }
+        }
+
+        const entry * find(const std::string& path) const
+        {
+            auto it = _entries.find(path);
+            return it == _entries.end() ? nullptr : &it->second;
+        }
+
+        void set(const std::string& path, entry e)
+        {
+            _entries[path] = std::move(e);
+        }
+
+        // Writes a temporary file first, an interrupted build never leaves a truncated manifest behind
+        void save(const std::string& path) const
+        {
+            auto temporary = path + ".tmp";
+            {
+                std::ofstream out(temporary, std::ofstream::out | std::ofstream::trunc);
+                if (!out.is_open())
+                    throw std::runtime_error("unable to create manifest file");
+
+                out << header << '\n' << std::hex;
+                for (const auto& [name, e] : _entries) {
+                    out << e.hash << ' ' << e.options << ' ' << name << '\n';
+                    for (const auto& [library, hash] : e.libraries)
+                        out << "  " << hash << ' ' << library << '\n';
+                }
+            }
+            std::filesystem::rename(temporary, path);
+        }
+
+    private:
+
+        std::map<std::string, entry> _entries;
+    };
+
+    // Every obj file below dir in a fixed order, as paths relative to dir
+    inline std::vector<std::string> findObjFiles(const std::string& dir)
+    {
+        std::vector<std::string> out;
+        for (const auto& f : std::filesystem::recursive_directory_iterator(dir)) {
+            if (f.is_regular_file() && f.path().extension() == ".obj")
+                out.push_back(f.path().lexically_relative(dir).generic_string());
+        }
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+}
\ No newline at end of file
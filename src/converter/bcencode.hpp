@@ -0,0 +1,500 @@
+#pragma once
+
+#include "application/bcdecode.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace game::converter
+{
+    /*
+     * Block compression encoders for img2tex. The endpoints of a block start at the extremes of its texels along
+     * their principal axis and are then refined by least squares on the chosen indices, keeping whichever
+     * candidate decodes closest to the source. BC7 tries mode 6, a single line through RGBA with 4 bit indices,
+     * and mode 5, which fits alpha on a line of its own for blocks where color and alpha do not change together.
+     */
+
+    namespace bcn
+    {
+        // Principal axis of the texels by power iteration, channels is 3 or 4
+        template<int channels>
+        inline void principalAxis(const float (*px)[4], const float *mean, float *axis)
+        {
+            float cov[4][4] = {};
+            for (auto i = 0; i < 16; ++i) {
+                for (auto a = 0; a < channels; ++a) {
+                    for (auto b = 0; b < channels; ++b)
+                        cov[a][b] += (px[i][a] - mean[a]) * (px[i][b] - mean[b]);
+                }
+            }
+
+            for (auto c = 0; c < channels; ++c)
+                axis[c] = 1.0f;
+            for (auto iteration = 0; iteration < 8; ++iteration) {
+                float next[4] = {}, length = 0.0f;
+                for (auto a = 0; a < channels; ++a) {
+                    for (auto b = 0; b < channels; ++b)
+                        next[a] += cov[a][b] * axis[b];
+                    length = std::max(length, std::abs(next[a]));
+                }
+                if (length == 0.0f)
+                    return;
+                for (auto c = 0; c < channels; ++c)
+                    axis[c] = next[c] / length;
+            }
+        }
+
+        // Endpoints at the extremes of the projection of the texels onto the principal axis
+        template<int channels>
+        inline void initialEndpoints(const float (*px)[4], float *e0, float *e1)
+        {
+            float mean[4] = {}, axis[4] = {};
+            for (auto i = 0; i < 16; ++i) {
+                for (auto c = 0; c < channels; ++c)
+                    mean[c] += px[i][c] / 16.0f;
+            }
+            principalAxis<channels>(px, mean, axis);
+
+            float lo = 0.0f, hi = 0.0f, length = 0.0f;
+            for (auto c = 0; c < channels; ++c)
+                length += axis[c] * axis[c];
+            for (auto i = 0; i < 16; ++i) {
+                float t = 0.0f;
+                for (auto c = 0; c < channels; ++c)
+                    t += (px[i][c] - mean[c]) * axis[c];
+                t = length > 0.0f ? t / length : 0.0f;
+                lo = std::min(lo, t);
+                hi = std::max(hi, t);
+            }
+            for (auto c = 0; c < channels; ++c) {
+                e0[c] = std::clamp(mean[c] + axis[c] * hi, 0.0f, 255.0f);
+                e1[c] = std::clamp(mean[c] + axis[c] * lo, 0.0f, 255.0f);
+            }
+        }
+
+        // Least squares endpoints for fixed interpolation weights, false when all weights are the same
+        template<int channels>
+        inline bool solveEndpoints(const float (*px)[4], const float *weights, float *e0, float *e1)
+        {
+            float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[4] = {}, bx[4] = {};
+            for (auto i = 0; i < 16; ++i) {
+                auto b = weights[i], a = 1.0f - b;
+                aa += a*a;
+                ab += a*b;
+                bb += b*b;
+                for (auto c = 0; c < channels; ++c) {
+                    ax[c] += a * px[i][c];
+                    bx[c] += b * px[i][c];
+                }
+            }
+
+            auto det = aa*bb - ab*ab;
+            if (std::abs(det) < 1e-6f)
+                return false;
+            for (auto c = 0; c < channels; ++c) {
+                e0[c] = std::clamp((ax[c]*bb - bx[c]*ab) / det, 0.0f, 255.0f);
+                e1[c] = std::clamp((bx[c]*aa - ax[c]*ab) / det, 0.0f, 255.0f);
+            }
+            return true;
+        }
+
+        inline uint16_t pack565(const float *c)
+        {
+            auto r = static_cast<uint16_t>(std::lround(c[0] * 31.0f / 255.0f));
+            auto g = static_cast<uint16_t>(std::lround(c[1] * 63.0f / 255.0f));
+            auto b = static_cast<uint16_t>(std::lround(c[2] * 31.0f / 255.0f));
+            return static_cast<uint16_t>(r << 11 | g << 5 | b);
+        }
+
+        // Picks the closest of the four colors for every texel, returns the squared error
+        inline float colorIndices(const float (*px)[4], uint16_t c0, uint16_t c1, uint8_t *indices)
+        {
+            uint8_t block[8] = {static_cast<uint8_t>(c0), static_cast<uint8_t>(c0 >> 8), static_cast<uint8_t>(c1),
+                static_cast<uint8_t>(c1 >> 8), 0, 0x55, 0xAA, 0xFF};
+            // Decoding a block with the indices 0 to 3 in consecutive rows gives color k at texel 4k
+            uint8_t palette[64];
+            bc::decodeColor(block, palette, true);
+
+            float total = 0.0f;
+            for (auto i = 0; i < 16; ++i) {
+                auto best = 1e30f;
+                for (auto k = 0; k < 4; ++k) {
+                    float error = 0.0f;
+                    for (auto c = 0; c < 3; ++c) {
+                        auto d = px[i][c] - palette[k * 16 + c];
+                        error += d*d;
+                    }
+                    if (error < best) {
+                        best = error;
+                        indices[i] = static_cast<uint8_t>(k);
+                    }
+                }
+                total += best;
+            }
+            return total;
+        }
+
+        // Four color block, c0 > c1 so BC1 decoders do not switch to three colors and transparency
+        inline void encodeColor(const float (*px)[4], uint8_t *out)
+        {
+            constexpr float weightOf[4] = {0.0f, 1.0f, 1.0f/3.0f, 2.0f/3.0f};
+
+            float e0[4], e1[4];
+            initialEndpoints<3>(px, e0, e1);
+
+            uint16_t best0 = pack565(e0), best1 = pack565(e1);
+            uint8_t indices[16], bestIndices[16];
+            auto bestError = colorIndices(px, best0, best1, bestIndices);
+
+            for (auto iteration = 0; iteration < 2; ++iteration) {
+                float weights[16];
+                for (auto i = 0; i < 16; ++i)
+                    weights[i] = weightOf[bestIndices[i]];
+                if (!solveEndpoints<3>(px, weights, e0, e1))
+                    break;
+
+                auto c0 = pack565(e0), c1 = pack565(e1);
+                auto error = colorIndices(px, c0, c1, indices);
+                if (error >= bestError)
+                    break;
+                best0 = c0;
+                best1 = c1;
+                bestError = error;
+                std::copy(indices, indices+16, bestIndices);
+            }
+
+            // Swapping the endpoints swaps index 0 with 1 and 2 with 3
+            if (best0 < best1) {
+                std::swap(best0, best1);
+                for (auto& i : bestIndices)
+                    i ^= 1;
+            }
+            else if (best0 == best1) {
+                std::fill(bestIndices, bestIndices+16, 0);
+            }
+
+            uint32_t bits = 0;
+            for (auto i = 0; i < 16; ++i)
+                bits |= uint32_t(bestIndices[i]) << (2*i);
+            out[0] = static_cast<uint8_t>(best0);
+            out[1] = static_cast<uint8_t>(best0 >> 8);
+            out[2] = static_cast<uint8_t>(best1);
+            out[3] = static_cast<uint8_t>(best1 >> 8);
+            std::memcpy(out + 4, &bits, 4);
+        }
+
+        // BC4 style alpha with eight values between the largest and the smallest alpha
+        inline void encodeAlpha(const float (*px)[4], uint8_t *out)
+        {
+            float lo = 255.0f, hi = 0.0f;
+            for (auto i = 0; i < 16; ++i) {
+                lo = std::min(lo, px[i][3]);
+                hi = std::max(hi, px[i][3]);
+            }
+            auto a0 = static_cast<uint8_t>(std::lround(hi)), a1 = static_cast<uint8_t>(std::lround(lo));
+
+            uint8_t palette[8] = {a0, a1};
+            for (auto i = 1; i < 7; ++i)
+                palette[i+1] = static_cast<uint8_t>(((7-i)*a0 + i*a1 + 3) / 7);
+
+            uint64_t bits = 0;
+            for (auto i = 0; a0 != a1 && i < 16; ++i) {
+                uint64_t best = 0;
+                for (uint64_t k = 1; k < 8; ++k) {
+                    if (std::abs(px[i][3] - palette[k]) < std::abs(px[i][3] - palette[best]))
+                        best = k;
+                }
+                bits |= best << (3*i);
+            }
+
+            out[0] = a0;
+            out[1] = a1;
+            for (auto i = 0; i < 6; ++i)
+                out[2+i] = static_cast<uint8_t>(bits >> (8*i));
+        }
+
+        // Closest mode 6 weight for every texel with the endpoints expanded to 8 bits, returns the squared error
+        inline float mode6Indices(const float (*px)[4], const uint8_t (*endpoints)[4], uint8_t *indices)
+        {
+            float palette[16][4];
+            for (auto k = 0; k < 16; ++k) {
+                auto w = bc::bc7Weights4[k];
+                for (auto c = 0; c < 4; ++c)
+                    palette[k][c] = static_cast<float>(((64-w)*endpoints[0][c] + w*endpoints[1][c] + 32) >> 6);
+            }
+
+            float total = 0.0f;
+            for (auto i = 0; i < 16; ++i) {
+                auto best = 1e30f;
+                for (auto k = 0; k < 16; ++k) {
+                    float error = 0.0f;
+                    for (auto c = 0; c < 4; ++c) {
+                        auto d = px[i][c] - palette[k][c];
+                        error += d*d;
+                    }
+                    if (error < best) {
+                        best = error;
+                        indices[i] = static_cast<uint8_t>(k);
+                    }
+                }
+                total += best;
+            }
+            return total;
+        }
+
+        struct bitWriter
+        {
+            uint8_t *block;
+
+            unsigned position = 0;
+
+            void write(unsigned value, unsigned count)
+            {
+                for (unsigned i = 0; i < count; ++i, ++position)
+                    block[position >> 3] |= static_cast<uint8_t>(((value >> i) & 1u) << (position & 7));
+            }
+        };
+
+        inline void encodeMode6(const float (*px)[4], uint8_t *out)
+        {
+            float e0[4], e1[4];
+            initialEndpoints<4>(px, e0, e1);
+
+            uint8_t best[2][4] = {}, indices[16], bestIndices[16] = {};
+            unsigned bestP[2] = {};
+            auto bestError = 1e30f;
+
+            for (auto iteration = 0; iteration < 3; ++iteration) {
+                auto improved = false;
+
+                // Every combination of the two p-bits, the p-bit is the lowest bit of all channels of an endpoint
+                for (unsigned p = 0; p < 4; ++p) {
+                    unsigned pbits[2] = {p & 1, p >> 1};
+                    uint8_t endpoints[2][4];
+                    for (auto c = 0; c < 4; ++c) {
+                        auto q0 = std::clamp<long>(std::lround((e0[c] - pbits[0]) / 2.0f), 0, 127);
+                        auto q1 = std::clamp<long>(std::lround((e1[c] - pbits[1]) / 2.0f), 0, 127);
+                        endpoints[0][c] = static_cast<uint8_t>(q0 << 1 | pbits[0]);
+                        endpoints[1][c] = static_cast<uint8_t>(q1 << 1 | pbits[1]);
+                    }
+
+                    auto error = mode6Indices(px, endpoints, indices);
+                    if (error < bestError) {
+                        bestError = error;
+                        std::memcpy(best, endpoints, sizeof(best));
+                        std::copy(indices, indices+16, bestIndices);
+                        bestP[0] = pbits[0];
+                        bestP[1] = pbits[1];
+                        improved = true;
+                    }
+                }
+
+                float weights[16];
+                for (auto i = 0; i < 16; ++i)
+                    weights[i] = bc::bc7Weights4[bestIndices[i]] / 64.0f;
+                if (!improved || !solveEndpoints<4>(px, weights, e0, e1))
+                    break;
+            }
+
+            // The highest index bit of the first texel is implied zero, swap the endpoints when it is set
+            if (bestIndices[0] & 8) {
+                std::swap(best[0], best[1]);
+                std::swap(bestP[0], bestP[1]);
+                for (auto& i : bestIndices)
+                    i = static_cast<uint8_t>(15 - i);
+            }
+
+            std::memset(out, 0, 16);
+            bitWriter bits = {out};
+            bits.write(1 << 6, 7);
+            for (auto c = 0; c < 4; ++c) {
+                bits.write(best[0][c] >> 1, 7);
+                bits.write(best[1][c] >> 1, 7);
+            }
+            bits.write(bestP[0], 1);
+            bits.write(bestP[1], 1);
+            for (auto i = 0; i < 16; ++i)
+                bits.write(bestIndices[i], i == 0 ? 3 : 4);
+        }
+
+        inline uint8_t expand7(unsigned v)
+        {
+            return static_cast<uint8_t>(v << 1 | v >> 6);
+        }
+
+        // Closest of the four mode 5 weights for the channels first to last, returns the squared error
+        inline float mode5Indices(const float (*px)[4], const uint8_t (*endpoints)[4], int first, int last, uint8_t *indices)
+        {
+            float palette[4][4];
+            for (auto k = 0; k < 4; ++k) {
+                for (auto c = first; c <= last; ++c)
+                    palette[k][c] = bc::bc7Interpolate(endpoints[0][c], endpoints[1][c], bc::bc7Weights2[k]);
+            }
+
+            float total = 0.0f;
+            for (auto i = 0; i < 16; ++i) {
+                auto best = 1e30f;
+                for (auto k = 0; k < 4; ++k) {
+                    float error = 0.0f;
+                    for (auto c = first; c <= last; ++c) {
+                        auto d = px[i][c] - palette[k][c];
+                        error += d*d;
+                    }
+                    if (error < best) {
+                        best = error;
+                        indices[i] = static_cast<uint8_t>(k);
+                    }
+                }
+                total += best;
+            }
+            return total;
+        }
+
+        // Rotation is always 0, color gets 7 bit endpoints and alpha 8 bit endpoints, both with 2 bit indices
+        inline void encodeMode5(const float (*px)[4], uint8_t *out)
+        {
+            float e0[4], e1[4];
+            initialEndpoints<3>(px, e0, e1);
+
+            auto quantize = [](const float *e, uint8_t *q) {
+                for (auto c = 0; c < 3; ++c)
+                    q[c] = expand7(static_cast<unsigned>(std::lround(e[c] * 127.0f / 255.0f)));
+            };
+
+            uint8_t best[2][4] = {}, indices[16], colorIndices[16], alphaIndices[16];
+            quantize(e0, best[0]);
+            quantize(e1, best[1]);
+            auto bestError = mode5Indices(px, best, 0, 2, colorIndices);
+
+            for (auto iteration = 0; iteration < 2; ++iteration) {
+                float weights[16];
+                for (auto i = 0; i < 16; ++i)
+                    weights[i] = bc::bc7Weights2[colorIndices[i]] / 64.0f;
+                if (!solveEndpoints<3>(px, weights, e0, e1))
+                    break;
+
+                uint8_t endpoints[2][4] = {};
+                quantize(e0, endpoints[0]);
+                quantize(e1, endpoints[1]);
+                auto error = mode5Indices(px, endpoints, 0, 2, indices);
+                if (error >= bestError)
+                    break;
+                bestError = error;
+                std::memcpy(best, endpoints, sizeof(best));
+                std::copy(indices, indices+16, colorIndices);
+            }
+
+            float lo = 255.0f, hi = 0.0f;
+            for (auto i = 0; i < 16; ++i) {
+                lo = std::min(lo, px[i][3]);
+                hi = std::max(hi, px[i][3]);
+            }
+            best[0][3] = static_cast<uint8_t>(std::lround(hi));
+            best[1][3] = static_cast<uint8_t>(std::lround(lo));
+            mode5Indices(px, best, 3, 3, alphaIndices);
+
+            // Both first indices have their highest bit implied zero
+            uint8_t anchors[2] = {colorIndices[0], alphaIndices[0]};
+            if (anchors[0] & 2) {
+                for (auto c = 0; c < 3; ++c)
+                    std::swap(best[0][c], best[1][c]);
+                for (auto& i : colorIndices)
+                    i = static_cast<uint8_t>(3 - i);
+            }
+            if (anchors[1] & 2) {
+                std::swap(best[0][3], best[1][3]);
+                for (auto& i : alphaIndices)
+                    i = static_cast<uint8_t>(3 - i);
+            }
+
+            std::memset(out, 0, 16);
+            bitWriter bits = {out};
+            bits.write(1 << 5, 6);
+            bits.write(0, 2);
+            for (auto c = 0; c < 3; ++c) {
+                bits.write(best[0][c] >> 1, 7);
+                bits.write(best[1][c] >> 1, 7);
+            }
+            bits.write(best[0][3], 8);
+            bits.write(best[1][3], 8);
+            for (auto i = 0; i < 16; ++i)
+                bits.write(colorIndices[i], i == 0 ? 1 : 2);
+            for (auto i = 0; i < 16; ++i)
+                bits.write(alphaIndices[i], i == 0 ? 1 : 2);
+        }
+
+        inline float blockError(const float (*px)[4], const uint8_t *block)
+        {
+            uint8_t texels[64];
+            bc::decodeBC7(block, texels);
+
+            float total = 0.0f;
+            for (auto i = 0; i < 16; ++i) {
+                for (auto c = 0; c < 4; ++c) {
+                    auto d = px[i][c] - texels[i*4+c];
+                    total += d*d;
+                }
+            }
+            return total;
+        }
+
+        // Mode 5 is only tried when the block is not opaque, opaque blocks are never better off with 2 bit indices
+        inline void encodeBC7(const float (*px)[4], uint8_t *out)
+        {
+            encodeMode6(px, out);
+
+            auto opaque = std::all_of(px, px+16, [](const float *p) { return p[3] == 255.0f; });
+            if (opaque)
+                return;
+
+            uint8_t candidate[16];
+            encodeMode5(px, candidate);
+            if (blockError(px, candidate) < blockError(px, out))
+                std::memcpy(out, candidate, 16);
+        }
+    }
+
+    enum class blockFormat { bc1, bc3, bc7 };
+
+    inline size_t blockBytes(blockFormat format)
+    {
+        return format == blockFormat::bc1 ? 8 : 16;
+    }
+
+    // Compresses an RGBA level, partial blocks at the right and bottom edge repeat the last row and column
+    inline std::vector<uint8_t> encodeBlocks(blockFormat format, const uint8_t *rgba, uint32_t width, uint32_t height, unsigned threads)
+    {
+        auto columns = (width + 3) / 4, rows = (height + 3) / 4;
+        auto size = blockBytes(format);
+        std::vector<uint8_t> out(size_t(columns) * rows * size);
+
+        parallelFor(threads, rows, [&](size_t begin, size_t end, unsigned) {
+            float px[16][4];
+            for (auto by = begin; by < end; ++by) {
+                for (uint32_t bx = 0; bx < columns; ++bx) {
+                    for (uint32_t i = 0; i < 16; ++i) {
+                        auto x = std::min<uint32_t>(bx*4 + i%4, width-1), y = std::min<uint32_t>(static_cast<uint32_t>(by)*4 + i/4, height-1);
+                        for (auto c = 0; c < 4; ++c)
+                            px[i][c] = rgba[(size_t(y) * width + x) * 4 + c];
+                    }
+
+                    auto block = &out[(by * columns + bx) * size];
+                    if (format == blockFormat::bc1) {
+                        bcn::encodeColor(px, block);
+                    }
+                    else if (format == blockFormat::bc3) {
+                        bcn::encodeAlpha(px, block);
+                        bcn::encodeColor(px, block + 8);
+                    }
+                    else {
+                        bcn::encodeBC7(px, block);
+                    }
+                }
+            }
+        });
+        return out;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "application/mesh.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace game::converter
+{
+    /*
+     * Splits the triangles in [offset, offset+count) of the index buffer into clusters of at most maxVertices
+     * vertices and maxTriangles triangles. The triangles are taken in index order, so the clusters are ranges
+     * of the existing index buffer and the full draw does not change. Run it on a vertex cache optimized
+     * buffer, where consecutive triangles are close together, to get compact clusters.
+     */
+
+    inline std::vector<meshfile::meshlet> buildMeshlets(const uint32_t *indices, size_t offset, size_t count,
+        const meshfile::vertexData *vertices, size_t vertexCount, uint32_t submesh, size_t maxVertices = 64, size_t maxTriangles = 124)
+    {
+        std::vector<meshfile::meshlet> out;
+        std::vector<uint32_t> stamp(vertexCount, 0), used;
+        uint32_t current = 1;
+
+        auto finish = [&](size_t begin, size_t end) {
+            meshfile::meshlet m = {};
+            m.indexOffset = begin;
+            m.indexCount = static_cast<uint32_t>(end - begin);
+            m.submesh = submesh;
+
+            // Bounding sphere around the center of the box
+            auto lo = vertices[used[0]].position, hi = lo;
+            for (auto v : used) {
+                lo = glm::min(lo, vertices[v].position);
+                hi = glm::max(hi, vertices[v].position);
+            }
+            m.center = (lo + hi) * 0.5f;
+            for (auto v : used)
+                m.radius = std::max(m.radius, glm::distance(m.center, vertices[v].position));
+
+            // Normal cone: the average normal and the largest deviation from it
+            glm::vec3 axis(0.0f);
+            std::vector<glm::vec3> normals;
+            for (auto t = begin; t < end; t += 3) {
+                auto a = vertices[indices[t]].position, b = vertices[indices[t+1]].position, c = vertices[indices[t+2]].position;
+                auto n = glm::cross(b - a, c - a);
+                auto length = glm::length(n);
+                if (length > 0.0f) {
+                    normals.push_back(n / length);
+                    axis += normals.back();
+                }
+            }
+
+            m.coneCutoff = 1.0f;
+            auto length = glm::length(axis);
+            if (length > 0.0f) {
+                m.coneAxis = axis / length;
+                auto minDot = 1.0f;
+                for (const auto& n : normals)
+                    minDot = std::min(minDot, glm::dot(n, m.coneAxis));
+                if (minDot > 0.0f)
+                    m.coneCutoff = std::sqrt(1.0f - minDot*minDot);
+            }
+
+            out.push_back(m);
+            used.clear();
+            ++current;
+        };
+
+        auto begin = offset, end = offset + count - count%3;
+        for (auto t = begin; t < end; t += 3) {
+            size_t fresh = 0;
+            for (auto k = 0; k < 3; ++k)
+                fresh += stamp[indices[t+k]] != current && std::find(indices+t, indices+t+k, indices[t+k]) == indices+t+k;
+
+            if (used.size() + fresh > maxVertices || (t - begin)/3 + 1 > maxTriangles) {
+                finish(begin, t);
+                begin = t;
+            }
+
+            for (auto k = 0; k < 3; ++k) {
+                if (stamp[indices[t+k]] != current) {
+                    stamp[indices[t+k]] = current;
+                    used.push_back(indices[t+k]);
+                }
+            }
+        }
+        if (begin != end)
+            finish(begin, end);
+
+        return out;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace game::converter
+{
+    /*
+     * Mip chain generation for textures. Colors are converted to linear light and premultiplied by alpha before
+     * filtering, otherwise every level gets darker and transparent texels bleed into their neighbours. Each level
+     * is resampled from the previous one with a separable Lanczos 3 filter that wraps around the edges, because
+     * the textures are sampled with GL_REPEAT.
+     */
+
+    struct image
+    {
+        uint32_t width = 0, height = 0;
+
+        // Linear premultiplied RGBA
+        std::vector<float> pixels;
+    };
+
+    inline float srgbToLinear(float c)
+    {
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    inline float linearToSrgb(float c)
+    {
+        return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    }
+
+    inline image toImage(const uint8_t *rgba, uint32_t width, uint32_t height, bool srgb)
+    {
+        float table[256];
+        for (auto i = 0; i < 256; ++i)
+            table[i] = srgb ? srgbToLinear(i / 255.0f) : i / 255.0f;
+
+        image out;
+        out.width = width;
+        out.height = height;
+        out.pixels.resize(size_t(width) * height * 4);
+        for (size_t i = 0; i < size_t(width) * height; ++i) {
+            auto alpha = rgba[i*4+3] / 255.0f;
+            for (auto c = 0; c < 3; ++c)
+                out.pixels[i*4+c] = table[rgba[i*4+c]] * alpha;
+            out.pixels[i*4+3] = alpha;
+        }
+        return out;
+    }
+
+    inline std::vector<uint8_t> toBytes(const image& in, bool srgb)
+    {
+        auto quantize = [](float v) {
+            return static_cast<uint8_t>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+        };
+
+        std::vector<uint8_t> out(in.pixels.size());
+        for (size_t i = 0; i < in.pixels.size(); i += 4) {
+            auto alpha = std::clamp(in.pixels[i+3], 0.0f, 1.0f);
+            for (auto c = 0; c < 3; ++c) {
+                auto v = alpha > 0.0f ? std::max(in.pixels[i+c], 0.0f) / alpha : 0.0f;
+                out[i+c] = quantize(srgb ? linearToSrgb(std::min(v, 1.0f)) : v);
+            }
+            out[i+3] = quantize(alpha);
+        }
+        return out;
+    }
+
+    namespace mips
+    {
+        // Taps of one output texel, the source texels start at first and wrap around
+        struct taps
+        {
+            int first;
+
+            std::vector<float> weights;
+        };
+
+        inline float lanczos(float x)
+        {
+            constexpr float pi = 3.14159265358979f;
+            x = std::abs(x);
+            if (x < 1e-6f)
+                return 1.0f;
+            if (x >= 3.0f)
+                return 0.0f;
+            return 3.0f * std::sin(pi * x) * std::sin(pi * x / 3.0f) / (pi * pi * x * x);
+        }
+
+        inline std::vector<taps> makeTaps(uint32_t from, uint32_t to)
+        {
+            std::vector<taps> out(to);
+            auto scale = static_cast<float>(from) / to;
+            auto radius = 3.0f * std::max(scale, 1.0f);
+            for (uint32_t x = 0; x < to; ++x) {
+                auto center = (x + 0.5f) * scale;
+                auto first = static_cast<int>(std::floor(center - radius));
+                auto last = static_cast<int>(std::ceil(center + radius));
+
+                auto& t = out[x];
+                t.first = first;
+                float sum = 0.0f;
+                for (auto i = first; i <= last; ++i) {
+                    t.weights.push_back(lanczos((i + 0.5f - center) / std::max(scale, 1.0f)));
+                    sum += t.weights.back();
+                }
+                for (auto& w : t.weights)
+                    w /= sum;
+            }
+            return out;
+        }
+
+        inline uint32_t wrap(int i, uint32_t size)
+        {
+            auto m = i % static_cast<int>(size);
+            return static_cast<uint32_t>(m < 0 ? m + static_cast<int>(size) : m);
+        }
+    }
+
+    // Resamples to the given size, the rows and then the columns are split over the threads
+    inline image resize(const image& src, uint32_t width, uint32_t height, unsigned threads)
+    {
+        auto horizontal = mips::makeTaps(src.width, width), vertical = mips::makeTaps(src.height, height);
+
+        image rows;
+        rows.width = width;
+        rows.height = src.height;
+        rows.pixels.assign(size_t(width) * src.height * 4, 0.0f);
+        parallelFor(threads, src.height, [&](size_t begin, size_t end, unsigned) {
+            for (auto y = begin; y < end; ++y) {
+                auto in = &src.pixels[y * src.width * 4];
+                auto out = &rows.pixels[y * width * 4];
+                for (uint32_t x = 0; x < width; ++x) {
+                    const auto& t = horizontal[x];
+                    for (size_t k = 0; k < t.weights.size(); ++k) {
+                        auto s = in + mips::wrap(t.first + static_cast<int>(k), src.width) * 4;
+                        for (auto c = 0; c < 4; ++c)
+                            out[x*4+c] += s[c] * t.weights[k];
+                    }
+                }
+            }
+        });
+
+        image out;
+        out.width = width;
+        out.height = height;
+        out.pixels.assign(size_t(width) * height * 4, 0.0f);
+        parallelFor(threads, height, [&](size_t begin, size_t end, unsigned) {
+            for (auto y = begin; y < end; ++y) {
+                const auto& t = vertical[y];
+                auto dst = &out.pixels[y * width * 4];
+                for (size_t k = 0; k < t.weights.size(); ++k) {
+                    auto s = &rows.pixels[mips::wrap(t.first + static_cast<int>(k), src.height) * width * 4];
+                    for (size_t i = 0; i < size_t(width) * 4; ++i)
+                        dst[i] += s[i] * t.weights[k];
+                }
+            }
+        });
+        return out;
+    }
+
+    // All levels down to 1x1, starting with the image itself. Sizes are halved and rounded down like in OpenGL
+    inline std::vector<image> buildMips(image base, unsigned threads)
+    {
+        std::vector<image> out;
+        out.push_back(std::move(base));
+        while (out.back().width > 1 || out.back().height > 1) {
+            const auto& last = out.back();
+            out.push_back(resize(last, std::max(1u, last.width / 2), std::max(1u, last.height / 2), threads));
+        }
+        return out;
+    }
+}
\ No newline at end of file
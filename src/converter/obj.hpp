@@ -0,0 +1,483 @@
+#pragma once
+
+#include "application/mesh.hpp"
+#include "parallel.hpp"
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace game::converter
+{
+    // Zero based attribute indices of a single triangle corner, -1 when the attribute is absent
+    struct objIndex
+    {
+        int32_t v, vt, vn;
+    };
+
+    struct objMesh
+    {
+        meshfile::vertexData vertex(const objIndex& c) const
+        {
+            meshfile::vertexData out;
+            out.position = positions[c.v];
+            out.texcoord = c.vt >= 0 ? glm::vec2(texcoords[c.vt].x, 1.0f - texcoords[c.vt].y) : glm::vec2(0.0f, 0.0f);
+            out.normal = c.vn >= 0 ? normals[c.vn] : glm::vec3(0.0f, 0.0f, 0.0f);
+            return out;
+        }
+
+        std::vector<glm::vec3> positions;
+
+        std::vector<glm::vec2> texcoords;
+
+        std::vector<glm::vec3> normals;
+
+        std::vector<objIndex> corners;      // Three corners per triangle, polygons are fan triangulated
+
+        std::vector<std::string> libraries; // mtllib files, relative to the obj file
+
+        // Corners from firstCorner up to the next group use material, an index into materials
+        struct group
+        {
+            size_t firstCorner;
+
+            uint32_t material;
+        };
+
+        std::vector<group> groups;          // Empty when the file has no usemtl statements
+
+        std::vector<meshfile::material> materials;
+    };
+
+    namespace obj
+    {
+        // Index as written in the file: absolute (1 based) or relative to the attributes parsed so far in the chunk
+        struct rawIndex
+        {
+            int32_t value[3];
+
+            uint8_t relative;
+        };
+
+        // Start of an o, g or usemtl block in a chunk, the material is only known for usemtl
+        struct group
+        {
+            size_t corner;
+
+            std::string material;
+
+            bool usemtl;
+        };
+
+        struct chunk
+        {
+            std::vector<glm::vec3> positions;
+
+            std::vector<glm::vec2> texcoords;
+
+            std::vector<glm::vec3> normals;
+
+            std::vector<rawIndex> corners;
+
+            std::vector<group> groups;
+
+            std::vector<std::string> libraries;
+        };
+
+        inline bool isBlank(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        inline const char * skipBlank(const char *p, const char *end)
+        {
+            while (p < end && isBlank(*p))
+                ++p;
+            return p;
+        }
+
+        inline const char * parseFloat(const char *p, const char *end, float& out)
+        {
+            p = skipBlank(p, end);
+            if (p < end && *p == '+')
+                ++p;
+            auto res = std::from_chars(p, end, out);
+            if (res.ec != std::errc())
+                out = 0.0f;
+            return res.ptr;
+        }
+
+        // The rest of the line without the surrounding blanks
+        inline std::string parseName(const char *p, const char *end)
+        {
+            p = skipBlank(p, end);
+            while (end > p && isBlank(end[-1]))
+                --end;
+            return std::string(p, end);
+        }
+
+        inline bool isKeyword(const char *p, const char *end, std::string_view keyword)
+        {
+            auto length = keyword.size();
+            return static_cast<size_t>(end - p) > length && std::string_view(p, length) == keyword && isBlank(p[length]);
+        }
+
+        inline const char * parseInt(const char *p, const char *end, int32_t& out)
+        {
+            auto res = std::from_chars(p, end, out);
+            if (res.ec != std::errc())
+                out = 0;
+            return res.ptr;
+        }
+
+        // Parses a single line (without the newline) into the chunk
+        inline void parseLine(const char *p, const char *end, chunk& c, std::vector<rawIndex>& polygon)
+        {
+            p = skipBlank(p, end);
+            if (end - p < 2)
+                return;
+
+            if (p[0] == 'v' && isBlank(p[1])) {
+                glm::vec3 v;
+                p = parseFloat(p+2, end, v.x);
+                p = parseFloat(p, end, v.y);
+                parseFloat(p, end, v.z);
+                c.positions.push_back(v);
+            }
+            else if (p[0] == 'v' && p[1] == 't') {
+                glm::vec2 v;
+                p = parseFloat(p+2, end, v.x);
+                parseFloat(p, end, v.y);
+                c.texcoords.push_back(v);
+            }
+            else if (p[0] == 'v' && p[1] == 'n') {
+                glm::vec3 v;
+                p = parseFloat(p+2, end, v.x);
+                p = parseFloat(p, end, v.y);
+                parseFloat(p, end, v.z);
+                c.normals.push_back(v);
+            }
+            else if (isKeyword(p, end, "usemtl")) {
+                c.groups.push_back({c.corners.size(), parseName(p+6, end), true});
+            }
+            else if ((p[0] == 'o' || p[0] == 'g') && isBlank(p[1])) {
+                c.groups.push_back({c.corners.size(), std::string(), false});
+            }
+            else if (isKeyword(p, end, "mtllib")) {
+                c.libraries.push_back(parseName(p+6, end));
+            }
+            else if (p[0] == 'f' && isBlank(p[1])) {
+                const int32_t counts[3] = {
+                    static_cast<int32_t>(c.positions.size()),
+                    static_cast<int32_t>(c.texcoords.size()),
+                    static_cast<int32_t>(c.normals.size())
+                };
+
+                polygon.clear();
+                p = skipBlank(p+1, end);
+                while (p < end) {
+                    rawIndex index = {{0, 0, 0}, 0};
+
+                    // v, v/vt, v//vn or v/vt/vn
+                    for (auto i = 0; i < 3; ++i) {
+                        if (i > 0) {
+                            if (p == end || *p != '/')
+                                break;
+                            ++p;
+                        }
+                        p = parseInt(p, end, index.value[i]);
+                        if (index.value[i] < 0) {
+                            index.value[i] += counts[i];
+                            index.relative |= 1 << i;
+                        }
+                    }
+
+                    polygon.push_back(index);
+                    while (p < end && !isBlank(*p))
+                        ++p;
+                    p = skipBlank(p, end);
+                }
+
+                for (size_t i = 2; i < polygon.size(); ++i) {
+                    c.corners.push_back(polygon[0]);
+                    c.corners.push_back(polygon[i-1]);
+                    c.corners.push_back(polygon[i]);
+                }
+            }
+        }
+
+        inline void parseChunk(const char *p, const char *end, chunk& c)
+        {
+            std::vector<rawIndex> polygon;
+            while (p < end) {
+                auto eol = p;
+                while (eol < end && *eol != '\n')
+                    ++eol;
+                parseLine(p, eol, c, polygon);
+                p = eol + 1;
+            }
+        }
+
+        inline void copyName(char (&out)[64], const std::string& name)
+        {
+            std::memset(out, 0, sizeof(out));
+            std::memcpy(out, name.data(), std::min(name.size(), sizeof(out) - 1));
+        }
+
+        // Parses the newmtl blocks of a mtl file, only the attributes the renderer knows about are kept
+        inline std::vector<meshfile::material> parseMtl(std::string_view text)
+        {
+            std::vector<meshfile::material> out;
+            size_t p = 0;
+            while (p < text.size()) {
+                auto eol = std::min(text.find('\n', p), text.size());
+                auto line = skipBlank(text.data()+p, text.data()+eol), end = text.data()+eol;
+                p = eol + 1;
+
+                if (isKeyword(line, end, "newmtl")) {
+                    meshfile::material m = {};
+                    copyName(m.name, parseName(line+6, end));
+                    m.diffuse[0] = m.diffuse[1] = m.diffuse[2] = 1.0f;
+                    m.specular[0] = m.specular[1] = m.specular[2] = 1.0f;
+                    m.shininess = 32.0f;
+                    out.push_back(m);
+                }
+                else if (out.empty()) {
+                    continue;
+                }
+                else if (isKeyword(line, end, "Kd")) {
+                    auto q = line+2;
+                    for (auto i = 0; i < 3; ++i)
+                        q = parseFloat(q, end, out.back().diffuse[i]);
+                }
+                else if (isKeyword(line, end, "Ks")) {
+                    auto q = line+2;
+                    for (auto i = 0; i < 3; ++i)
+                        q = parseFloat(q, end, out.back().specular[i]);
+                }
+                else if (isKeyword(line, end, "Ns")) {
+                    parseFloat(line+2, end, out.back().shininess);
+                }
+                else if (isKeyword(line, end, "map_Kd")) {
+                    copyName(out.back().diffuseMap, parseName(line+6, end));
+                }
+                else if (isKeyword(line, end, "map_Ks")) {
+                    copyName(out.back().specularMap, parseName(line+6, end));
+                }
+            }
+            return out;
+        }
+
+        // Start of the first line at or after offset
+        inline size_t lineStart(std::string_view text, size_t offset)
+        {
+            if (offset == 0 || offset >= text.size())
+                return std::min(offset, text.size());
+            auto eol = text.find('\n', offset-1);
+            return eol == std::string_view::npos ? text.size() : eol+1;
+        }
+    }
+
+    /*
+     * Parses the obj text on multiple threads: every thread handles a range of whole lines, after which the
+     * attribute arrays are concatenated and the chunk relative face indices are resolved against them.
+     */
+
+    inline objMesh parseObj(std::string_view text, unsigned threads)
+    {
+        std::vector<obj::chunk> chunks(std::max(1u, threads));
+        parallelFor(static_cast<unsigned>(chunks.size()), chunks.size(), [&](size_t first, size_t last, unsigned) {
+            for (auto i = first; i < last; ++i) {
+                auto begin = obj::lineStart(text, text.size()*i/chunks.size());
+                auto end = obj::lineStart(text, text.size()*(i+1)/chunks.size());
+                obj::parseChunk(text.data()+begin, text.data()+end, chunks[i]);
+            }
+        });
+
+        // Offsets of every chunk into the merged arrays
+        struct offsets
+        {
+            size_t attrib[3];
+
+            size_t corners;
+        };
+        std::vector<offsets> base(chunks.size()+1, {{0, 0, 0}, 0});
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            base[i+1].attrib[0] = base[i].attrib[0] + chunks[i].positions.size();
+            base[i+1].attrib[1] = base[i].attrib[1] + chunks[i].texcoords.size();
+            base[i+1].attrib[2] = base[i].attrib[2] + chunks[i].normals.size();
+            base[i+1].corners = base[i].corners + chunks[i].corners.size();
+        }
+
+        const auto& total = base.back();
+        objMesh out;
+        out.positions.resize(total.attrib[0]);
+        out.texcoords.resize(total.attrib[1]);
+        out.normals.resize(total.attrib[2]);
+        out.corners.resize(total.corners);
+
+        parallelFor(static_cast<unsigned>(chunks.size()), chunks.size(), [&](size_t first, size_t last, unsigned) {
+            for (auto i = first; i < last; ++i) {
+                auto& c = chunks[i];
+                std::copy(c.positions.begin(), c.positions.end(), out.positions.begin()+base[i].attrib[0]);
+                std::copy(c.texcoords.begin(), c.texcoords.end(), out.texcoords.begin()+base[i].attrib[1]);
+                std::copy(c.normals.begin(), c.normals.end(), out.normals.begin()+base[i].attrib[2]);
+
+                auto dst = out.corners.begin() + base[i].corners;
+                for (const auto& raw : c.corners) {
+                    int32_t resolved[3];
+                    for (auto a = 0; a < 3; ++a) {
+                        if (raw.relative & (1 << a))
+                            resolved[a] = static_cast<int32_t>(base[i].attrib[a]) + raw.value[a];
+                        else
+                            resolved[a] = raw.value[a] - 1;
+
+                        if (resolved[a] >= static_cast<int32_t>(total.attrib[a]) || (resolved[a] < 0 && (a == 0 || raw.value[a] != 0)))
+                            throw std::runtime_error("face index out of range");
+                    }
+                    *dst++ = {resolved[0], resolved[1], resolved[2]};
+                }
+
+                auto groups = std::move(c.groups);
+                auto libraries = std::move(c.libraries);
+                c = obj::chunk();
+                c.groups = std::move(groups);
+                c.libraries = std::move(libraries);
+            }
+        });
+
+        // The current material carries over o and g statements and chunk borders, so the groups are resolved in order
+        std::map<std::string, uint32_t> ids;
+        std::vector<std::string> names;
+        std::string current;
+        auto used = false;
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            for (const auto& g : chunks[i].groups) {
+                if (g.usemtl) {
+                    current = g.material;
+                    used = true;
+                }
+                if (!used)
+                    continue;
+
+                auto it = ids.emplace(current, static_cast<uint32_t>(names.size())).first;
+                if (it->second == names.size())
+                    names.push_back(current);
+
+                objMesh::group next = {base[i].corners + g.corner, it->second};
+                if (!out.groups.empty() && out.groups.back().firstCorner == next.firstCorner)
+                    out.groups.back() = next;
+                else if (out.groups.empty() || out.groups.back().material != next.material)
+                    out.groups.push_back(next);
+            }
+        }
+
+        // Faces before the first usemtl use the first material
+        if (!out.groups.empty())
+            out.groups.front().firstCorner = 0;
+
+        for (const auto& name : names) {
+            meshfile::material m = {};
+            obj::copyName(m.name, name);
+            m.diffuse[0] = m.diffuse[1] = m.diffuse[2] = 1.0f;
+            m.specular[0] = m.specular[1] = m.specular[2] = 1.0f;
+            m.shininess = 32.0f;
+            out.materials.push_back(m);
+        }
+        for (const auto& c : chunks) {
+            for (const auto& l : c.libraries)
+                out.libraries.push_back(l);
+        }
+
+        return out;
+    }
+
+    /*
+     * Replaces the placeholder materials of the mesh with the ones of the same name in the mtl text, materials the
+     * text does not define keep their defaults.
+     */
+
+    inline void applyMtl(objMesh& mesh, std::string_view text)
+    {
+        for (const auto& m : obj::parseMtl(text)) {
+            for (auto& target : mesh.materials) {
+                if (std::strncmp(target.name, m.name, sizeof(m.name)) == 0)
+                    target = m;
+            }
+        }
+    }
+
+    /*
+     * Reorders the triangles so every material is a single range, in the order the materials are first used, and
+     * returns these ranges as submeshes of the corner array. Returns nothing when the file has no materials.
+     */
+
+    inline std::vector<meshfile::submesh> sortByMaterial(objMesh& mesh)
+    {
+        std::vector<meshfile::submesh> out;
+        if (mesh.groups.empty())
+            return out;
+
+        auto end = [&mesh](size_t g) {
+            return g+1 < mesh.groups.size() ? mesh.groups[g+1].firstCorner : mesh.corners.size();
+        };
+
+        std::vector<uint64_t> offsets(mesh.materials.size()+1, 0);
+        for (size_t g = 0; g < mesh.groups.size(); ++g)
+            offsets[mesh.groups[g].material+1] += end(g) - mesh.groups[g].firstCorner;
+        for (size_t m = 0; m < mesh.materials.size(); ++m) {
+            if (offsets[m+1])
+                out.push_back({offsets[m], offsets[m+1], 0, 0, static_cast<uint32_t>(m), 0});
+            offsets[m+1] += offsets[m];
+        }
+
+        std::vector<objIndex> sorted(mesh.corners.size());
+        for (size_t g = 0; g < mesh.groups.size(); ++g) {
+            auto first = mesh.corners.begin() + mesh.groups[g].firstCorner, last = mesh.corners.begin() + end(g);
+            std::copy(first, last, sorted.begin() + offsets[mesh.groups[g].material]);
+            offsets[mesh.groups[g].material] += last - first;
+        }
+
+        mesh.corners = std::move(sorted);
+        mesh.groups.clear();
+        return out;
+    }
+
+    namespace obj
+    {
+        inline bool readText(const std::string& path, std::string& text)
+        {
+            std::ifstream in(path, std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+            if (!in.is_open())
+                return false;
+
+            text.resize(in.tellg());
+            in.seekg(0, std::ifstream::beg);
+            in.read(text.data(), text.size());
+            return true;
+        }
+    }
+
+    // Loads the obj file and the materials of its mtl libraries, libraries that cannot be opened are skipped
+    inline objMesh loadObj(std::string_view path, unsigned threads)
+    {
+        std::string text;
+        if (!obj::readText(std::string(path), text))
+            throw std::runtime_error("unable to open obj file");
+
+        auto out = parseObj(text, threads);
+
+        auto slash = path.find_last_of("/\\");
+        auto dir = slash == std::string_view::npos ? std::string() : std::string(path.substr(0, slash+1));
+        for (const auto& l : out.libraries) {
+            if (obj::readText(dir + l, text))
+                applyMtl(out, text);
+        }
+        return out;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,218 @@
+#pragma once
+
+#include "application/mesh.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace game::converter
+{
+    struct overdrawStats
+    {
+        size_t covered;     // Pixels covered by at least one front facing triangle
+
+        size_t shaded;      // Fragments that passed the depth test
+
+        double overdraw;    // shaded / covered
+    };
+
+    namespace overdraw
+    {
+        constexpr int resolution = 256;
+
+        // Orthographic view along one of the six axis directions: screen = (p.right, p.up), depth = p.forward
+        struct view
+        {
+            glm::vec3 right, up, forward;
+        };
+
+        constexpr unsigned cacheSize = 16;
+    }
+
+    /*
+     * Estimates overdraw by rasterizing the mesh in index order from the six axis directions with back face
+     * culling and a depth test, the same way the pipelines draw it (counter clockwise front faces).
+     */
+
+    inline overdrawStats analyzeOverdraw(const uint32_t *indices, size_t count, const meshfile::vertexData *vertices, size_t vertexCount)
+    {
+        static const overdraw::view views[6] = {
+            {{ 1, 0, 0}, {0, 1, 0}, { 0, 0,-1}}, {{-1, 0, 0}, {0, 1, 0}, { 0, 0, 1}},
+            {{ 0, 1, 0}, {0, 0, 1}, {-1, 0, 0}}, {{ 0,-1, 0}, {0, 0, 1}, { 1, 0, 0}},
+            {{ 0, 0, 1}, {1, 0, 0}, { 0,-1, 0}}, {{ 0, 0,-1}, {1, 0, 0}, { 0, 1, 0}}
+        };
+        constexpr int res = overdraw::resolution;
+
+        overdrawStats out = {0, 0, 0.0};
+        if (vertexCount == 0 || count < 3)
+            return out;
+
+        glm::vec3 minimum = vertices[0].position, maximum = vertices[0].position;
+        for (size_t i = 1; i < vertexCount; ++i) {
+            minimum = glm::min(minimum, vertices[i].position);
+            maximum = glm::max(maximum, vertices[i].position);
+        }
+        auto extent = std::max({maximum.x - minimum.x, maximum.y - minimum.y, maximum.z - minimum.z});
+        auto scale = extent > 0.0f ? (res - 1) / extent : 0.0f;
+        auto center = (minimum + maximum) * 0.5f;
+
+        std::vector<float> depth(res*res);
+        for (const auto& v : views) {
+            std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::infinity());
+
+            auto project = [&](uint32_t index) {
+                auto p = vertices[index].position - center;
+                return glm::vec3(glm::dot(p, v.right)*scale + res/2, glm::dot(p, v.up)*scale + res/2, glm::dot(p, v.forward));
+            };
+
+            for (size_t t = 0; t+2 < count; t += 3) {
+                auto a = project(indices[t]), b = project(indices[t+1]), c = project(indices[t+2]);
+
+                auto area = (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x);
+                if (area <= 0.0f)
+                    continue;
+
+                auto x0 = std::max(0, static_cast<int>(std::floor(std::min({a.x, b.x, c.x}))));
+                auto x1 = std::min(res-1, static_cast<int>(std::ceil(std::max({a.x, b.x, c.x}))));
+                auto y0 = std::max(0, static_cast<int>(std::floor(std::min({a.y, b.y, c.y}))));
+                auto y1 = std::min(res-1, static_cast<int>(std::ceil(std::max({a.y, b.y, c.y}))));
+
+                for (auto y = y0; y <= y1; ++y) {
+                    for (auto x = x0; x <= x1; ++x) {
+                        auto px = x + 0.5f, py = y + 0.5f;
+                        auto w0 = (c.x - b.x)*(py - b.y) - (c.y - b.y)*(px - b.x);
+                        auto w1 = (a.x - c.x)*(py - c.y) - (a.y - c.y)*(px - c.x);
+                        auto w2 = (b.x - a.x)*(py - a.y) - (b.y - a.y)*(px - a.x);
+                        if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                            continue;
+
+                        auto z = (w0*a.z + w1*b.z + w2*c.z) / area;
+                        auto& d = depth[y*res + x];
+                        if (z < d) {
+                            out.covered += std::isinf(d);
+                            out.shaded += 1;
+                            d = z;
+                        }
+                    }
+                }
+            }
+        }
+
+        out.overdraw = out.covered ? static_cast<double>(out.shaded) / out.covered : 0.0;
+        return out;
+    }
+
+    /*
+     * Reorders a vertex cache optimized index buffer to reduce overdraw (Sander et al., "Fast Triangle
+     * Reordering for Vertex Locality and Reduced Overdraw"). The triangles are split into clusters wherever
+     * the cache would not suffer much from the split, then the clusters are sorted so that the ones facing
+     * away from the mesh center are drawn first, which works from every view direction.
+     */
+
+    inline void optimizeOverdraw(uint32_t *indices, size_t count, const meshfile::vertexData *vertices, size_t vertexCount,
+        float threshold = 1.05f)
+    {
+        auto triangles = count / 3;
+        if (triangles < 2)
+            return;
+
+        std::vector<uint64_t> stamps(vertexCount, 0);
+        uint64_t time = overdraw::cacheSize + 1;
+        auto misses = [&](size_t t) {
+            unsigned m = 0;
+            for (auto k = 0; k < 3; ++k) {
+                auto& stamp = stamps[indices[t*3+k]];
+                if (time - stamp > overdraw::cacheSize) {
+                    stamp = time++;
+                    ++m;
+                }
+            }
+            return m;
+        };
+        auto flush = [&]() {
+            time += overdraw::cacheSize + 1;
+        };
+
+        // Hard boundaries: triangles where the cache missed on every vertex
+        std::vector<size_t> hard = {0};
+        for (size_t t = 0; t < triangles; ++t) {
+            auto m = misses(t);
+            if (t > 0 && m == 3)
+                hard.push_back(t);
+        }
+        hard.push_back(triangles);
+
+        // Soft boundaries: split a hard cluster wherever the miss ratio since the last split is close to that of the cluster
+        std::vector<size_t> clusters;
+        for (size_t h = 0; h+1 < hard.size(); ++h) {
+            auto start = hard[h], end = hard[h+1];
+
+            flush();
+            size_t total = 0;
+            for (auto t = start; t < end; ++t)
+                total += misses(t);
+            auto limit = threshold * static_cast<float>(total) / (end - start);
+
+            flush();
+            size_t current = 0, clusterStart = start;
+            clusters.push_back(start);
+            for (auto t = start; t < end; ++t) {
+                current += misses(t);
+                if (t+1 < end && static_cast<float>(current) / (t - clusterStart + 1) <= limit) {
+                    clusters.push_back(t+1);
+                    clusterStart = t+1;
+                    current = 0;
+                    flush();
+                }
+            }
+        }
+        clusters.push_back(triangles);
+
+        // Area weighted centroid of the whole mesh and of every cluster, plus the cluster normals
+        auto position = [&](size_t t, int k) {
+            return vertices[indices[t*3+k]].position;
+        };
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+        std::vector<glm::vec3> centroids(clusters.size()-1, glm::vec3(0.0f)), normals(clusters.size()-1, glm::vec3(0.0f));
+        std::vector<float> areas(clusters.size()-1, 0.0f);
+
+        for (size_t c = 0; c+1 < clusters.size(); ++c) {
+            for (auto t = clusters[c]; t < clusters[c+1]; ++t) {
+                auto a = position(t, 0), b = position(t, 1), d = position(t, 2);
+                auto n = glm::cross(b - a, d - a);
+                auto area = glm::length(n);
+
+                centroids[c] += (a + b + d) * (area / 3.0f);
+                normals[c] += n;
+                areas[c] += area;
+            }
+            meshCentroid += centroids[c];
+            meshArea += areas[c];
+        }
+        if (meshArea > 0.0f)
+            meshCentroid /= meshArea;
+
+        std::vector<float> keys(clusters.size()-1);
+        for (size_t c = 0; c < keys.size(); ++c) {
+            auto centroid = areas[c] > 0.0f ? centroids[c] / areas[c] : position(clusters[c], 0);
+            auto length = glm::length(normals[c]);
+            keys[c] = length > 0.0f ? glm::dot(centroid - meshCentroid, normals[c] / length) : 0.0f;
+        }
+
+        std::vector<size_t> order(keys.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&keys](size_t lhs, size_t rhs) {
+            return keys[lhs] > keys[rhs];
+        });
+
+        std::vector<uint32_t> output;
+        output.reserve(triangles*3);
+        for (auto c : order)
+            output.insert(output.end(), indices + clusters[c]*3, indices + clusters[c+1]*3);
+        std::copy(output.begin(), output.end(), indices);
+    }
+}
\ No newline at end of file
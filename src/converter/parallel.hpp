@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace game::converter
+{
+    inline unsigned defaultThreads()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    /*
+     * Splits [0, count) into one contiguous range per thread and calls f(begin, end, thread) for each of them,
+     * the calling thread handles the first range. Exceptions thrown by any range are rethrown after all joined.
+     */
+
+    template<class F>
+    void parallelFor(unsigned threads, size_t count, F&& f)
+    {
+        threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, count)));
+
+        std::vector<std::exception_ptr> errors(threads);
+        auto run = [&](unsigned t) {
+            try {
+                f(count*t/threads, count*(t+1)/threads, t);
+            }
+            catch (...) {
+                errors[t] = std::current_exception();
+            }
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(threads-1);
+        for (unsigned t = 1; t < threads; ++t)
+            pool.emplace_back(run, t);
+
+        run(0);
+        for (auto& thread : pool)
+            thread.join();
+
+        for (auto& error : errors) {
+            if (error)
+                std::rethrow_exception(error);
+        }
+    }
+
+    /*
+     * Calls f(i, thread) for every i in [0, count), the threads take the next item whenever they finish one so
+     * items of very different cost still keep all of them busy. Exceptions are rethrown like in parallelFor.
+     */
+
+    template<class F>
+    void parallelEach(unsigned threads, size_t count, F&& f)
+    {
+        std::atomic<size_t> next(0);
+        parallelFor(threads, count, [&](size_t, size_t, unsigned t) {
+            for (auto i = next++; i < count; i = next++)
+                f(i, t);
+        });
+    }
+}
\ No newline at end of file
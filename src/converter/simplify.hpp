@@ -0,0 +1,258 @@
+#pragma once
+
+#include "application/mesh.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+namespace game::converter
+{
+    namespace simplify
+    {
+        // Symmetric 4x4 error quadric of a set of planes, weighted by triangle area
+        struct quadric
+        {
+            void addPlane(const glm::dvec3& n, double d, double w)
+            {
+                double p[4] = {n.x, n.y, n.z, d};
+                auto k = 0;
+                for (auto i = 0; i < 4; ++i) {
+                    for (auto j = i; j < 4; ++j)
+                        a[k++] += w * p[i] * p[j];
+                }
+                weight += w;
+            }
+
+            // Mean squared distance of p to the planes
+            double error(const glm::vec3& p) const
+            {
+                if (weight <= 0.0)
+                    return 0.0;
+
+                double v[4] = {p.x, p.y, p.z, 1.0};
+                double sum = 0.0;
+                auto k = 0;
+                for (auto i = 0; i < 4; ++i) {
+                    for (auto j = i; j < 4; ++j)
+                        sum += (i == j ? 1.0 : 2.0) * a[k++] * v[i] * v[j];
+                }
+                return std::max(sum, 0.0) / weight;
+            }
+
+            quadric& operator+=(const quadric& rhs)
+            {
+                for (auto i = 0; i < 10; ++i)
+                    a[i] += rhs.a[i];
+                weight += rhs.weight;
+                return *this;
+            }
+
+            double a[10] = {};
+
+            double weight = 0.0;
+        };
+
+        struct collapse
+        {
+            uint32_t from, to;      // Position ids
+
+            uint32_t vertex;        // Vertex that replaces from, taken from the triangle of the edge
+
+            double cost;
+        };
+
+        constexpr auto none = ~uint32_t(0);
+    }
+
+    /*
+     * Simplifies the triangles of an indexed mesh to about target indices by edge collapses ordered by their
+     * quadric error (Garland and Heckbert). A vertex is only collapsed onto one of its neighbours, so the
+     * result indexes the same vertex array. Vertices on a border or on an attribute seam (one position with
+     * several vertices) are never moved, which keeps the outline and the texture layout intact at the cost of
+     * stopping early on meshes that are mostly seams. error receives the rms quadric error, the square root of
+     * the mean quadric cost of the collapses, in object space units.
+     */
+
+    inline std::vector<uint32_t> simplifyMesh(const uint32_t *indices, size_t count, const meshfile::vertexData *vertices,
+        size_t vertexCount, size_t target, float& error)
+    {
+        std::vector<uint32_t> out(indices, indices + count - count%3);
+        error = 0.0f;
+        if (out.size() <= target)
+            return out;
+
+        // Vertices that share a position share an id, seams are positions with more than one vertex
+        std::vector<uint32_t> order(vertexCount), position(vertexCount);
+        std::iota(order.begin(), order.end(), 0);
+        auto less = [vertices](uint32_t lhs, uint32_t rhs) {
+            const auto& a = vertices[lhs].position;
+            const auto& b = vertices[rhs].position;
+            return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+        };
+        std::sort(order.begin(), order.end(), less);
+
+        std::vector<uint32_t> representative;
+        std::vector<bool> locked;
+        for (size_t i = 0; i < vertexCount; ++i) {
+            if (i == 0 || less(order[i-1], order[i])) {
+                representative.push_back(order[i]);
+                locked.push_back(false);
+            }
+            else {
+                locked.back() = true;
+            }
+            position[order[i]] = static_cast<uint32_t>(representative.size() - 1);
+        }
+        auto positions = representative.size();
+        auto point = [&](uint32_t p) {
+            return vertices[representative[p]].position;
+        };
+
+        // Border edges are used by a single triangle
+        std::vector<std::pair<uint32_t, uint32_t>> edges;
+        edges.reserve(out.size());
+        for (size_t t = 0; t < out.size(); t += 3) {
+            for (auto k = 0; k < 3; ++k) {
+                auto a = position[out[t+k]], b = position[out[t+(k+1)%3]];
+                edges.emplace_back(std::min(a, b), std::max(a, b));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size();) {
+            auto j = i;
+            while (j < edges.size() && edges[j] == edges[i])
+                ++j;
+            if (j - i == 1)
+                locked[edges[i].first] = locked[edges[i].second] = true;
+            i = j;
+        }
+
+        std::vector<simplify::quadric> quadrics(positions);
+        for (size_t t = 0; t < out.size(); t += 3) {
+            glm::dvec3 a(point(position[out[t]])), b(point(position[out[t+1]])), c(point(position[out[t+2]]));
+            auto n = glm::cross(b - a, c - a);
+            auto area = glm::length(n);
+            if (area <= 0.0)
+                continue;
+            n /= area;
+            for (auto k = 0; k < 3; ++k)
+                quadrics[position[out[t+k]]].addPlane(n, -glm::dot(n, a), area);
+        }
+
+        // Quadric cost of every applied collapse, for the rms error
+        double totalCost = 0.0;
+        size_t collapses = 0;
+        std::vector<uint32_t> offsets(positions+1), adjacency;
+        std::vector<simplify::collapse> best(positions);
+        std::vector<uint32_t> remap(vertexCount);
+        std::vector<bool> touched(positions);
+
+        while (out.size() > target) {
+            // Triangles around every position
+            std::fill(offsets.begin(), offsets.end(), 0);
+            for (auto v : out)
+                ++offsets[position[v]+1];
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+            adjacency.resize(out.size());
+            auto fill = offsets;
+            for (size_t t = 0; t < out.size(); t += 3) {
+                for (auto k = 0; k < 3; ++k)
+                    adjacency[fill[position[out[t+k]]]++] = static_cast<uint32_t>(t);
+            }
+
+            // Cheapest collapse of every movable position
+            for (auto& b : best)
+                b = {simplify::none, simplify::none, simplify::none, 0.0};
+            for (size_t t = 0; t < out.size(); t += 3) {
+                for (auto k = 0; k < 3; ++k) {
+                    auto from = position[out[t+k]];
+                    if (locked[from])
+                        continue;
+                    for (auto e = 1; e < 3; ++e) {
+                        auto vertex = out[t+(k+e)%3];
+                        auto to = position[vertex];
+                        auto cost = quadrics[from].error(point(to));
+                        if (best[from].from == simplify::none || cost < best[from].cost)
+                            best[from] = {from, to, vertex, cost};
+                    }
+                }
+            }
+
+            std::vector<simplify::collapse> candidates;
+            for (const auto& b : best) {
+                if (b.from != simplify::none)
+                    candidates.push_back(b);
+            }
+            std::sort(candidates.begin(), candidates.end(), [](const simplify::collapse& lhs, const simplify::collapse& rhs) {
+                return lhs.cost < rhs.cost;
+            });
+
+            // Apply independent collapses until the target is reached, a collapse removes about two triangles
+            std::iota(remap.begin(), remap.end(), 0);
+            std::fill(touched.begin(), touched.end(), false);
+            auto remaining = (out.size() - target) / 3;
+            size_t applied = 0;
+
+            for (const auto& c : candidates) {
+                if (applied*2 >= remaining + 1)
+                    break;
+                if (touched[c.from] || touched[c.to])
+                    continue;
+
+                // Reject collapses that flip a triangle or touch a triangle that changes in this pass
+                auto valid = true;
+                for (auto a = offsets[c.from]; a < offsets[c.from+1] && valid; ++a) {
+                    auto t = adjacency[a];
+                    uint32_t p[3] = {position[out[t]], position[out[t+1]], position[out[t+2]]};
+                    if (p[0] == c.to || p[1] == c.to || p[2] == c.to)
+                        continue;
+
+                    glm::vec3 before[3] = {point(p[0]), point(p[1]), point(p[2])}, after[3];
+                    for (auto k = 0; k < 3; ++k) {
+                        valid = valid && (p[k] == c.from || !touched[p[k]]);
+                        after[k] = p[k] == c.from ? point(c.to) : before[k];
+                    }
+                    auto n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                    auto n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                    valid = valid && glm::dot(n0, n1) > 0.0f;
+                }
+                if (!valid)
+                    continue;
+
+                for (auto a = offsets[c.from]; a < offsets[c.from+1]; ++a) {
+                    auto t = adjacency[a];
+                    for (auto k = 0; k < 3; ++k)
+                        touched[position[out[t+k]]] = true;
+                }
+                touched[c.to] = true;
+
+                remap[representative[c.from]] = c.vertex;
+                quadrics[c.to] += quadrics[c.from];
+                totalCost += c.cost;
+                ++applied;
+            }
+
+            if (applied == 0)
+                break;
+            collapses += applied;
+
+            // Move the collapsed corners and drop the triangles that became degenerate
+            size_t write = 0;
+            for (size_t t = 0; t < out.size(); t += 3) {
+                uint32_t v[3] = {remap[out[t]], remap[out[t+1]], remap[out[t+2]]};
+                if (position[v[0]] == position[v[1]] || position[v[1]] == position[v[2]] || position[v[0]] == position[v[2]])
+                    continue;
+                out[write++] = v[0];
+                out[write++] = v[1];
+                out[write++] = v[2];
+            }
+            out.resize(write);
+        }
+
+        if (collapses)
+            error = static_cast<float>(std::sqrt(totalCost / collapses));
+        return out;
+    }
+}
\ No newline at end of file
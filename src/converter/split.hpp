@@ -0,0 +1,73 @@
+#pragma once
+
+#include "application/mesh.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace game::converter
+{
+    /*
+     * Splits the mesh into submeshes of at most maxVertices vertices so every submesh can use 16 bit indices.
+     * The triangles are walked in order and a new submesh is started whenever the next triangle would not fit,
+     * or at the start of each of the given material ranges, so the triangle order of the earlier passes is kept
+     * and every submesh has a single material. Vertices shared by two submeshes are duplicated, the indices
+     * become relative to the base vertex of their submesh. Returns the material ranges when the mesh fits as is.
+     */
+
+    template<class Vertex>
+    std::vector<meshfile::submesh> splitMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+        const std::vector<meshfile::submesh>& materials, uint32_t maxVertices = 65536)
+    {
+        if (vertices.size() <= maxVertices)
+            return materials;
+
+        auto ranges = materials;
+        if (ranges.empty())
+            ranges.push_back({0, indices.size(), 0, 0, 0, 0});
+
+        constexpr auto unused = ~uint32_t(0);
+        std::vector<uint32_t> remap(vertices.size(), unused), used;
+        std::vector<Vertex> out;
+        out.reserve(vertices.size());
+
+        std::vector<meshfile::submesh> submeshes;
+        meshfile::submesh current;
+        auto close = [&](size_t end) {
+            current.indexCount = end - current.indexOffset;
+            submeshes.push_back(current);
+            for (auto v : used)
+                remap[v] = unused;
+            used.clear();
+        };
+
+        for (const auto& r : ranges) {
+            auto end = r.indexOffset + r.indexCount;
+            current = {r.indexOffset, 0, static_cast<uint32_t>(out.size()), 0, r.material, 0};
+
+            for (auto t = r.indexOffset; t+2 < end; t += 3) {
+                uint32_t fresh = 0;
+                for (auto k = 0; k < 3; ++k)
+                    fresh += remap[indices[t+k]] == unused;
+
+                if (current.vertexCount + fresh > maxVertices) {
+                    close(t);
+                    current = {t, 0, static_cast<uint32_t>(out.size()), 0, r.material, 0};
+                }
+
+                for (auto k = 0; k < 3; ++k) {
+                    auto v = indices[t+k];
+                    if (remap[v] == unused) {
+                        remap[v] = current.vertexCount++;
+                        used.push_back(v);
+                        out.push_back(vertices[v]);
+                    }
+                    indices[t+k] = remap[v];
+                }
+            }
+            close(end);
+        }
+
+        vertices = std::move(out);
+        return submeshes;
+    }
+}
\ No newline at end of file
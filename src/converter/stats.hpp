@@ -0,0 +1,157 @@
+#pragma once
+
+#include "application/mesh.hpp"
+#include "overdraw.hpp"
+#include "vcache.hpp"
+#include <iomanip>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace game::converter
+{
+    /*
+     * Figures that show how well a converted mesh suits the GPU, for obj2msh -i and mshinfo. Everything is measured
+     * on the full detail triangles of every submesh as stored in the file, the levels of detail are left out.
+     */
+
+    struct cacheStats
+    {
+        unsigned cacheSize;
+
+        vertexCacheStats stats;
+    };
+
+    struct meshStats
+    {
+        size_t vertices, indices, triangles;
+
+        size_t submeshes, levels, meshlets, materials;
+
+        size_t vertexSize, indexSize;   // Bytes per vertex and per index as stored
+
+        size_t fileSize;
+
+        double dedup;                   // Triangle corners per stored vertex
+
+        std::vector<cacheStats> caches;
+
+        overdrawStats overdraw;
+
+        meshfile::boundingVolume bounds;
+    };
+
+    namespace stats
+    {
+        // FIFO sizes of older hardware, of most current hardware and of a generous upper bound
+        constexpr unsigned cacheSizes[] = {16, 32, 64};
+
+        inline void writeString(std::ostream& out, std::string_view s)
+        {
+            out << '"';
+            for (auto c : s) {
+                if (c == '"' || c == '\\')
+                    out << '\\' << c;
+                else if (static_cast<unsigned char>(c) < 0x20)
+                    out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec << std::setfill(' ');
+                else
+                    out << c;
+            }
+            out << '"';
+        }
+
+        inline void writeVector(std::ostream& out, const glm::vec3& v)
+        {
+            out << "[" << v.x << ", " << v.y << ", " << v.z << "]";
+        }
+    }
+
+    // Unpacks quantized vertices and computes missing bounds, so the meshfile should be a copy loaded for this
+    inline meshStats analyzeMesh(meshfile& mf, size_t fileSize)
+    {
+        meshStats out = {};
+        mf.unpack();
+        if (mf.bounds.empty() && mf.head.dataCount)
+            mf.computeBounds();
+
+        // Indices relative to the whole vertex array, the submeshes each have their own base vertex
+        std::vector<uint32_t> indices;
+        auto ranges = mf.ranges();
+        for (const auto& r : ranges) {
+            for (auto i = r.indexOffset; i < r.indexOffset + r.indexCount; ++i)
+                indices.push_back(r.baseVertex + mf.index(i));
+        }
+
+        out.vertices = mf.head.dataCount;
+        out.indices = indices.size();
+        out.triangles = indices.size() / 3;
+        out.submeshes = ranges.size();
+        out.levels = mf.lodLevels();
+        out.meshlets = mf.meshlets.size();
+        out.materials = mf.materials.size();
+        out.vertexSize = mf.packed ? sizeof(meshfile::packedVertex) : sizeof(meshfile::vertexData);
+        out.indexSize = mf.shortIndices ? sizeof(unsigned short) : sizeof(unsigned int);
+        out.fileSize = fileSize;
+        out.dedup = out.vertices ? static_cast<double>(out.indices) / out.vertices : 0.0;
+
+        for (auto size : stats::cacheSizes)
+            out.caches.push_back({size, analyzeVertexCache(indices.data(), indices.size(), out.vertices, size)});
+        out.overdraw = analyzeOverdraw(indices.data(), indices.size(), mf.data, out.vertices);
+        if (!mf.bounds.empty())
+            out.bounds = mf.bounds.front();
+        return out;
+    }
+
+    inline void printStats(std::ostream& out, const meshStats& s)
+    {
+        auto flags = out.flags();
+        auto precision = out.precision();
+
+        out << "vertices: " << s.vertices << " of " << s.vertexSize << " bytes, " << s.indices << " indices of " << s.indexSize
+            << " bytes, " << s.triangles << " triangles" << std::endl;
+        out << "structure: " << s.submeshes << " submeshes, " << s.levels << " levels, " << s.meshlets << " meshlets, "
+            << s.materials << " materials, " << s.fileSize << " byte file" << std::endl;
+        out << std::fixed << std::setprecision(3) << "dedup: " << s.dedup << " corners per vertex" << std::endl;
+
+        out << "vertex cache:";
+        for (const auto& c : s.caches)
+            out << " " << c.cacheSize << " ACMR " << c.stats.acmr << " ATVR " << c.stats.atvr << (&c != &s.caches.back() ? "," : "");
+        out << std::endl;
+
+        out << "overdraw: " << s.overdraw.overdraw << std::endl;
+        out << "bounds: (" << s.bounds.min.x << ", " << s.bounds.min.y << ", " << s.bounds.min.z << ") - (" << s.bounds.max.x << ", "
+            << s.bounds.max.y << ", " << s.bounds.max.z << "), radius " << s.bounds.radius << std::endl;
+
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    // One JSON object per mesh on a single line, so asset builds can collect them with a line based tool
+    inline void writeJson(std::ostream& out, std::string_view name, const meshStats& s)
+    {
+        auto flags = out.flags();
+        auto precision = out.precision();
+        out << std::defaultfloat << std::setprecision(9);
+
+        out << "{\"file\": ";
+        stats::writeString(out, name);
+        out << ", \"vertices\": " << s.vertices << ", \"indices\": " << s.indices << ", \"triangles\": " << s.triangles
+            << ", \"submeshes\": " << s.submeshes << ", \"levels\": " << s.levels << ", \"meshlets\": " << s.meshlets
+            << ", \"materials\": " << s.materials << ", \"bytesPerVertex\": " << s.vertexSize << ", \"bytesPerIndex\": " << s.indexSize
+            << ", \"fileSize\": " << s.fileSize << ", \"dedup\": " << s.dedup << ", \"vertexCache\": [";
+        for (const auto& c : s.caches) {
+            out << (&c != &s.caches.front() ? ", " : "") << "{\"size\": " << c.cacheSize << ", \"acmr\": " << c.stats.acmr
+                << ", \"atvr\": " << c.stats.atvr << "}";
+        }
+        out << "], \"overdraw\": " << s.overdraw.overdraw << ", \"bounds\": {\"min\": ";
+        stats::writeVector(out, s.bounds.min);
+        out << ", \"max\": ";
+        stats::writeVector(out, s.bounds.max);
+        out << ", \"center\": ";
+        stats::writeVector(out, s.bounds.center);
+        out << ", \"radius\": " << s.bounds.radius << "}}";
+
+        out.flags(flags);
+        out.precision(precision);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,435 @@
+#pragma once
+
+#include "application/mesh.hpp"
+#include "base/filemap.hpp"
+#include "obj.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace game::converter
+{
+    namespace stream
+    {
+        // Temporary file of fixed size records, written sequentially and removed when it goes out of scope
+        template<class T>
+        class spill
+        {
+        public:
+
+            spill(std::string path)
+                : _path(std::move(path)), _out(_path, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary)
+            {
+                if (!_out.is_open())
+                    throw std::runtime_error("unable to create spill file");
+            }
+
+            spill(const spill& rhs) = delete;
+
+            ~spill()
+            {
+                _out.close();
+                std::remove(_path.c_str());
+            }
+
+            void write(const T *data, size_t count)
+            {
+                _out.write(reinterpret_cast<const char*>(data), count*sizeof(T));
+                _count += count;
+            }
+
+            void push(const T& value)
+            {
+                write(&value, 1);
+            }
+
+            // Ends writing, the records can be read from then on
+            void finish()
+            {
+                _out.close();
+                if (_out.fail())
+                    throw std::runtime_error("unable to write spill file");
+            }
+
+            std::vector<T> readAll() const
+            {
+                std::vector<T> out(_count);
+                std::ifstream in(_path, std::ifstream::in | std::ifstream::binary);
+                in.read(reinterpret_cast<char*>(out.data()), _count*sizeof(T));
+                if (!in)
+                    throw std::runtime_error("unable to read spill file");
+                return out;
+            }
+
+            // Read only view through the page cache, which the system can evict at will
+            native::fileMapping map() const
+            {
+                return _count ? native::fileMapping(_path) : native::fileMapping();
+            }
+
+            const std::string& path() const
+            {
+                return _path;
+            }
+
+            uint64_t count() const
+            {
+                return _count;
+            }
+
+        private:
+
+            std::string _path;
+
+            std::ofstream _out;
+
+            uint64_t _count = 0;
+        };
+
+        // Output file written under a temporary name, only commit() gives it the final one so a failed conversion
+        // never leaves a truncated file behind
+        class output
+        {
+        public:
+
+            output(std::string path)
+                : _path(std::move(path)), _temporary(_path + ".tmp"),
+                  _out(_temporary, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary)
+            {
+                if (!_out.is_open())
+                    throw std::runtime_error("unable to create model file");
+            }
+
+            output(const output& rhs) = delete;
+
+            ~output()
+            {
+                if (!_committed) {
+                    _out.close();
+                    std::remove(_temporary.c_str());
+                }
+            }
+
+            std::ofstream& stream()
+            {
+                return _out;
+            }
+
+            void commit()
+            {
+                _out.close();
+                if (_out.fail())
+                    throw std::runtime_error("unable to write model file");
+
+                std::error_code ec;
+                std::filesystem::rename(_temporary, _path, ec);
+                if (ec)
+                    throw std::runtime_error("unable to write model file");
+                _committed = true;
+            }
+
+        private:
+
+            std::string _path, _temporary;
+
+            std::ofstream _out;
+
+            bool _committed = false;
+        };
+
+        // A corner waiting to be welded, records with equal keys become one vertex
+        struct cornerRecord
+        {
+            objIndex key;
+
+            uint32_t padding;
+
+            uint64_t corner;
+        };
+
+        struct remapRecord
+        {
+            uint64_t corner;
+
+            uint32_t vertex;
+
+            uint32_t padding;
+        };
+    }
+
+    struct streamStats
+    {
+        uint64_t positions, corners, vertices;
+
+        size_t partitions, windows;
+
+        uint64_t spillBytes;
+    };
+
+    /*
+     * Converts an obj file that does not need to fit in memory into a mesh file, keeping the working set close to
+     * budget bytes. The text is parsed in blocks, the attributes and the resolved corners are spilled to files
+     * next to the output. The corners are then distributed over partitions by their position index, every
+     * partition is sorted and welded on its own: identical index triples become one vertex, as do equal vertices
+     * that share a position index. The vertex ids of the corners go to a second set of files, one per window of
+     * corners, which become the index section in order. The vertices follow the order of the position indices,
+     * the mesh file gets 32 bit indices, no submeshes and the bounds of the whole mesh.
+     */
+
+    inline streamStats convertStreaming(const std::string& input, const std::string& output, size_t budget, unsigned threads)
+    {
+        std::ifstream in(input, std::ifstream::in | std::ifstream::binary);
+        if (!in.is_open())
+            throw std::runtime_error("unable to open obj file");
+
+        stream::spill<glm::vec3> positions(output + ".spill.v"), normals(output + ".spill.vn");
+        stream::spill<glm::vec2> texcoords(output + ".spill.vt");
+        stream::spill<objIndex> corners(output + ".spill.f");
+
+        // Parse the text in blocks of whole lines, a line that does not fit grows the block
+        std::vector<obj::chunk> chunks(std::max(1u, threads));
+        std::string block;
+        size_t carry = 0, blockSize = std::max<size_t>(budget / 4, 1 << 16);
+        while (in || carry) {
+            block.resize(carry + blockSize);
+            in.read(block.data() + carry, blockSize);
+            auto size = carry + static_cast<size_t>(in.gcount());
+            block.resize(size);
+
+            auto end = in ? block.find_last_of('\n') + 1 : size;
+            if (in && end == 0) {
+                carry = size;
+                continue;
+            }
+
+            std::string_view text(block.data(), end);
+            parallelFor(static_cast<unsigned>(chunks.size()), chunks.size(), [&](size_t first, size_t last, unsigned) {
+                for (auto i = first; i < last; ++i) {
+                    chunks[i] = obj::chunk();
+                    auto begin = obj::lineStart(text, text.size()*i/chunks.size());
+                    auto stop = obj::lineStart(text, text.size()*(i+1)/chunks.size());
+                    obj::parseChunk(text.data()+begin, text.data()+stop, chunks[i]);
+                }
+            });
+
+            for (auto& c : chunks) {
+                int64_t base[3] = {
+                    static_cast<int64_t>(positions.count()),
+                    static_cast<int64_t>(texcoords.count()),
+                    static_cast<int64_t>(normals.count())
+                };
+
+                for (const auto& raw : c.corners) {
+                    int32_t resolved[3];
+                    for (auto a = 0; a < 3; ++a) {
+                        auto value = raw.relative & (1 << a) ? base[a] + raw.value[a] : int64_t(raw.value[a]) - 1;
+                        if (value < (a == 0 ? 0 : -1) || (value < 0 && (raw.relative & (1 << a) || raw.value[a] != 0)) || value > INT32_MAX)
+                            throw std::runtime_error("face index out of range");
+                        resolved[a] = static_cast<int32_t>(value);
+                    }
+                    corners.push({resolved[0], resolved[1], resolved[2]});
+                }
+
+                positions.write(c.positions.data(), c.positions.size());
+                texcoords.write(c.texcoords.data(), c.texcoords.size());
+                normals.write(c.normals.data(), c.normals.size());
+            }
+
+            carry = size - end;
+            std::copy(block.begin() + end, block.begin() + size, block.begin());
+            if (!in && carry == 0)
+                break;
+        }
+        block = std::string();
+        chunks.clear();
+
+        positions.finish();
+        texcoords.finish();
+        normals.finish();
+        corners.finish();
+
+        streamStats stats = {};
+        stats.positions = positions.count();
+        stats.corners = corners.count() - corners.count() % 3;
+
+        // Distribute the corners over partitions of position indices that can be welded within the budget
+        auto partitionCount = std::max<size_t>(1, (stats.corners * sizeof(stream::cornerRecord) + budget - 1) / budget);
+        auto windowSize = std::max<size_t>(1, budget / (sizeof(stream::remapRecord) + sizeof(uint32_t)));
+        auto windowCount = std::max<size_t>(1, (stats.corners + windowSize - 1) / windowSize);
+        stats.partitions = partitionCount;
+        stats.windows = windowCount;
+        stats.spillBytes = positions.count()*sizeof(glm::vec3) + texcoords.count()*sizeof(glm::vec2) + normals.count()*sizeof(glm::vec3)
+            + corners.count()*sizeof(objIndex) + stats.corners*(sizeof(stream::cornerRecord) + sizeof(stream::remapRecord));
+
+        std::vector<std::unique_ptr<stream::spill<stream::cornerRecord>>> partitions;
+        for (size_t p = 0; p < partitionCount; ++p)
+            partitions.push_back(std::make_unique<stream::spill<stream::cornerRecord>>(output + ".spill.p" + std::to_string(p)));
+        {
+            std::ifstream cin(corners.path(), std::ifstream::in | std::ifstream::binary);
+            std::vector<objIndex> buffer(std::max<size_t>(1, budget / sizeof(objIndex) / 4));
+            for (uint64_t first = 0; first < stats.corners; first += buffer.size()) {
+                auto count = std::min<uint64_t>(buffer.size(), stats.corners - first);
+                cin.read(reinterpret_cast<char*>(buffer.data()), count*sizeof(objIndex));
+                if (!cin)
+                    throw std::runtime_error("unable to read spill file");
+
+                for (uint64_t i = 0; i < count; ++i) {
+                    const auto& c = buffer[i];
+                    if (c.v >= static_cast<int64_t>(stats.positions) || c.vt >= static_cast<int64_t>(texcoords.count())
+                        || c.vn >= static_cast<int64_t>(normals.count()))
+                        throw std::runtime_error("face index out of range");
+                    auto p = static_cast<size_t>(uint64_t(c.v) * partitionCount / std::max<uint64_t>(1, stats.positions));
+                    partitions[p]->push({c, 0, first + i});
+                }
+            }
+        }
+        for (auto& p : partitions)
+            p->finish();
+
+        // The directory is written last, the vertices follow it directly
+        stream::output file(output);
+        auto& out = file.stream();
+
+        std::vector<meshfile::section> sections(3);
+        const char zeros[meshfile::alignment] = {};
+        auto start = meshfile::align(sizeof(meshfile::fileHeader) + sections.size()*sizeof(meshfile::section));
+        for (uint64_t written = 0; written < start; written += std::min<uint64_t>(sizeof(zeros), start - written))
+            out.write(zeros, std::min<uint64_t>(sizeof(zeros), start - written));
+
+        std::vector<std::unique_ptr<stream::spill<stream::remapRecord>>> windows;
+        for (size_t w = 0; w < windowCount; ++w)
+            windows.push_back(std::make_unique<stream::spill<stream::remapRecord>>(output + ".spill.w" + std::to_string(w)));
+
+        auto vmap = positions.map(), tmap = texcoords.map(), nmap = normals.map();
+        auto vdata = reinterpret_cast<const glm::vec3*>(vmap.data());
+        auto tdata = reinterpret_cast<const glm::vec2*>(tmap.data());
+        auto ndata = reinterpret_cast<const glm::vec3*>(nmap.data());
+
+        meshfile::boundingVolume bounds = {};
+        glm::vec3 center(0.0f);
+        auto radius = -1.0f;
+
+        std::vector<std::pair<meshfile::vertexData, uint32_t>> shared;
+        for (auto& partition : partitions) {
+            auto records = partition->readAll();
+            partition.reset();
+            std::sort(records.begin(), records.end(), [](const stream::cornerRecord& lhs, const stream::cornerRecord& rhs) {
+                const auto& a = lhs.key;
+                const auto& b = rhs.key;
+                return a.v != b.v ? a.v < b.v : a.vt != b.vt ? a.vt < b.vt : a.vn < b.vn;
+            });
+
+            for (size_t i = 0; i < records.size();) {
+                const auto& key = records[i].key;
+                if (i == 0 || key.v != records[i-1].key.v)
+                    shared.clear();
+
+                meshfile::vertexData v;
+                v.position = vdata[key.v];
+                v.texcoord = key.vt >= 0 ? glm::vec2(tdata[key.vt].x, 1.0f - tdata[key.vt].y) : glm::vec2(0.0f, 0.0f);
+                v.normal = key.vn >= 0 ? ndata[key.vn] : glm::vec3(0.0f, 0.0f, 0.0f);
+
+                auto it = std::find_if(shared.begin(), shared.end(), [&v](const auto& s) {
+                    return s.first == v;
+                });
+                uint32_t id;
+                if (it != shared.end()) {
+                    id = it->second;
+                }
+                else {
+                    if (stats.vertices > UINT32_MAX)
+                        throw std::runtime_error("too many vertices");
+                    id = static_cast<uint32_t>(stats.vertices++);
+                    shared.emplace_back(v, id);
+                    out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+
+                    // Box and a sphere grown with every vertex (Ritter)
+                    if (radius < 0.0f) {
+                        bounds.min = bounds.max = center = v.position;
+                        radius = 0.0f;
+                    }
+                    bounds.min = glm::min(bounds.min, v.position);
+                    bounds.max = glm::max(bounds.max, v.position);
+                    auto d = glm::distance(center, v.position);
+                    if (d > radius) {
+                        radius = (radius + d) * 0.5f;
+                        center = v.position + (center - v.position) * (radius / d);
+                    }
+                }
+
+                for (; i < records.size() && records[i].key.v == key.v && records[i].key.vt == key.vt && records[i].key.vn == key.vn; ++i)
+                    windows[records[i].corner / windowSize]->push({records[i].corner, id, 0});
+            }
+        }
+        partitions.clear();
+        for (auto& w : windows)
+            w->finish();
+
+        auto& vs = sections[0];
+        vs.type = meshfile::sectionType::vertices;
+        vs.offset = start;
+        vs.count = stats.vertices;
+        vs.stride = sizeof(meshfile::vertexData);
+        vs.size = vs.count * vs.stride;
+        vs.layout = meshfile::defaultLayout();
+
+        // Scatter the vertex ids of every window of corners and append them in order
+        auto& is = sections[1];
+        is.type = meshfile::sectionType::indices;
+        is.offset = meshfile::align(vs.offset + vs.size);
+        is.count = stats.corners;
+        is.stride = sizeof(uint32_t);
+        is.size = is.count * is.stride;
+        out.write(zeros, is.offset - (vs.offset + vs.size));
+
+        std::vector<uint32_t> indices;
+        for (size_t w = 0; w < windowCount; ++w) {
+            auto first = w * windowSize;
+            indices.assign(std::min<uint64_t>(windowSize, stats.corners - std::min<uint64_t>(first, stats.corners)), 0);
+            for (const auto& r : windows[w]->readAll())
+                indices[r.corner - first] = r.vertex;
+            windows[w].reset();
+            out.write(reinterpret_cast<const char*>(indices.data()), indices.size()*sizeof(uint32_t));
+        }
+
+        // The box sphere is tighter for evenly spread vertices
+        bounds.center = (bounds.min + bounds.max) * 0.5f;
+        bounds.radius = glm::length(bounds.max - bounds.min) * 0.5f;
+        if (radius >= 0.0f && radius < bounds.radius) {
+            bounds.center = center;
+            bounds.radius = radius;
+        }
+
+        auto& bs = sections[2];
+        bs.type = meshfile::sectionType::bounds;
+        bs.offset = meshfile::align(is.offset + is.size);
+        bs.count = 1;
+        bs.stride = sizeof(meshfile::boundingVolume);
+        bs.size = bs.stride;
+        out.write(zeros, bs.offset - (is.offset + is.size));
+        out.write(reinterpret_cast<const char*>(&bounds), sizeof(bounds));
+
+        auto fileSize = meshfile::align(bs.offset + bs.size);
+        out.write(zeros, fileSize - (bs.offset + bs.size));
+
+        meshfile::fileHeader fh = {};
+        std::copy(meshfile::magic, meshfile::magic+sizeof(meshfile::magic), fh.magic);
+        fh.version = meshfile::version;
+        fh.sectionCount = static_cast<uint32_t>(sections.size());
+        fh.fileSize = fileSize;
+
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&fh), sizeof(fh));
+        out.write(reinterpret_cast<const char*>(sections.data()), sections.size()*sizeof(meshfile::section));
+        file.commit();
+
+        return stats;
+    }
+}
\ No newline at end of file
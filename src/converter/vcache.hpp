@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace game::converter
+{
+    struct vertexCacheStats
+    {
+        double acmr;        // Average cache miss ratio: transformed vertices per triangle
+
+        double atvr;        // Average transformed vertex ratio: transformed vertices per referenced vertex
+    };
+
+    // Simulates a FIFO post-transform cache of cacheSize entries over the index buffer
+    inline vertexCacheStats analyzeVertexCache(const uint32_t *indices, size_t count, size_t vertexCount, unsigned cacheSize = 32)
+    {
+        std::vector<uint64_t> stamps(vertexCount, 0);
+        uint64_t time = cacheSize + 1;
+        size_t misses = 0, referenced = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+            auto& stamp = stamps[indices[i]];
+            referenced += (stamp == 0);
+            if (time - stamp > cacheSize) {
+                stamp = time++;
+                ++misses;
+            }
+        }
+
+        vertexCacheStats out = {0.0, 0.0};
+        if (count >= 3)
+            out.acmr = static_cast<double>(misses) / (count/3);
+        if (referenced)
+            out.atvr = static_cast<double>(misses) / referenced;
+        return out;
+    }
+
+    namespace vcache
+    {
+        constexpr unsigned cacheSize = 32;
+
+        constexpr unsigned maxValence = 32;
+
+        // Vertex scores from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+        struct scoreTable
+        {
+            scoreTable()
+            {
+                for (unsigned i = 0; i < cacheSize; ++i) {
+                    if (i < 3)
+                        cache[i] = 0.75f;
+                    else
+                        cache[i] = std::pow(1.0f - static_cast<float>(i-3)/(cacheSize-3), 1.5f);
+                }
+
+                valence[0] = 0.0f;
+                for (unsigned i = 1; i <= maxValence; ++i)
+                    valence[i] = 2.0f / std::sqrt(static_cast<float>(i));
+            }
+
+            float score(int position, unsigned remaining) const
+            {
+                if (remaining == 0)
+                    return -1.0f;
+                auto s = valence[std::min(remaining, maxValence)];
+                if (position >= 0)
+                    s += cache[position];
+                return s;
+            }
+
+            float cache[cacheSize];
+
+            float valence[maxValence+1];
+        };
+    }
+
+    /*
+     * Reorders the triangles of the index buffer in place so that consecutive triangles reuse recently
+     * transformed vertices, using Forsyth's greedy algorithm on a simulated LRU cache.
+     */
+
+    inline void optimizeVertexCache(uint32_t *indices, size_t count, size_t vertexCount)
+    {
+        static const vcache::scoreTable table;
+        auto triangles = count / 3;
+        if (triangles == 0)
+            return;
+
+        // Triangle adjacency of every vertex in compressed row form
+        std::vector<uint32_t> offsets(vertexCount+1, 0), remaining(vertexCount, 0);
+        for (size_t i = 0; i < triangles*3; ++i)
+            ++remaining[indices[i]];
+        for (size_t v = 0; v < vertexCount; ++v)
+            offsets[v+1] = offsets[v] + remaining[v];
+
+        std::vector<uint32_t> adjacency(triangles*3), fill(offsets.begin(), offsets.end()-1);
+        for (size_t t = 0; t < triangles; ++t) {
+            for (auto k = 0; k < 3; ++k)
+                adjacency[fill[indices[t*3+k]]++] = static_cast<uint32_t>(t);
+        }
+
+        std::vector<int> position(vertexCount, -1);
+        std::vector<float> vertexScore(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v)
+            vertexScore[v] = table.score(-1, remaining[v]);
+
+        std::vector<float> triangleScore(triangles);
+        std::vector<bool> emitted(triangles, false);
+        for (size_t t = 0; t < triangles; ++t)
+            triangleScore[t] = vertexScore[indices[t*3]] + vertexScore[indices[t*3+1]] + vertexScore[indices[t*3+2]];
+
+        std::vector<uint32_t> output;
+        output.reserve(triangles*3);
+
+        uint32_t cache[vcache::cacheSize+3], next[vcache::cacheSize+3];
+        unsigned cacheCount = 0;
+        size_t cursor = 0;
+
+        auto best = static_cast<size_t>(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+        while (best != triangles) {
+            uint32_t tri[3] = {indices[best*3], indices[best*3+1], indices[best*3+2]};
+            output.insert(output.end(), tri, tri+3);
+            emitted[best] = true;
+
+            // Remove the triangle from the adjacency of its vertices
+            for (auto v : tri) {
+                auto begin = adjacency.begin() + offsets[v];
+                auto end = begin + remaining[v];
+                std::iter_swap(std::find(begin, end, static_cast<uint32_t>(best)), end-1);
+                --remaining[v];
+            }
+
+            // Move the triangle vertices to the front of the cache
+            unsigned nextCount = 0;
+            for (auto v : tri) {
+                if (std::find(next, next+nextCount, v) == next+nextCount)
+                    next[nextCount++] = v;
+            }
+            for (unsigned i = 0; i < cacheCount; ++i) {
+                if (std::find(tri, tri+3, cache[i]) == tri+3)
+                    next[nextCount++] = cache[i];
+            }
+
+            // Update the scores of everything that was or is in the cache
+            for (unsigned i = 0; i < nextCount; ++i) {
+                auto v = next[i];
+                position[v] = i < vcache::cacheSize ? static_cast<int>(i) : -1;
+
+                auto score = table.score(position[v], remaining[v]);
+                auto delta = score - vertexScore[v];
+                vertexScore[v] = score;
+
+                for (auto a = offsets[v]; a < offsets[v] + remaining[v]; ++a)
+                    triangleScore[adjacency[a]] += delta;
+            }
+
+            // The next triangle is the best one that uses a cached vertex
+            best = triangles;
+            float bestScore = -1.0f;
+            for (unsigned i = 0; i < std::min(nextCount, vcache::cacheSize); ++i) {
+                auto v = next[i];
+                for (auto a = offsets[v]; a < offsets[v] + remaining[v]; ++a) {
+                    if (triangleScore[adjacency[a]] > bestScore) {
+                        bestScore = triangleScore[adjacency[a]];
+                        best = adjacency[a];
+                    }
+                }
+            }
+
+            cacheCount = std::min(nextCount, vcache::cacheSize);
+            std::copy(next, next+cacheCount, cache);
+
+            // Dead end, continue with the next triangle that has not been emitted yet
+            if (best == triangles) {
+                while (cursor < triangles && emitted[cursor])
+                    ++cursor;
+                best = cursor;
+            }
+        }
+
+        std::copy(output.begin(), output.end(), indices);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace game::converter
+{
+    struct vertexFetchStats
+    {
+        size_t fetched;     // Bytes read from memory through the simulated cache
+
+        double overfetch;   // Fetched bytes relative to the size of all referenced vertices
+    };
+
+    // Simulates a small cache of 64 byte lines in front of the vertex buffer while walking the index buffer
+    inline vertexFetchStats analyzeVertexFetch(const uint32_t *indices, size_t count, size_t vertexCount, size_t vertexSize,
+        size_t cacheLines = 256)
+    {
+        constexpr size_t lineSize = 64;
+
+        std::vector<uint64_t> stamps((vertexCount*vertexSize + lineSize-1) / lineSize, 0);
+        std::vector<bool> referenced(vertexCount, false);
+        uint64_t time = cacheLines + 1;
+        size_t unique = 0;
+
+        vertexFetchStats out = {0, 0.0};
+        for (size_t i = 0; i < count; ++i) {
+            auto v = indices[i];
+            if (!referenced[v]) {
+                referenced[v] = true;
+                ++unique;
+            }
+
+            for (auto line = v*vertexSize / lineSize; line <= ((v+1)*vertexSize - 1) / lineSize; ++line) {
+                if (time - stamps[line] > cacheLines) {
+                    stamps[line] = time++;
+                    out.fetched += lineSize;
+                }
+            }
+        }
+
+        if (unique)
+            out.overfetch = static_cast<double>(out.fetched) / (unique*vertexSize);
+        return out;
+    }
+
+    /*
+     * Renumbers the vertices in the order the index buffer first uses them and reorders the vertex array to
+     * match, so the vertex fetch walks memory mostly linearly. Vertices that are never referenced are dropped.
+     * Meshes that already had a good layout, for instance a grid after the vertex cache pass, can fetch more
+     * in first use order. The order with the fewest bytes fetched by analyzeVertexFetch() is kept: first use,
+     * the original one without the unused vertices, or the original one as it was.
+     */
+
+    template<class Vertex>
+    void optimizeVertexFetch(uint32_t *indices, size_t count, std::vector<Vertex>& vertices)
+    {
+        constexpr auto unused = ~uint32_t(0);
+        std::vector<uint32_t> firstUse(vertices.size(), unused), compacted(vertices.size(), unused);
+        uint32_t next = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+            auto& r = firstUse[indices[i]];
+            if (r == unused) {
+                r = next++;
+                compacted[indices[i]] = 0;
+            }
+        }
+        uint32_t kept = 0;
+        for (auto& c : compacted) {
+            if (c != unused)
+                c = kept++;
+        }
+
+        auto fetched = [&](const std::vector<uint32_t>& remap) {
+            std::vector<uint32_t> mapped(count);
+            for (size_t i = 0; i < count; ++i)
+                mapped[i] = remap[indices[i]];
+            return analyzeVertexFetch(mapped.data(), count, next, sizeof(Vertex)).fetched;
+        };
+        auto best = analyzeVertexFetch(indices, count, vertices.size(), sizeof(Vertex)).fetched;
+        const std::vector<uint32_t> *remap = nullptr;
+        for (const auto *candidate : {&firstUse, &compacted}) {
+            if (auto f = fetched(*candidate); f < best) {
+                best = f;
+                remap = candidate;
+            }
+        }
+        if (!remap)
+            return;
+
+        for (size_t i = 0; i < count; ++i)
+            indices[i] = (*remap)[indices[i]];
+
+        std::vector<Vertex> out(next);
+        for (size_t v = 0; v < vertices.size(); ++v) {
+            if ((*remap)[v] != unused)
+                out[(*remap)[v]] = vertices[v];
+        }
+        vertices = std::move(out);
+    }
+}
\ No newline at end of file
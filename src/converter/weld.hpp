@@ -0,0 +1,219 @@
+#pragma once
+
+#include "application/mesh.hpp"
+#include "parallel.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace game::converter
+{
+    inline uint64_t rotl64(uint64_t value, int shift)
+    {
+        return (value << shift) | (value >> (64 - shift));
+    }
+
+    // Murmur3 style mixing over the four 64 bit words of a vertex, bit exact just like the file contents
+    inline uint64_t hashVertex(const meshfile::vertexData& v)
+    {
+        static_assert(sizeof(v) == 4*sizeof(uint64_t), "vertexData is expected to be 32 bytes");
+
+        uint64_t words[4];
+        std::memcpy(words, &v, sizeof(words));
+
+        uint64_t h = 0x9E3779B97F4A7C15ull;
+        for (auto w : words) {
+            w *= 0x87C37B91114253D5ull;
+            w = rotl64(w, 31);
+            w *= 0x4CF5AD432745937Full;
+            h ^= w;
+            h = rotl64(h, 27) * 5 + 0x52DCE729;
+        }
+
+        // Final avalanche so the low bits can be used as a table index directly
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    /*
+     * Grid steps for welding noisy exports. Every attribute is rounded to a multiple of its step before the
+     * vertex is hashed, so corners that only differ by float noise become the same vertex. A step of 0 keeps the
+     * attribute bit exact.
+     */
+
+    struct weldGrid
+    {
+        float position = 0.0f;
+
+        float texcoord = 0.0f;
+
+        float normal = 0.0f;
+    };
+
+    inline float snap(float x, float step)
+    {
+        // Adding zero turns -0 into +0, the hash compares bits
+        return step > 0.0f ? std::round(x / step) * step + 0.0f : x;
+    }
+
+    inline meshfile::vertexData snapVertex(meshfile::vertexData v, const weldGrid& grid)
+    {
+        for (auto i = 0; i < 3; ++i) {
+            v.position[i] = snap(v.position[i], grid.position);
+            v.normal[i] = snap(v.normal[i], grid.normal);
+        }
+        for (auto i = 0; i < 2; ++i)
+            v.texcoord[i] = snap(v.texcoord[i], grid.texcoord);
+        return v;
+    }
+
+    /*
+     * Flat open addressing table that welds identical vertices. Every slot stores the index of the vertex in
+     * the output array and the upper half of its hash, so a lookup or insert is a single linear probe.
+     */
+
+    class weldTable
+    {
+    public:
+
+        static constexpr uint32_t empty = ~uint32_t(0);
+
+        weldTable(size_t expected = 0)
+        {
+            reserve(expected);
+        }
+
+        void reserve(size_t expected)
+        {
+            _vertices.reserve(expected);
+
+            size_t capacity = 16;
+            while (capacity < expected*2)
+                capacity *= 2;
+            if (capacity > _slots.size())
+                rehash(capacity);
+        }
+
+        // Returns the index of v in the output array, appending it first when it was not seen before
+        uint32_t weld(const meshfile::vertexData& v)
+        {
+            if ((_vertices.size()+1)*2 > _slots.size())
+                rehash(_slots.size()*2);
+
+            auto h = hashVertex(v);
+            auto tag = static_cast<uint32_t>(h >> 32);
+            auto mask = _slots.size() - 1;
+
+            for (auto i = static_cast<size_t>(h) & mask;; i = (i + 1) & mask) {
+                auto& slot = _slots[i];
+                if (slot.index == empty) {
+                    slot.index = static_cast<uint32_t>(_vertices.size());
+                    slot.tag = tag;
+                    _vertices.push_back(v);
+                    return slot.index;
+                }
+                if (slot.tag == tag && _vertices[slot.index] == v)
+                    return slot.index;
+            }
+        }
+
+        size_t size() const
+        {
+            return _vertices.size();
+        }
+
+        const std::vector<meshfile::vertexData>& vertices() const
+        {
+            return _vertices;
+        }
+
+        std::vector<meshfile::vertexData> release()
+        {
+            _slots.assign(_slots.size(), {empty, 0});
+            return std::move(_vertices);
+        }
+
+    private:
+
+        void rehash(size_t capacity)
+        {
+            std::vector<slot> slots(capacity, {empty, 0});
+            auto mask = capacity - 1;
+
+            for (uint32_t index = 0; index < _vertices.size(); ++index) {
+                auto h = hashVertex(_vertices[index]);
+                auto i = static_cast<size_t>(h) & mask;
+                while (slots[i].index != empty)
+                    i = (i + 1) & mask;
+                slots[i] = {index, static_cast<uint32_t>(h >> 32)};
+            }
+            _slots = std::move(slots);
+        }
+
+        struct slot
+        {
+            uint32_t index;
+
+            uint32_t tag;
+        };
+
+        std::vector<slot> _slots;
+
+        std::vector<meshfile::vertexData> _vertices;
+    };
+
+    /*
+     * Welds count corners produced by corner(i) into vertices and indices. Every thread welds its own range
+     * of corners into a local table, after which the local tables are merged in thread order. A vertex is
+     * therefore always first seen in the same order as in a single threaded run, making the output identical.
+     */
+
+    template<class Corner>
+    void weld(size_t count, Corner&& corner, unsigned threads, std::vector<meshfile::vertexData>& vertices,
+        std::vector<uint32_t>& indices)
+    {
+        indices.resize(count);
+
+        if (threads <= 1 || count < 2*threads) {
+            weldTable table(count/4);
+            for (size_t i = 0; i < count; ++i)
+                indices[i] = table.weld(corner(i));
+            vertices = table.release();
+            return;
+        }
+
+        std::vector<std::vector<meshfile::vertexData>> local(threads);
+        parallelFor(threads, count, [&](size_t begin, size_t end, unsigned t) {
+            weldTable table((end-begin)/4);
+            for (auto i = begin; i < end; ++i)
+                indices[i] = table.weld(corner(i));
+            local[t] = table.release();
+        });
+
+        // Merge the local tables in order, remapping local indices to global ones
+        size_t total = 0;
+        for (const auto& l : local)
+            total += l.size();
+
+        weldTable table(total);
+        std::vector<std::vector<uint32_t>> remap(threads);
+        for (unsigned t = 0; t < threads; ++t) {
+            remap[t].reserve(local[t].size());
+            for (const auto& v : local[t])
+                remap[t].push_back(table.weld(v));
+            local[t] = {};
+        }
+
+        parallelFor(threads, count, [&](size_t begin, size_t end, unsigned t) {
+            for (auto i = begin; i < end; ++i)
+                indices[i] = remap[t][indices[i]];
+        });
+
+        vertices = table.release();
+    }
+}
\ No newline at end of file
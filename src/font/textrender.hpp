@@ -1,6 +1,7 @@
 #pragma once
 
 #include "base/exception.hpp"
+#include "base/assetpack.hpp"
 #include "glyph.hpp"
 
 #include <string>
@@ -110,8 +111,12 @@ namespace game::font
 
 		void loadFace()
 		{
-			// Load the face
-			auto err = FT_New_Face(_lib, _name.c_str(), 0, &_face);
+			// Load the face, a face from the asset pack reads the mapping directly for as long as it exists
+			FT_Error err;
+			if (auto packed = assetPack::lookup(_name); packed.data())
+				err = FT_New_Memory_Face(_lib, reinterpret_cast<const FT_Byte*>(packed.data()), static_cast<FT_Long>(packed.size()), 0, &_face);
+			else
+				err = FT_New_Face(_lib, _name.c_str(), 0, &_face);
 			if (err)
 				throw exception(except_e::FONT_BASE, "FT_New_Face");
 			err = FT_Set_Char_Size(_face, _size*64, _size*64, 144, 144);
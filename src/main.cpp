@@ -1,5 +1,8 @@
+#include <cstring>
 #include <iostream>
 #include "application/builder.hpp"
+#include "base/assetpack.hpp"
+#include "opengl/programcache.hpp"
 
 using namespace game;
 
@@ -7,7 +10,16 @@ int main(int argc, char *argv[])
 {   
     std::ios_base::sync_with_stdio(false);
     try {
+        // Assets that are not in the pack are loaded from the loose files
+        assetPack::mount("data/assets.pak");
         auto app = applicationBuilder().build();
+
+        // The shaders are set up with the window, run twice to compare an empty program cache with a full one
+        if (argc > 1 && std::strcmp(argv[1], "--program-stats") == 0) {
+            const auto& programs = opengl::programCache::stats();
+            std::cout << "programs: " << programs.compiled << " compiled, " << programs.loaded << " from cache, " << programs.rejected
+                << " rejected in " << programs.seconds * 1000.0 << " ms" << std::endl;
+        }
 		app.run();
     }
     catch (const std::exception& e) {
@@ -0,0 +1,60 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include "application/mesh.hpp"
+#include "converter/stats.hpp"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    ios_base::sync_with_stdio(false);
+
+    vector<const char*> inputs;
+    bool json = false;
+
+    for (auto i = 1; i < argc; ++i) {
+        string_view arg(argv[i]);
+        if (arg == "-J") {
+            json = true;
+        }
+        else if (!arg.empty() && arg[0] != '-') {
+            inputs.push_back(argv[i]);
+        }
+        else {
+            inputs.clear();
+            break;
+        }
+    }
+
+    if (inputs.empty()) {
+        cout << "Usage: mshinfo [-J] <file.msh>..." << endl;
+        cout << "  reports vertex and index sizes, dedup, vertex cache ACMR and ATVR, overdraw and bounds of every mesh" << endl;
+        cout << "  -J  print one JSON object per mesh and line instead" << endl;
+        return 0;
+    }
+
+    // Files that fail to load are reported on the error stream so the JSON output stays parsable
+    auto failed = 0;
+    for (auto input : inputs) {
+        try {
+            game::meshfile mf(input, game::meshfile::loadMode::map);
+            auto stats = game::converter::analyzeMesh(mf, filesystem::file_size(input));
+
+            if (json) {
+                game::converter::writeJson(cout, input, stats);
+                cout << endl;
+            }
+            else {
+                cout << input << ":" << endl;
+                game::converter::printStats(cout, stats);
+            }
+        }
+        catch (const std::exception& e) {
+            cerr << input << ": " << e.what() << endl;
+            ++failed;
+        }
+    }
+    return failed ? 1 : 0;
+}
\ No newline at end of file
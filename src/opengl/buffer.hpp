@@ -1,10 +1,26 @@
 #pragma once
 
 #include "glbase.hpp"
+#include "staging.hpp"
 #include <vector>
 
 namespace game::opengl
 {
+    // Immutable storage that only the GPU writes, the data is copied in through the staging ring. Without a current
+    // ring the storage is created with the data, it can not be written afterwards
+    inline void createStorage(GLuint buffer, const void *data, GLsizeiptr size)
+    {
+        if (!size)
+            return;
+
+        if (!stagingBuffer::current()) {
+            glNamedBufferStorage(buffer, size, data, 0);
+            return;
+        }
+        glNamedBufferStorage(buffer, size, nullptr, 0);
+        stagingBuffer::upload(buffer, 0, data, size);
+    }
+
     class buffer
     {
     public:
@@ -20,7 +36,7 @@ namespace game::opengl
             if (!_buffer)
                 throw exception(except_e::GRAPHICS_BASE, "glCreateBuffers");
 
-            glNamedBufferData(_buffer, size, data, GL_STATIC_DRAW);
+            createStorage(_buffer, data, size);
         }
 
         buffer(const buffer& rhs) = delete;
@@ -64,8 +80,8 @@ namespace game::opengl
             if (!_buffer[1])
                 throw exception(except_e::GRAPHICS_BASE, "glCreateBuffers");
             
-            glNamedBufferData(_buffer[0], dsize, data, GL_STATIC_DRAW);
-            glNamedBufferData(_buffer[1], isize, indices, GL_STATIC_DRAW);
+            createStorage(_buffer[0], data, dsize);
+            createStorage(_buffer[1], indices, isize);
         }
 
         ~indexedBuffer()
@@ -1,23 +1,92 @@
 #pragma once
 
 #include "modelbase.hpp"
+#include "base/asyncio.hpp"
+#include <memory>
 
 namespace game::opengl
 {
     template<class VIO, typename VI, bool indexed>
     class basicModel : modelBase<VIO, VI, indexed>
     {
+        using base = modelBase<VIO, VI, indexed>;
+
     public:
 
+        // Everything read from disk for the model, see prepare()
+        struct loadData
+        {
+            typename base::meshData mesh;
+
+            texture::source diffuse;
+
+            size_t size() const
+            {
+                return mesh.size() + diffuse.size();
+            }
+        };
+
+        // Reads and decodes the files of the model, does not need the OpenGL context
+        static loadData prepare(std::string_view name)
+        {
+            return {base::prepare(name), texture::prepare(diffusePath(name))};
+        }
+
+        // Files on disk that prepare(name, read) takes from memory, the ones in the asset pack are not listed
+        static std::vector<std::string> files(std::string_view name)
+        {
+            std::vector<std::string> out;
+            if (!assetPack::lookup(base::meshPath(name)).data())
+                out.push_back(base::meshPath(name));
+            if (auto diffuse = texture::file(diffusePath(name)); !diffuse.empty())
+                out.push_back(std::move(diffuse));
+            return out;
+        }
+
+        // The same with files(name) already read, for instance by an asyncReader. Files missing from read are loaded here
+        static loadData prepare(std::string_view name, native::asyncReader::files& read)
+        {
+            auto mesh = read.find(base::meshPath(name));
+            return {mesh == read.end() ? base::prepare(name) : base::prepare(std::move(mesh->second)),
+                texture::prepare(diffusePath(name), read)};
+        }
+
+        // Files that only become known once the mesh is read, the model has none
+        static std::vector<std::string> mapFiles(const loadData&)
+        {
+            return {};
+        }
+
+        static void prepareMaps(loadData&, native::asyncReader::files&)
+        {
+        }
+
         basicModel(std::string_view name)
-            : modelBase<VIO, VI, indexed>(name), modelMatrix(1.0f), _diffuse(std::string(_dir).append(name).append(".jpg"))
+            : basicModel(prepare(name))
         {
         }
 
-        basicModel(const basicModel& rhs) = delete;
+        basicModel(loadData&& data)
+            : base(std::move(data.mesh)), _diffuse(std::make_shared<texture>(data.diffuse)), _modelMatrix(1.0f)
+        {
+        }
+
+        // Placeholder that draws nothing until setResources() gives it a loaded model
+        basicModel()
+            : _diffuse(std::make_shared<texture>()), _modelMatrix(1.0f)
+        {
+        }
+
+        // Another instance of the same model, the mesh and texture are shared and only the model matrix is copied
+        basicModel(const basicModel& rhs)
+            : base(rhs), _diffuse(rhs._diffuse), _modelMatrix(rhs._modelMatrix), _worldBounds(rhs._worldBounds),
+              _boundsDirty(rhs._boundsDirty)
+        {
+        }
 
         basicModel(basicModel&& rhs) noexcept
-            : modelBase<VIO, VI, indexed>(std::move(rhs)), modelMatrix(std::move(rhs.modelMatrix)), _diffuse(std::move(rhs._diffuse))
+            : modelBase<VIO, VI, indexed>(std::move(rhs)), _diffuse(std::move(rhs._diffuse)), _modelMatrix(rhs._modelMatrix),
+              _worldBounds(rhs._worldBounds), _boundsDirty(rhs._boundsDirty)
         {
         }
 
@@ -25,18 +94,103 @@ namespace game::opengl
         {
         }
 
+        // Shares the mesh and textures of a loaded model, the model matrix stays
+        void setResources(const basicModel& loaded)
+        {
+            base::operator=(loaded);
+            _diffuse = loaded._diffuse;
+            _boundsDirty = true;
+        }
+
         void render()
         {
-            glBindTextureUnit(0, _diffuse);
+            glBindTextureUnit(0, *_diffuse);
             modelBase<VIO, VI, indexed>::render();
         }
 
-        glm::mat4 modelMatrix;
+        template<class BindMaterial>
+        void render(BindMaterial&& bindMaterial)
+        {
+            glBindTextureUnit(0, *_diffuse);
+            modelBase<VIO, VI, indexed>::render(std::forward<BindMaterial>(bindMaterial));
+        }
+
+        using modelBase<VIO, VI, indexed>::decode;
+
+        using modelBase<VIO, VI, indexed>::lodCount;
+
+        using modelBase<VIO, VI, indexed>::lodError;
+
+        using modelBase<VIO, VI, indexed>::lod;
+
+        using modelBase<VIO, VI, indexed>::setLod;
+
+        using modelBase<VIO, VI, indexed>::selectLod;
+
+        using modelBase<VIO, VI, indexed>::meshlets;
+
+        using modelBase<VIO, VI, indexed>::selectMeshlets;
+
+        using modelBase<VIO, VI, indexed>::cullMeshlets;
+
+        using modelBase<VIO, VI, indexed>::bounds;
+
+        using modelBase<VIO, VI, indexed>::submeshBounds;
+
+        using modelBase<VIO, VI, indexed>::materials;
+
+        const glm::mat4& modelMatrix() const
+        {
+            return _modelMatrix;
+        }
+
+        void setModelMatrix(const glm::mat4& m)
+        {
+            _modelMatrix = m;
+            _boundsDirty = true;
+        }
+
+        /*
+         * Bounds of the model in world space, only recomputed after the model matrix changed. The box encloses the
+         * transformed object space box (Arvo), the sphere radius is scaled by the largest axis scale.
+         */
+
+        const meshfile::boundingVolume& worldBounds() const
+        {
+            if (_boundsDirty) {
+                const auto& b = bounds();
+                auto lo = glm::vec3(_modelMatrix[3]), hi = lo;
+                for (auto j = 0; j < 3; ++j) {
+                    for (auto i = 0; i < 3; ++i) {
+                        auto a = _modelMatrix[j][i] * b.min[j], c = _modelMatrix[j][i] * b.max[j];
+                        lo[i] += std::min(a, c);
+                        hi[i] += std::max(a, c);
+                    }
+                }
+
+                auto scale = std::max({glm::length(glm::vec3(_modelMatrix[0])), glm::length(glm::vec3(_modelMatrix[1])),
+                    glm::length(glm::vec3(_modelMatrix[2]))});
+                _worldBounds = {lo, hi, glm::vec3(_modelMatrix * glm::vec4(b.center, 1.0f)), b.radius * scale};
+                _boundsDirty = false;
+            }
+            return _worldBounds;
+        }
 
     protected:
 
         using modelBase<VIO, VI, indexed>::_dir;
 
-        texture _diffuse;
+        static std::string diffusePath(std::string_view name)
+        {
+            return std::string(_dir).append(name).append(".jpg");
+        }
+
+        std::shared_ptr<texture> _diffuse;
+
+        glm::mat4 _modelMatrix;
+
+        mutable meshfile::boundingVolume _worldBounds;
+
+        mutable bool _boundsDirty = true;
     };
 }
\ No newline at end of file
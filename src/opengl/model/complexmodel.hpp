@@ -2,23 +2,141 @@
 
 #include "modelbase.hpp"
 #include "basicmodel.hpp"
+#include <algorithm>
+#include <cstring>
+#include <map>
 
 namespace game::opengl
 {
     template<class VIO, typename VI>
     class complexModel : public basicModel<VIO, VI, true>
     {
+        using base = basicModel<VIO, VI, true>;
+
     public:
 
+        // Everything read from disk for the model, including the maps of the material table, see prepare()
+        struct loadData
+        {
+            typename base::loadData model;
+
+            texture::source specular;
+
+            std::vector<texture::source> maps;
+
+            // Index into maps of the diffuse and specular map of every material, -1 for the default maps of the model
+            std::vector<std::pair<int, int>> materialMaps;
+
+            size_t size() const
+            {
+                auto total = model.size() + specular.size();
+                for (const auto& m : maps)
+                    total += m.size();
+                return total;
+            }
+        };
+
+        // Reads and decodes the files of the model, does not need the OpenGL context
+        static loadData prepare(std::string_view name)
+        {
+            native::asyncReader::files none;
+            auto out = prepare(name, none);
+            prepareMaps(out, none);
+            return out;
+        }
+
+        // Files on disk that prepare(name, read) takes from memory, the maps of the material table follow from mapFiles()
+        static std::vector<std::string> files(std::string_view name)
+        {
+            auto out = base::files(name);
+            if (auto specular = texture::file(specularPath(name)); !specular.empty())
+                out.push_back(std::move(specular));
+            return out;
+        }
+
+        // The mesh and the default maps from files(name) already read, the material maps are added by prepareMaps()
+        static loadData prepare(std::string_view name, native::asyncReader::files& read)
+        {
+            return {base::prepare(name, read), texture::prepare(specularPath(name), read), {}, {}};
+        }
+
+        // Files of the material maps of a prepared mesh, every map once
+        static std::vector<std::string> mapFiles(const loadData& data)
+        {
+            std::vector<std::string> out;
+            for (const auto& m : data.model.mesh.mesh.materials) {
+                for (auto map : {m.diffuseMap, m.specularMap}) {
+                    auto length = strnlen(map, sizeof(meshfile::material::diffuseMap));
+                    auto file = length ? texture::file(std::string(_dir).append(map, length)) : std::string();
+                    if (!file.empty() && std::find(out.begin(), out.end(), file) == out.end())
+                        out.push_back(std::move(file));
+                }
+            }
+            return out;
+        }
+
+        // Adds the maps of the material table, taking the files of mapFiles() from read when they are there
+        static void prepareMaps(loadData& out, native::asyncReader::files& read)
+        {
+            // A map shared by several materials is loaded once
+            std::map<std::string, int> loaded;
+            auto load = [&](const char *map) {
+                std::string file(map, strnlen(map, sizeof(meshfile::material::diffuseMap)));
+                if (file.empty())
+                    return -1;
+
+                auto it = loaded.find(file);
+                if (it == loaded.end()) {
+                    out.maps.push_back(texture::prepare(std::string(_dir).append(file), read));
+                    it = loaded.emplace(file, static_cast<int>(out.maps.size()) - 1).first;
+                }
+                return it->second;
+            };
+
+            for (const auto& m : out.model.mesh.mesh.materials)
+                out.materialMaps.emplace_back(load(m.diffuseMap), load(m.specularMap));
+        }
+
         complexModel(std::string_view name)
-            : basicModel<VIO, VI, true>(name), _specular(std::string(_dir).append(name).append("_spec.jpg"))
+            : complexModel(prepare(name))
         {
         }
 
-        complexModel(const complexModel& rhs) = delete;
+        complexModel(loadData&& data)
+            : base(std::move(data.model)), _textures(std::make_shared<materialTextures>())
+        {
+            auto& t = *_textures;
+            t.specular = texture(data.specular);
+            for (const auto& m : data.maps)
+                t.maps.emplace_back(m);
+
+            for (size_t i = 0; i < materials().size(); ++i) {
+                auto [diffuse, specular] = data.materialMaps[i];
+                materialBinding binding;
+                binding.diffuse = diffuse < 0 ? GLuint(*_diffuse) : GLuint(t.maps[diffuse]);
+                binding.specular = specular < 0 ? GLuint(t.specular) : GLuint(t.maps[specular]);
+                const auto& m = materials()[i];
+                binding.material.diffuseColor = glm::vec3(m.diffuse[0], m.diffuse[1], m.diffuse[2]);
+                binding.material.specularColor = glm::vec3(m.specular[0], m.specular[1], m.specular[2]);
+                binding.material.shininess = m.shininess;
+                t.bindings.push_back(binding);
+            }
+        }
+
+        // Placeholder that draws nothing until setResources() gives it a loaded model
+        complexModel()
+            : _textures(std::make_shared<materialTextures>())
+        {
+        }
+
+        // Another instance of the same model, the mesh and textures are shared and the material is copied
+        complexModel(const complexModel& rhs)
+            : basicModel<VIO, VI, true>(rhs), material(rhs.material), _textures(rhs._textures)
+        {
+        }
 
         complexModel(complexModel&& rhs) noexcept
-            : basicModel<VIO, VI, true>(std::move(rhs)), material(std::move(rhs.material)), _specular(std::move(rhs._specular))
+            : basicModel<VIO, VI, true>(std::move(rhs)), material(std::move(rhs.material)), _textures(std::move(rhs._textures))
         {
         }
 
@@ -26,43 +144,74 @@ namespace game::opengl
         {
         }
 
+        // Shares the mesh and textures of a loaded model, the model matrix and material stay
+        void setResources(const complexModel& loaded)
+        {
+            base::setResources(loaded);
+            _textures = loaded._textures;
+        }
+
         void render()
         {
-            glBindTextureUnit(1, _specular);
-            basicModel<VIO, VI, true>::render();
+            render([](const Material&) {});
         }
 
+        /*
+         * Draws the model, for meshes with a material table the maps of every material are bound before its
+         * submeshes and updateMaterial(material) is called to upload its shading parameters.
+         */
+
+        template<class UpdateMaterial>
+        void render(UpdateMaterial&& updateMaterial)
+        {
+            glBindTextureUnit(1, _textures->specular);
+            basicModel<VIO, VI, true>::render([&](uint32_t index) {
+                const auto& binding = _textures->bindings[index];
+                glBindTextureUnit(0, binding.diffuse);
+                glBindTextureUnit(1, binding.specular);
+                updateMaterial(binding.material);
+            });
+        }
+
+        using basicModel<VIO, VI, true>::materials;
+
         struct Material
         {
             const GLint diffuse   = 0;
             const GLint specular  = 1;
             GLfloat shininess = 32.0f;
 
+            // Multiply the maps, the Kd and Ks colours of the mtl material
+            glm::vec3 diffuseColor = glm::vec3(1.0f);
+            glm::vec3 specularColor = glm::vec3(1.0f);
+
             Material()
             {
             }
 
             Material(const Material& rhs)
-                : shininess(rhs.shininess)
+                : shininess(rhs.shininess), diffuseColor(rhs.diffuseColor), specularColor(rhs.specularColor)
             {
             }
 
             Material(Material&& rhs) noexcept
             {
-                shininess = rhs.shininess;
-                rhs.shininess = 32.0f;
+                *this = std::move(rhs);
             }
 
             Material& operator=(const Material& rhs)
             {
                 shininess = rhs.shininess;
+                diffuseColor = rhs.diffuseColor;
+                specularColor = rhs.specularColor;
                 return *this;
             }
 
             Material& operator=(Material&& rhs) noexcept
             {
-                shininess = rhs.shininess;
+                *this = static_cast<const Material&>(rhs);
                 rhs.shininess = 32.0f;
+                rhs.diffuseColor = rhs.specularColor = glm::vec3(1.0f);
                 return *this;
             }
         } material;
@@ -71,6 +220,31 @@ namespace game::opengl
 
         using basicModel<VIO, VI, true>::_dir;
 
-        texture _specular;
+        using basicModel<VIO, VI, true>::_diffuse;
+
+        static std::string specularPath(std::string_view name)
+        {
+            return std::string(_dir).append(name).append("_spec.jpg");
+        }
+
+        struct materialBinding
+        {
+            GLuint diffuse, specular;
+
+            Material material;
+        };
+
+        // Shared by every instance of the model like the mesh
+        struct materialTextures
+        {
+            texture specular;
+
+            // Textures of the material table, the default maps of the model are used when a material has none
+            std::vector<texture> maps;
+
+            std::vector<materialBinding> bindings;
+        };
+
+        std::shared_ptr<materialTextures> _textures;
     };
 }
\ No newline at end of file
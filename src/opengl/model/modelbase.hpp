@@ -1,123 +1,547 @@
 #pragma once
 
 #include "application/mesh.hpp"
+#include "base/assetpack.hpp"
 #include "opengl/glbase.hpp"
 #include "opengl/buffer.hpp"
 #include "opengl/texture.hpp"
 #include "opengl/vertexinput.hpp"
+#include <memory>
+#include <utility>
 
 namespace game::opengl
 {
+    // Dequantization of packed vertex attributes, the identity for full precision ones
+    struct vertexDecode
+    {
+        glm::vec3 positionOffset = glm::vec3(0.0f), positionScale = glm::vec3(1.0f);
+
+        glm::vec2 texCoordOffset = glm::vec2(0.0f), texCoordScale = glm::vec2(1.0f);
+    };
+
+    // View frustum as six planes taken from a projection matrix (Gribb and Hartmann), in the space the matrix maps from
+    struct frustum
+    {
+        frustum(const glm::mat4& m)
+        {
+            glm::vec4 w(m[0][3], m[1][3], m[2][3], m[3][3]);
+            for (auto i = 0; i < 3; ++i) {
+                glm::vec4 row(m[0][i], m[1][i], m[2][i], m[3][i]);
+                planes[i*2] = w + row;
+                planes[i*2+1] = w - row;
+            }
+        }
+
+        bool visible(const glm::vec3& center, float radius) const
+        {
+            for (const auto& p : planes) {
+                if (glm::dot(glm::vec3(p), center) + p.w < -radius * glm::length(glm::vec3(p)))
+                    return false;
+            }
+            return true;
+        }
+
+        glm::vec4 planes[6];
+    };
+
     template<class VIO, typename VI, bool indexed>
     class modelBase
     {
         using bufferType = std::conditional_t<indexed, indexedBuffer, buffer>;
 
+    protected:
+
+        // Indexed draw of a single submesh, offset is in bytes
+        struct drawRange
+        {
+            GLsizei count;
+
+            GLsizeiptr offset;
+
+            GLint baseVertex;
+        };
+
+        struct lodLevel
+        {
+            std::vector<drawRange> ranges;
+
+            float error;
+        };
+
+        // Everything that comes from the mesh file, shared by every instance of the model
+        struct meshResources
+        {
+            VI elements = 0;
+
+            GLenum indexType = GL_UNSIGNED_INT;
+
+            std::vector<drawRange> ranges;
+
+            std::vector<uint32_t> rangeMaterials;   // Material of every entry of ranges, and of the lod ranges at the same position
+
+            std::vector<meshfile::material> materials;
+
+            std::vector<lodLevel> lods;
+
+            std::vector<meshfile::boundingVolume> bounds;
+
+            std::vector<meshfile::meshlet> meshlets;
+
+            std::vector<drawRange> meshletRanges;
+
+            vertexDecode decode;
+
+            VAO<VIO> vao;
+
+            std::unique_ptr<bufferType> buffer;
+        };
+
     public:
 
+        /*
+         * The mesh file with its vertices already in the layout of the VIO, prepared without the OpenGL context so a
+         * loader thread can read and convert it. vio holds the vertices when the file layout could not be used as it is.
+         */
+
+        struct meshData
+        {
+            // The file when it was read into memory instead of mapped, the mesh points into it
+            std::vector<char> file;
+
+            meshfile mesh;
+
+            std::vector<VIO> vio;
+
+            // Bytes the upload copies to the driver
+            size_t size() const
+            {
+                if constexpr (indexed) {
+                    auto indexSize = mesh.shortIndices ? sizeof(GLushort) : sizeof(GLuint);
+                    return mesh.head.dataCount * sizeof(VIO) + mesh.head.indexCount * indexSize;
+                }
+                else {
+                    return vio.size() * sizeof(VIO);
+                }
+            }
+        };
+
+        static std::string meshPath(std::string_view name)
+        {
+            return std::string(_dir).append(name).append(".msh");
+        }
+
+        static meshData prepare(std::string_view name)
+        {
+            meshData out;
+
+            // Map the mesh or use it in place in the asset pack, when its layout matches the VIO the buffers are
+            // created straight from that memory
+            auto path = meshPath(name);
+            auto packed = assetPack::lookup(path);
+            out.mesh = packed.data() ? meshfile(packed.data(), packed.size()) : meshfile(path, meshfile::loadMode::map);
+            convert(out);
+            return out;
+        }
+
+        // The same from a file that was already read, for instance by an asyncReader
+        static meshData prepare(std::vector<char>&& file)
+        {
+            meshData out;
+            out.file = std::move(file);
+            out.mesh = meshfile(out.file.data(), out.file.size());
+            convert(out);
+            return out;
+        }
+
         modelBase(std::string_view name)
-            : _vao()
+            : modelBase(prepare(name))
+        {
+        }
+
+        // Only creates the buffers and the VAO, everything else was done by prepare()
+        modelBase(meshData&& data)
+            : _mesh(std::make_shared<meshResources>())
         {
-            // Load the mesh 
-            meshfile mesh(std::string(_dir).append(name).append(".msh"));
+            auto& mesh = data.mesh;
+            auto& r = *_mesh;
 
-            // Convert the mesh into a suitable VIO (and VI)
             if constexpr (indexed) {
-                std::vector<VIO> vio;
-                std::vector<VI> vi;
-                void *cvio, *cvi;
+                const void *cvio, *cvi;
                 GLsizeiptr svio, svi;
 
                 if constexpr (meshfile::sameVIO<VIO>()) {
                     cvio = mesh.data;
                     svio = mesh.head.dataCount * sizeof(VIO);
                 }
+                else if constexpr (meshfile::samePackedVIO<VIO>()) {
+                    cvio = mesh.packed;
+                    svio = mesh.head.dataCount * sizeof(VIO);
+                }
                 else {
-                    mesh.toVertexInputObject(vio, true);
-                    cvio = vio.data();
-                    svio = vio.size() * sizeof(VIO);
+                    cvio = data.vio.data();
+                    svio = data.vio.size() * sizeof(VIO);
                 }
 
-                if constexpr(meshfile::sameVI<VI>()) {
-                    cvi = mesh.indices;
-                    svi = mesh.head.indexCount * sizeof(VI);
+                GLsizeiptr indexSize;
+                if (mesh.shortIndices) {
+                    cvi = mesh.shortIndices;
+                    indexSize = sizeof(GLushort);
+                    r.indexType = GL_UNSIGNED_SHORT;
                 }
                 else {
-                    mesh.toVertexIndex(vi);
-                    cvi = vi.data();
-                    svi = vi.size() * sizeof(VI);
+                    cvi = mesh.indices;
+                    indexSize = sizeof(GLuint);
+                    r.indexType = GL_UNSIGNED_INT;
+                }
+                svi = mesh.head.indexCount * indexSize;
+
+                auto ranges = mesh.ranges();
+                for (const auto& range : ranges) {
+                    r.ranges.push_back({static_cast<GLsizei>(range.indexCount), static_cast<GLsizeiptr>(range.indexOffset)*indexSize,
+                        static_cast<GLint>(range.baseVertex)});
+                    r.rangeMaterials.push_back(range.material);
+                }
+                r.materials = std::move(mesh.materials);
+
+                // The lod table holds every level after the full detail one, one entry per submesh
+                for (size_t i = 0; i < mesh.lods.size(); ++i) {
+                    const auto& l = mesh.lods[i];
+                    if (i % ranges.size() == 0)
+                        r.lods.push_back({{}, 0.0f});
+                    r.lods.back().ranges.push_back({static_cast<GLsizei>(l.indexCount), static_cast<GLsizeiptr>(l.indexOffset)*indexSize,
+                        static_cast<GLint>(ranges[l.submesh].baseVertex)});
+                    r.lods.back().error = std::max(r.lods.back().error, l.error);
+                }
+                for (const auto& m : mesh.meshlets) {
+                    r.meshletRanges.push_back({static_cast<GLsizei>(m.indexCount), static_cast<GLsizeiptr>(m.indexOffset)*indexSize,
+                        static_cast<GLint>(ranges[m.submesh].baseVertex)});
                 }
+                r.meshlets = std::move(mesh.meshlets);
 
-                _elements = mesh.head.indexCount;
-                _buffer = new indexedBuffer(cvio, svio, cvi, svi);
+                r.buffer = std::make_unique<indexedBuffer>(cvio, svio, cvi, svi);
             }
             else {
-                std::vector<VIO> vio;
-                mesh.toVertexInputObject(vio, false);
-                _elements = mesh.head.indexCount;
-                _buffer = new buffer(vio.data(), vio.size()*sizeof(VIO));
+                r.elements = mesh.head.indexCount;
+                r.buffer = std::make_unique<buffer>(data.vio.data(), data.vio.size()*sizeof(VIO));
             }
 
-            _vao.bind(*_buffer);
+            r.bounds = std::move(mesh.bounds);
+
+            // Packing happened in prepare() at the latest, so the layout holds the bounds of the packed attributes
+            if constexpr (VIO::positionFormat::file == meshfile::attribFormat::unorm16x3) {
+                r.decode.positionOffset = glm::vec3(mesh.layout.positionOffset[0], mesh.layout.positionOffset[1], mesh.layout.positionOffset[2]);
+                r.decode.positionScale = glm::vec3(mesh.layout.positionScale[0], mesh.layout.positionScale[1], mesh.layout.positionScale[2]);
+            }
+            if constexpr (VIO::texCoordFormat::file == meshfile::attribFormat::unorm16x2) {
+                r.decode.texCoordOffset = glm::vec2(mesh.layout.texcoordOffset[0], mesh.layout.texcoordOffset[1]);
+                r.decode.texCoordScale = glm::vec2(mesh.layout.texcoordScale[0], mesh.layout.texcoordScale[1]);
+            }
+
+            r.vao.bind(*r.buffer);
+        }
+
+        // A model without a mesh draws nothing, its bounds are an empty sphere at the origin
+        modelBase()
+            : _mesh(std::make_shared<meshResources>())
+        {
+            _mesh->bounds.resize(1);
         }
 
         modelBase(void *cvio, VI viocount, void *cvi = nullptr, VI vicount = 0)
+            : _mesh(std::make_shared<meshResources>())
         {
+            auto& r = *_mesh;
+
+            // Quantized vertices come without their decode information, so only full precision ones get bounds
+            if constexpr (VIO::positionFormat::file == meshfile::attribFormat::float3) {
+                r.bounds.push_back(meshfile::boundsOf(viocount, [cvio](size_t i) {
+                    return static_cast<const VIO*>(cvio)[i].inputPosition;
+                }));
+            }
+            else {
+                r.bounds.push_back({});
+            }
+
             if constexpr (indexed) {
-                _elements = vicount;
-                _buffer = new indexedBuffer(cvio, viocount*sizeof(VIO), cvi, vicount*sizeof(VI));
+                r.indexType = indexType();
+                r.ranges.push_back({static_cast<GLsizei>(vicount), 0, 0});
+                r.rangeMaterials.push_back(0);
+                r.buffer = std::make_unique<indexedBuffer>(cvio, viocount*sizeof(VIO), cvi, vicount*sizeof(VI));
             }
             else {
-                _elements = viocount;
-                _buffer = new buffer(cvio, viocount*sizeof(VIO));
+                r.elements = viocount;
+                r.buffer = std::make_unique<buffer>(cvio, viocount*sizeof(VIO));
             }
         }
 
-        modelBase(const modelBase& rhs) = delete;
+        // Another instance of the same mesh, the buffers and the VAO are shared
+        modelBase(const modelBase& rhs)
+            : _mesh(rhs._mesh)
+        {
+        }
 
         modelBase(modelBase&& rhs) noexcept
-            : _vao(std::move(rhs._vao))
+            : _mesh(std::move(rhs._mesh)), _lod(rhs._lod)
         {
-            _elements = rhs._elements;
-            rhs._elements = 0;
-            _buffer = rhs._buffer;
-            rhs._buffer = nullptr;
+        }
+
+        // Draws the mesh of rhs from now on, the level of detail starts at full detail again
+        modelBase& operator=(const modelBase& rhs)
+        {
+            _mesh = rhs._mesh;
+            _lod = 0;
+            _subset = false;
+            return *this;
         }
 
         ~modelBase()
         {
-            delete _buffer;
         }
 
         void render()
         {
-            glBindVertexArray(_vao);
+            render([](uint32_t) {});
+        }
+
+        /*
+         * Draws every submesh from the single VAO. When the mesh has a material table, bindMaterial(index) is
+         * called before the draws of each run of submeshes that share a material.
+         */
+
+        template<class BindMaterial>
+        void render(BindMaterial&& bindMaterial)
+        {
+            auto& r = *_mesh;
+            glBindVertexArray(r.vao);
             
             if constexpr (indexed) {
-                if constexpr (std::is_same_v<VI, GLuint>)
-                    glDrawElements(GL_TRIANGLES, _elements, GL_UNSIGNED_INT, nullptr);
-                else if constexpr (std::is_same_v<VI, GLshort>)
-                    glDrawElements(GL_TRIANGLES, _elements, GL_UNSIGNED_SHORT, nullptr);
-                else if constexpr (std::is_same_v<VI, GLubyte>)
-                    glDrawElements(GL_TRIANGLES, _elements, GL_UNSIGNED_BYTE, nullptr);
-                
-                static_assert(std::is_same_v<VI, GLuint> || std::is_same_v<VI, GLshort> || std::is_same_v<VI, GLubyte>, "Illegal index type");
+                auto bound = ~uint32_t(0);
+                auto use = [&](uint32_t material) {
+                    if (!r.materials.empty() && material != bound) {
+                        bindMaterial(material);
+                        bound = material;
+                    }
+                };
+
+                // The selection only lasts one render(), also when a simplified level is drawn instead
+                if (std::exchange(_subset, false) && _lod == 0) {
+                    for (size_t first = 0, last; first < _drawCounts.size(); first = last) {
+                        auto material = r.rangeMaterials[_drawSubmeshes[first]];
+                        for (last = first+1; last < _drawCounts.size() && r.rangeMaterials[_drawSubmeshes[last]] == material; ++last);
+
+                        use(material);
+                        glMultiDrawElementsBaseVertex(GL_TRIANGLES, _drawCounts.data() + first, r.indexType, _drawOffsets.data() + first,
+                            static_cast<GLsizei>(last - first), _drawBaseVertices.data() + first);
+                    }
+                    return;
+                }
+
+                const auto& ranges = _lod ? r.lods[_lod-1].ranges : r.ranges;
+                for (size_t i = 0; i < ranges.size(); ++i) {
+                    const auto& range = ranges[i];
+                    use(r.rangeMaterials[i]);
+                    glDrawElementsBaseVertex(GL_TRIANGLES, range.count, r.indexType, reinterpret_cast<const void*>(range.offset), range.baseVertex);
+                }
             }
             else {
-                glDrawArrays(GL_TRIANGLES, 0, _elements);
+                glDrawArrays(GL_TRIANGLES, 0, r.elements);
             }
         }
 
+        const vertexDecode& decode() const
+        {
+            return _mesh->decode;
+        }
+
+        // Number of levels of detail, level 0 is the full mesh
+        size_t lodCount() const
+        {
+            return 1 + _mesh->lods.size();
+        }
+
+        // RMS quadric error of a level, the square root of the mean quadric collapse cost, largest of its submeshes
+        float lodError(size_t level) const
+        {
+            return level ? _mesh->lods[level-1].error : 0.0f;
+        }
+
+        size_t lod() const
+        {
+            return _lod;
+        }
+
+        void setLod(size_t level)
+        {
+            _lod = std::min(level, _mesh->lods.size());
+        }
+
+        /*
+         * Picks the coarsest level whose error, projected at the distance of the mesh center, is at most threshold.
+         * projection is the vertical scale of the projection matrix (proj[1][1]), threshold is in normalized
+         * device coordinates, so 2/height is a pixel.
+         */
+
+        void selectLod(const glm::mat4& modelView, float projection, float threshold)
+        {
+            const auto& lods = _mesh->lods;
+            if (lods.empty())
+                return;
+
+            auto scale = std::max({glm::length(glm::vec3(modelView[0])), glm::length(glm::vec3(modelView[1])), glm::length(glm::vec3(modelView[2]))});
+            auto distance = glm::length(glm::vec3(modelView * glm::vec4(bounds().center, 1.0f)));
+            auto projected = scale * projection / std::max(distance, 1e-6f);
+
+            _lod = 0;
+            while (_lod < lods.size() && lods[_lod].error * projected <= threshold)
+                ++_lod;
+        }
+
+        const std::vector<meshfile::meshlet>& meshlets() const
+        {
+            return _mesh->meshlets;
+        }
+
+        // Materials referenced by the submeshes, empty when the mesh has no material table
+        const std::vector<meshfile::material>& materials() const
+        {
+            return _mesh->materials;
+        }
+
+        // Object space bounds of the whole mesh
+        const meshfile::boundingVolume& bounds() const
+        {
+            return _mesh->bounds.front();
+        }
+
+        // Object space bounds of each submesh, empty when the mesh is a single range
+        std::vector<meshfile::boundingVolume> submeshBounds() const
+        {
+            return std::vector<meshfile::boundingVolume>(_mesh->bounds.begin() + 1, _mesh->bounds.end());
+        }
+
+        /*
+         * Makes the next render() draw only the given clusters, when the full detail level is selected. Clusters
+         * that follow each other in the index buffer are merged into one range of the multi-draw.
+         */
+
+        void selectMeshlets(const uint32_t *clusters, size_t count)
+        {
+            const auto& r = *_mesh;
+            _drawCounts.clear();
+            _drawOffsets.clear();
+            _drawBaseVertices.clear();
+            _drawSubmeshes.clear();
+
+            GLsizeiptr end = -1;
+            for (size_t i = 0; i < count; ++i) {
+                const auto& range = r.meshletRanges[clusters[i]];
+                auto submesh = r.meshlets[clusters[i]].submesh;
+                if (range.offset == end && submesh == _drawSubmeshes.back()) {
+                    _drawCounts.back() += range.count;
+                }
+                else {
+                    _drawCounts.push_back(range.count);
+                    _drawOffsets.push_back(reinterpret_cast<const void*>(range.offset));
+                    _drawBaseVertices.push_back(range.baseVertex);
+                    _drawSubmeshes.push_back(submesh);
+                }
+                end = range.offset + range.count * (r.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint));
+            }
+            _subset = true;
+        }
+
+        /*
+         * Culls the clusters against the view frustum and their normal cones and selects the rest for the next
+         * render(). Does nothing when the mesh has no clusters or a simplified level is selected. Returns the
+         * number of visible clusters.
+         */
+
+        size_t cullMeshlets(const glm::mat4& mvp, const glm::mat4& modelView)
+        {
+            const auto& meshlets = _mesh->meshlets;
+            // A selection made before the level changed must not be drawn once full detail is back
+            if (meshlets.empty() || _lod != 0) {
+                _subset = false;
+                return 0;
+            }
+
+            // The frustum and the camera position in object space
+            frustum planes(mvp);
+            auto camera = glm::vec3(glm::inverse(modelView)[3]);
+
+            _visible.clear();
+            for (uint32_t c = 0; c < meshlets.size(); ++c) {
+                const auto& m = meshlets[c];
+                auto view = m.center - camera;
+                auto backfacing = glm::dot(view, m.coneAxis) >= m.coneCutoff * glm::length(view) + m.radius;
+
+                if (!backfacing && planes.visible(m.center, m.radius))
+                    _visible.push_back(c);
+            }
+
+            selectMeshlets(_visible.data(), _visible.size());
+            return _visible.size();
+        }
+
     protected:
 
-        VI _elements;
+        // Index type of VI, only used for meshes that are not loaded from a file
+        static constexpr GLenum indexType()
+        {
+            static_assert(std::is_same_v<VI, GLuint> || std::is_same_v<VI, GLushort> || std::is_same_v<VI, GLubyte>, "Illegal index type");
 
-        VAO<VIO> _vao;
+            if constexpr (std::is_same_v<VI, GLuint>)
+                return GL_UNSIGNED_INT;
+            else if constexpr (std::is_same_v<VI, GLushort>)
+                return GL_UNSIGNED_SHORT;
+            else
+                return GL_UNSIGNED_BYTE;
+        }
 
-        static constexpr std::string_view _dir = "data/models/";
+        // Brings the vertices into the layout of the VIO, see prepare()
+        static void convert(meshData& out)
+        {
+            auto& mesh = out.mesh;
+
+            // Convert the mesh into a suitable VIO
+            if constexpr (indexed) {
+                if constexpr (meshfile::sameVIO<VIO>())
+                    mesh.unpack();
+                else if constexpr (meshfile::samePackedVIO<VIO>())
+                    mesh.pack();
+                else
+                    mesh.toVertexInputObject(out.vio, true);
+
+                // The index width is picked per mesh, 16 bit whenever every submesh fits
+                mesh.narrowIndices();
+            }
+            else {
+                mesh.toVertexInputObject(out.vio, false);
+            }
 
-    private:
+            // Files written before the bounds section get theirs computed here
+            if (mesh.bounds.empty())
+                mesh.computeBounds();
+        }
+
+        std::shared_ptr<meshResources> _mesh;
+
+        // Everything below belongs to this instance
+        size_t _lod = 0;
+
+        // Multi-draw arguments of the selected clusters, only used by the next render()
+        std::vector<GLsizei> _drawCounts;
+
+        std::vector<const void*> _drawOffsets;
 
-        bufferType *_buffer = nullptr;
+        std::vector<GLint> _drawBaseVertices;
+
+        std::vector<uint32_t> _drawSubmeshes;
+
+        std::vector<uint32_t> _visible;
+
+        bool _subset = false;
+
+        static constexpr std::string_view _dir = "data/models/";
     };
 }
\ No newline at end of file
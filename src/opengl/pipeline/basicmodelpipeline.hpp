@@ -32,9 +32,17 @@ namespace game::opengl
         void render(const glm::mat4& proj, const glm::mat4& view) override
         {
             glUseProgram(_program);
+            frustum world(proj * view);
 
 			for (auto&[id, m] : _models) {
-                auto mvp = proj * view * m.modelMatrix;
+                const auto& b = m.worldBounds();
+                if (!world.visible(b.center, b.radius))
+                    continue;
+
+                auto modelView = view * m.modelMatrix();
+                auto mvp = proj * modelView;
+                m.selectLod(modelView, proj[1][1], base::lodThreshold);
+                m.cullMeshlets(mvp, modelView);
                 _program.updateUbo(mvp, 0);
                 m.render();
             }
@@ -18,6 +18,11 @@ namespace game::opengl
         {
         }
 
+        complexModelPipeline(std::string_view vertexName, std::string_view fragmentName)
+            : base(), _program(vertexName, fragmentName)
+        {
+        }
+
         complexModelPipeline(const complexModelPipeline& rhs) = delete;
 
         complexModelPipeline(complexModelPipeline&& rhs)
@@ -32,12 +37,24 @@ namespace game::opengl
         void render(const glm::mat4& proj, const glm::mat4& view) override
         {
             glUseProgram(_program);
+            frustum world(proj * view);
 
 			for (auto& [id, m] : _models) {
-                auto viewSpace = view * m.modelMatrix;
+                const auto& b = m.worldBounds();
+                if (!world.visible(b.center, b.radius))
+                    continue;
+
+                auto viewSpace = view * m.modelMatrix();
                 auto mvp = proj * viewSpace;
-                _program.updateUbo(mvp, viewSpace, ambient, m.material, light);
-                m.render();
+                m.selectLod(viewSpace, proj[1][1], base::lodThreshold);
+                m.cullMeshlets(mvp, viewSpace);
+                if constexpr (UBO::DecodeTrait)
+                    _program.updateUbo(mvp, viewSpace, ambient, m.material, light, m.decode());
+                else
+                    _program.updateUbo(mvp, viewSpace, ambient, m.material, light);
+                m.render([this](const auto& material) {
+                    _program.template updateUboElement<5>(material);
+                });
             }
         }
 
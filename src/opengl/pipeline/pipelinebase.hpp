@@ -3,7 +3,15 @@
 #include "opengl/glbase.hpp"
 #include "opengl/vertexinput.hpp"
 #include "opengl/uniform.hpp"
+#include "base/assetpack.hpp"
+#include "base/asyncio.hpp"
+#include "base/jobqueue.hpp"
+#include <algorithm>
+#include <chrono>
+#include <list>
 #include <map>
+#include <string>
+#include <vector>
 
 namespace game::opengl
 {
@@ -18,6 +26,49 @@ namespace game::opengl
         virtual void render(const glm::mat4& proj, const glm::mat4& view) = 0;
     };
 
+    /*
+     * Limits how much of the loaded data is uploaded in one frame. The first upload of a frame always goes ahead, so
+     * a model larger than the budget still finishes, in a frame of its own.
+     */
+
+    class uploadBudget
+    {
+    public:
+
+        uploadBudget(size_t bytes, double seconds)
+            : _bytes(bytes), _seconds(seconds), _start(std::chrono::steady_clock::now())
+        {
+        }
+
+        bool available() const
+        {
+            return _uploads == 0 || (_spent < _bytes && std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count() < _seconds);
+        }
+
+        template<class Upload>
+        void spend(size_t bytes, Upload&& upload)
+        {
+            upload();
+            _spent += bytes;
+            ++_uploads;
+        }
+
+    private:
+
+        size_t _bytes, _spent = 0, _uploads = 0;
+
+        double _seconds;
+
+        std::chrono::steady_clock::time_point _start;
+    };
+
+	/*
+	 * Owns the models of a pipeline. Models are loaded once per name and kept in a cache, every id is an instance
+	 * that shares the buffers, VAO and textures of the cached model and only has its own model matrix and material.
+	 * Cached models no instance uses any more stay loaded until they exceed cacheBytes, the least recently used go
+	 * first.
+	 */
+
 	template<class Model>
 	class modelPipelineBase : pipelineBase
 	{
@@ -32,7 +83,8 @@ namespace game::opengl
 		modelPipelineBase(const modelPipelineBase& rhs) = delete;
 
 		modelPipelineBase(modelPipelineBase&& rhs) noexcept
-			: _models(std::move(rhs._models)), _idgen(rhs._idgen)
+			: lodThreshold(rhs.lodThreshold), cacheBytes(rhs.cacheBytes), _models(std::move(rhs._models)), _names(std::move(rhs._names)),
+			  _cache(std::move(rhs._cache)), _loads(std::move(rhs._loads)), _idgen(rhs._idgen), _clock(rhs._clock)
 		{
 			rhs._idgen = 0;
 		}
@@ -44,25 +96,158 @@ namespace game::opengl
 		idtype loadModel(std::string_view name)
 		{
 			auto id = _idgen++;
-			auto modelObject = Model(name);
+			const auto& entry = acquire(name);
 
-			_models.emplace(std::pair<idtype, Model>(id, std::move(modelObject)));
+			_models.emplace(std::pair<idtype, Model>(id, Model(entry.model)));
+			_names.emplace(id, std::string(name));
+			return id;
+		}
+
+		/*
+		 * Returns at once with a model that draws nothing. Its mesh and texture files are read by the reader, together
+		 * with the other reads submitted in the same frame, and decoded by the jobs. The model matrix and material can be set
+		 * right away, finishLoads() creates the buffers and textures later. A model that is cached or already being
+		 * loaded is not read again.
+		 */
+
+		idtype loadModelAsync(std::string_view name, jobQueue& jobs, native::asyncReader& reader)
+		{
+			auto id = _idgen++;
+			std::string file(name);
+			_names.emplace(id, file);
+
+			if (auto it = _cache.find(file); it != _cache.end()) {
+				use(it->second);
+				_models.emplace(std::pair<idtype, Model>(id, Model(it->second.model)));
+				return id;
+			}
+
+			_models.emplace(std::pair<idtype, Model>(id, Model()));
+			auto load = std::find_if(_loads.begin(), _loads.end(), [&file](const pendingLoad& l) { return l.name == file; });
+			if (load != _loads.end()) {
+				load->ids.push_back(id);
+			}
+			else {
+				auto promise = std::make_shared<std::promise<typename Model::loadData>>();
+				_loads.push_back({file, {id}, promise->get_future()});
+				reader.read(Model::files(file), [promise, file, &jobs, &reader](native::asyncReader::files&& read) {
+					jobs.submit([promise, file, &jobs, &reader, read = std::move(read)]() mutable {
+						try {
+							// The material maps are named in the mesh, so they are read once it is decoded
+							auto data = std::make_shared<typename Model::loadData>(Model::prepare(file, read));
+							auto maps = Model::mapFiles(*data);
+							if (maps.empty()) {
+								promise->set_value(std::move(*data));
+								return;
+							}
+							reader.read(maps, [promise, data, &jobs](native::asyncReader::files&& read) {
+								jobs.submit([promise, data, read = std::move(read)]() mutable {
+									try {
+										Model::prepareMaps(*data, read);
+										promise->set_value(std::move(*data));
+									}
+									catch (...) {
+										promise->set_exception(std::current_exception());
+									}
+								});
+							});
+						}
+						catch (...) {
+							promise->set_exception(std::current_exception());
+						}
+					});
+				});
+			}
 			return id;
 		}
 
+		// Uploads the loads that are done, in any order, as long as the budget allows. Errors of a load are thrown here
+		void finishLoads(uploadBudget& budget)
+		{
+			for (auto it = _loads.begin(); it != _loads.end() && budget.available(); ) {
+				if (it->data.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+					++it;
+					continue;
+				}
+
+				auto load = std::move(*it);
+				it = _loads.erase(it);
+
+				// The instances of a failed load stay placeholders that belong to no cache entry
+				typename Model::loadData data;
+				try {
+					data = load.data.get();
+				}
+				catch (...) {
+					for (auto id : load.ids)
+						_names.erase(id);
+					throw;
+				}
+				auto bytes = data.size();
+				budget.spend(bytes, [&]() {
+					// loadModel() may have loaded the same model in the meantime
+					auto cached = _cache.find(load.name);
+					if (cached == _cache.end())
+						cached = _cache.emplace(load.name, cacheEntry{Model(std::move(data)), bytes}).first;
+
+					auto& entry = cached->second;
+					for (auto id : load.ids) {
+						if (auto model = _models.find(id); model != _models.end()) {
+							model->second.setResources(entry.model);
+							use(entry);
+						}
+					}
+				});
+			}
+			evict();
+		}
+
+		bool ready(idtype id) const
+		{
+			return std::none_of(_loads.begin(), _loads.end(), [id](const pendingLoad& l) {
+				return std::find(l.ids.begin(), l.ids.end(), id) != l.ids.end();
+			});
+		}
+
+		bool loading() const
+		{
+			return !_loads.empty();
+		}
+
 		void replaceModel(idtype id, std::string_view name)
 		{
-			auto modelObject = Model(name);
+			const auto& entry = acquire(name);
+			auto modelObject = Model(entry.model);
 			auto it = _models.find(id);
 			
+			release(id);
 			_models.erase(it);
 			_models.emplace(std::pair<idtype, Model>(id, std::move(modelObject)));
+			_names.emplace(id, std::string(name));
+			evict();
 		}
 
 		void removeModel(idtype id)
 		{
 			auto it = _models.find(id);
+			release(id);
 			_models.erase(it);
+			evict();
+		}
+
+		// Error a level of detail may show on screen in normalized device coordinates, about a pixel at 1080p
+		float lodThreshold = 2.0f / 1080.0f;
+
+		// Bytes of cached models without instances that are kept for later loads
+		size_t cacheBytes = 256 << 20;
+
+		// Bytes uploaded for every cached model, whether it has instances or not
+		size_t cachedBytes() const
+		{
+			size_t total = 0;
+			for (const auto& [name, entry] : _cache)
+				total += entry.bytes;
+			return total;
 		}
 
 		Model * getInternalObjectPtr(idtype id)
@@ -79,8 +264,100 @@ namespace game::opengl
 
 	protected:
 
+		struct cacheEntry
+		{
+			Model model;
+
+			size_t bytes;
+
+			size_t instances = 0;
+
+			uint64_t lastUse = 0;
+		};
+
+		void use(cacheEntry& entry)
+		{
+			++entry.instances;
+			entry.lastUse = ++_clock;
+		}
+
+		// The cached model with the given name, loaded here when it is not cached yet
+		cacheEntry& acquire(std::string_view name)
+		{
+			std::string file(name);
+			auto it = _cache.find(file);
+			if (it == _cache.end()) {
+				auto data = Model::prepare(name);
+				auto bytes = data.size();
+				it = _cache.emplace(file, cacheEntry{Model(std::move(data)), bytes}).first;
+			}
+			use(it->second);
+			return it->second;
+		}
+
+		// Drops the instance from the cache entry or the pending load of its model, the job of a load keeps running
+		void release(idtype id)
+		{
+			auto name = _names.find(id);
+			if (name == _names.end())
+				return;
+
+			// An instance waiting for its load does not count for the cache entry, loadModel() may have cached the
+			// same name in the meantime
+			auto pending = std::find_if(_loads.begin(), _loads.end(), [id](const pendingLoad& l) {
+				return std::find(l.ids.begin(), l.ids.end(), id) != l.ids.end();
+			});
+			if (pending != _loads.end()) {
+				pending->ids.erase(std::remove(pending->ids.begin(), pending->ids.end(), id), pending->ids.end());
+				if (pending->ids.empty())
+					_loads.erase(pending);
+			}
+			else if (auto it = _cache.find(name->second); it != _cache.end()) {
+				--it->second.instances;
+			}
+			_names.erase(name);
+		}
+
+		// Frees unused models, least recently used first, until the unused ones fit in cacheBytes
+		void evict()
+		{
+			size_t unused = 0;
+			for (const auto& [name, entry] : _cache) {
+				if (entry.instances == 0)
+					unused += entry.bytes;
+			}
+
+			while (unused > cacheBytes) {
+				auto oldest = _cache.end();
+				for (auto it = _cache.begin(); it != _cache.end(); ++it) {
+					if (it->second.instances == 0 && (oldest == _cache.end() || it->second.lastUse < oldest->second.lastUse))
+						oldest = it;
+				}
+				unused -= oldest->second.bytes;
+				_cache.erase(oldest);
+			}
+		}
+
+		struct pendingLoad
+		{
+			std::string name;
+
+			// Instances that get the model once it is uploaded
+			std::vector<idtype> ids;
+
+			std::future<typename Model::loadData> data;
+		};
+
 		std::map<idtype, Model> _models;
 
+		std::map<idtype, std::string> _names;
+
+		std::map<std::string, cacheEntry> _cache;
+
+		std::list<pendingLoad> _loads;
+
 		idtype _idgen = 0;
+
+		uint64_t _clock = 0;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "glbase.hpp"
+#include "base/assetpack.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace game::opengl
+{
+    /*
+     * Linked programs saved with glGetProgramBinary, so later starts skip compiling and linking. A binary is only
+     * valid for the driver that produced it, so the key hashes the sources together with the vendor, renderer and
+     * version strings. Drivers may still reject a binary after an update, the program is then compiled and the
+     * file replaced.
+     */
+
+    class programCache
+    {
+    public:
+
+        struct statistics
+        {
+            unsigned loaded = 0, compiled = 0, rejected = 0;
+
+            // Time spent creating programs, from reading the sources to a linked program
+            double seconds = 0.0;
+        };
+
+        static uint64_t key(std::string_view vertexSource, std::string_view fragmentSource)
+        {
+            std::string text(driver());
+            text.append(1, '\0').append(vertexSource).append(1, '\0').append(fragmentSource);
+            return assetPack::hash(text);
+        }
+
+        // Links program from the saved binary, false when there is none or the driver rejects it
+        static bool load(GLuint program, uint64_t key)
+        {
+            if (!enabled())
+                return false;
+
+            std::ifstream in(path(key), std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+            if (!in.is_open())
+                return false;
+
+            auto size = static_cast<size_t>(in.tellg());
+            header head;
+            if (size < sizeof(head))
+                return false;
+
+            in.seekg(0, std::ifstream::beg);
+            in.read(reinterpret_cast<char*>(&head), sizeof(head));
+            std::vector<char> binary(size - sizeof(head));
+            in.read(binary.data(), binary.size());
+            if (!in || std::memcmp(head.magic, magic, sizeof(magic)) != 0 || head.key != key || head.length != binary.size())
+                return false;
+
+            glProgramBinary(program, head.format, binary.data(), static_cast<GLsizei>(binary.size()));
+            GLint status;
+            glGetProgramiv(program, GL_LINK_STATUS, &status);
+            if (status == GL_FALSE) {
+                ++stats().rejected;
+                std::remove(path(key).c_str());
+                return false;
+            }
+            ++stats().loaded;
+            return true;
+        }
+
+        // Saves the binary of a linked program, failing to write the cache is not an error
+        static void store(GLuint program, uint64_t key)
+        {
+            if (!enabled())
+                return;
+
+            GLint length = 0;
+            glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+            if (length <= 0)
+                return;
+
+            header head = {};
+            std::memcpy(head.magic, magic, sizeof(magic));
+            head.key = key;
+            std::vector<char> binary(length);
+            glGetProgramBinary(program, length, &length, &head.format, binary.data());
+            head.length = static_cast<uint32_t>(length);
+
+            // Written next to the final name and renamed, so a crash never leaves half a binary behind
+            std::error_code ec;
+            std::filesystem::create_directories(directory, ec);
+            auto file = path(key), temporary = file + ".tmp";
+            {
+                std::ofstream out(temporary, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+                out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+                out.write(binary.data(), head.length);
+                if (!out)
+                    return;
+            }
+            std::filesystem::rename(temporary, file, ec);
+        }
+
+        static statistics& stats()
+        {
+            static statistics s;
+            return s;
+        }
+
+        static constexpr auto directory = "./cache/programs/";
+
+    private:
+
+        struct header
+        {
+            char magic[4];
+
+            GLenum format;
+
+            uint64_t key;
+
+            uint32_t length, reserved;
+        };
+
+        static constexpr char magic[4] = {'P', 'R', 'G', '\0'};
+
+        static std::string path(uint64_t key)
+        {
+            char name[32];
+            std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+            return std::string(directory).append(name);
+        }
+
+        static const std::string& driver()
+        {
+            static std::string text = [] {
+                std::string out;
+                for (auto name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+                    auto s = reinterpret_cast<const char*>(glGetString(name));
+                    out.append(s ? s : "").append(1, '\n');
+                }
+                return out;
+            }();
+            return text;
+        }
+
+        // Drivers without a single binary format can not save programs
+        static bool enabled()
+        {
+            static bool supported = [] {
+                GLint formats = 0;
+                glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+                return formats > 0;
+            }();
+            return supported;
+        }
+    };
+}
\ No newline at end of file
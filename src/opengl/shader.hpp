@@ -1,6 +1,9 @@
 #pragma once
 
 #include "glbase.hpp"
+#include "programcache.hpp"
+#include "base/assetpack.hpp"
+#include <chrono>
 #include <string>
 #include <fstream>
 #include <iostream>
@@ -23,47 +26,62 @@ namespace game::opengl
             return _shader;
         }
 
-        shader(std::string_view shader, GLenum type)
+        shader(std::string_view name, GLenum type)
         {
             std::string buffer;
+            compile(type, source(name, buffer));
+        }
 
-            auto readFile = [&](std::string_view name) {
-                std::ifstream file(name.data(), std::ifstream::in | std::ifstream::ate);
-                auto len = file.tellg();
-                file.seekg(0, std::ifstream::beg);
-                buffer.resize(len);
-                file.read(buffer.data(), len);
-                file.close();
-                return len;
-            };
-
-            auto checkShaderError = [&]() {
-                GLint status;
-                glGetShaderiv(_shader, GL_COMPILE_STATUS, &status);
-                if (status == GL_FALSE) {
-                    if (debug) {
-                        glGetShaderiv(_shader, GL_INFO_LOG_LENGTH, &status);
-                        buffer.resize(status);
-                        glGetShaderInfoLog(_shader, status, nullptr, buffer.data());
-                        std::cerr << buffer;
-                    }
-                    throw exception(except_e::GRAPHICS_BASE, "glCompileShader");
-                }
-            };
-
-            auto compileShader = [&](GLuint &binding, std::string_view name) {
-                binding = glCreateShader(type); 
-				if (binding == 0)
-					throw exception(except_e::GRAPHICS_BASE, "glCreateShader");
-                auto len = static_cast<GLint>(readFile(name));
-                auto ptr = buffer.c_str();
-                glShaderSource(binding, 1, &ptr, &len);
-                glCompileShader(binding);
-                checkShaderError();
-            };
+        // Compiled later with compile(), or never when the program came from the binary cache
+        shader()
+        {
+        }
 
+        /*
+         * The text of a shader in ./shaders/. Sources in the asset pack are returned without a copy, others are read
+         * into buffer.
+         */
+
+        static std::string_view source(std::string_view name, std::string& buffer)
+        {
             constexpr auto folder = "./shaders/";
-            compileShader(_shader, std::string(folder).append(shader));
+            auto path = std::string(folder).append(name);
+            if (auto packed = assetPack::lookup(path); packed.data())
+                return packed;
+
+            std::ifstream file(path, std::ifstream::in | std::ifstream::ate);
+            if (!file.is_open())
+                throw exception(except_e::GRAPHICS_BASE, "unable to open shader");
+            auto len = file.tellg();
+            file.seekg(0, std::ifstream::beg);
+            buffer.resize(len);
+            file.read(buffer.data(), len);
+            return buffer;
+        }
+
+        void compile(GLenum type, std::string_view text)
+        {
+            _shader = glCreateShader(type);
+            if (_shader == 0)
+                throw exception(except_e::GRAPHICS_BASE, "glCreateShader");
+
+            auto ptr = text.data();
+            auto len = static_cast<GLint>(text.size());
+            glShaderSource(_shader, 1, &ptr, &len);
+            glCompileShader(_shader);
+
+            GLint status;
+            glGetShaderiv(_shader, GL_COMPILE_STATUS, &status);
+            if (status == GL_FALSE) {
+                if (debug) {
+                    std::string log;
+                    glGetShaderiv(_shader, GL_INFO_LOG_LENGTH, &status);
+                    log.resize(status);
+                    glGetShaderInfoLog(_shader, status, nullptr, log.data());
+                    std::cerr << log;
+                }
+                throw exception(except_e::GRAPHICS_BASE, "glCompileShader");
+            }
         }
 
         shader(const shader& rhs) = delete;
@@ -96,33 +114,47 @@ namespace game::opengl
         }
 
         program(std::string_view basename)
-            : _vertex(std::string(basename).append("-vert.glsl"), GL_VERTEX_SHADER), 
-            _fragment(std::string(basename).append("-frag.glsl"), GL_FRAGMENT_SHADER)
+            : program(basename, basename)
         {
-            auto checkProgramError = [&]() {
-                std::string buffer;
-                GLint status;
-                glGetProgramiv(_program, GL_LINK_STATUS, &status);
-                if (status == GL_FALSE) {
-                    if (debug) {
-                        glGetProgramiv(_program, GL_INFO_LOG_LENGTH, &status);
-                        buffer.resize(status);
-                        glGetProgramInfoLog(_program, status, nullptr, buffer.data());
-                        std::cerr << buffer;
-                    }
-                    throw exception(except_e::GRAPHICS_BASE, "glLinkProgram");
-                }
-            };
+        }
+
+        /*
+         * Loads the program from the binary cache when the driver still accepts it, otherwise compiles and links
+         * the shaders and saves the result for the next start.
+         */
+
+        program(std::string_view vertexName, std::string_view fragmentName)
+        {
+            auto start = std::chrono::steady_clock::now();
+            std::string vertexBuffer, fragmentBuffer;
+            auto vertex = shader<debug>::source(std::string(vertexName).append("-vert.glsl"), vertexBuffer);
+            auto fragment = shader<debug>::source(std::string(fragmentName).append("-frag.glsl"), fragmentBuffer);
+            auto key = programCache::key(vertex, fragment);
 
             _program = glCreateProgram();
             if (!_program)
                 throw exception(except_e::GRAPHICS_BASE, "glCreateProgram");
 
-            glAttachShader(_program, _vertex);
-            glAttachShader(_program, _fragment);
-
-            glLinkProgram(_program);
-            checkProgramError();
+            if (!programCache::load(_program, key)) {
+                // A program that was given a rejected binary starts over
+                glDeleteProgram(_program);
+                _program = glCreateProgram();
+                if (!_program)
+                    throw exception(except_e::GRAPHICS_BASE, "glCreateProgram");
+
+                _vertex.compile(GL_VERTEX_SHADER, vertex);
+                _fragment.compile(GL_FRAGMENT_SHADER, fragment);
+                glAttachShader(_program, _vertex);
+                glAttachShader(_program, _fragment);
+
+                glProgramParameteri(_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+                glLinkProgram(_program);
+                checkProgramError();
+
+                programCache::store(_program, key);
+                ++programCache::stats().compiled;
+            }
+            programCache::stats().seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
         }
 
         program(const program& rhs) = delete;
@@ -151,8 +183,30 @@ namespace game::opengl
 			UBO::updateIgnorant(_program, std::forward<Args>(args)...);
 		}
 
+		template<int I, class T>
+		void FORCEINLINE updateUboElement(const T& arg)
+		{
+			UBO::template updateElement<I>(_program, arg);
+		}
+
     private:
 
+        void checkProgramError()
+        {
+            std::string buffer;
+            GLint status;
+            glGetProgramiv(_program, GL_LINK_STATUS, &status);
+            if (status == GL_FALSE) {
+                if (debug) {
+                    glGetProgramiv(_program, GL_INFO_LOG_LENGTH, &status);
+                    buffer.resize(status);
+                    glGetProgramInfoLog(_program, status, nullptr, buffer.data());
+                    std::cerr << buffer;
+                }
+                throw exception(except_e::GRAPHICS_BASE, "glLinkProgram");
+            }
+        }
+
         GLuint _program = 0;
 
         shader<debug> _vertex;
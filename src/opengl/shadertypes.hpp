@@ -15,7 +15,7 @@ namespace game::opengl
      * Possible shader types
      */
 
-    enum class ShaderType { PLANE_TEXTURED, PHONG_TEXTURED, TEXT };
+    enum class ShaderType { PLANE_TEXTURED, PHONG_TEXTURED, PHONG_PACKED, TEXT };
 
     /*
      * Shader definitions
@@ -31,7 +31,7 @@ namespace game::opengl
 	struct ShaderInfo<ShaderType::PLANE_TEXTURED>
 	{
 		using vio = vertexInputObject<true, false, true, false>;
-		using ubo = uniformBufferObject<true, false, true, false, false, false, false>;
+		using ubo = uniformBufferObject<true, false, true, false, false, false, false, false>;
 		using vi = GLuint;
 
         using model = basicModel<vio, vi, true>;
@@ -44,20 +44,38 @@ namespace game::opengl
 	struct ShaderInfo<ShaderType::PHONG_TEXTURED>
 	{
 		using vio = vertexInputObject<true, false, true, true>;
-		using ubo = uniformBufferObject<true, true, false, false, true, true, true>;
+		using ubo = uniformBufferObject<true, true, false, false, true, true, true, false>;
 		using vi = GLuint;
 
         using model = complexModel<vio, vi>;
         using pipeline = complexModelPipeline<ubo, vio, vi>;
 
 		static constexpr auto shaderName = "phong";
+
+		static constexpr auto fragmentName = "phong";
+	};
+
+	// Phong shading of meshfile::packedVertex, the fragment shader is shared with PHONG_TEXTURED
+	template<>
+	struct ShaderInfo<ShaderType::PHONG_PACKED>
+	{
+		using vio = vertexInputObject<true, false, true, true, true>;
+		using ubo = uniformBufferObject<true, true, false, false, true, true, true, true>;
+		using vi = GLuint;
+
+        using model = complexModel<vio, vi>;
+        using pipeline = complexModelPipeline<ubo, vio, vi>;
+
+		static constexpr auto shaderName = "phong-packed";
+
+		static constexpr auto fragmentName = "phong";
 	};
 
 	template<>
 	struct ShaderInfo<ShaderType::TEXT>
 	{
 		using vio = vertexInputObject<true, false, true, false>;
-		using ubo = uniformBufferObject<false, false, true, true, false, false, false>;
+		using ubo = uniformBufferObject<false, false, true, true, false, false, false, false>;
 
         using text = text;
         using pipeline = textPipeline<ubo, vio>;
@@ -0,0 +1,265 @@
+#pragma once
+
+#include "glbase.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+
+namespace game::opengl
+{
+    /*
+     * A persistently mapped ring buffer that every upload goes through. Data is written into the mapping and copied
+     * into the destination buffer or texture by the GPU, fences tell when a part of the ring may be written again.
+     * allocate(), the copies and fence() need the OpenGL context, the memory of a region can be written by any
+     * thread before it is copied.
+     *
+     * The graphics object owns the ring of its context and makes it current(). Without a current ring, for instance
+     * before the context is set up, the uploads go straight from client memory.
+     */
+
+    class stagingBuffer
+    {
+    public:
+
+        struct region
+        {
+            char *data = nullptr;
+
+            GLintptr offset = 0;
+
+            GLsizeiptr size = 0;
+
+            explicit operator bool() const
+            {
+                return data != nullptr;
+            }
+        };
+
+        struct statistics
+        {
+            size_t bytes = 0, uploads = 0;
+
+            // Allocations that had to wait for the GPU to finish with older uploads
+            size_t stalls = 0;
+
+            double stallSeconds = 0.0;
+        };
+
+        explicit stagingBuffer(GLsizeiptr size)
+            : _size(size)
+        {
+            glCreateBuffers(1, &_buffer);
+            if (!_buffer)
+                throw exception(except_e::GRAPHICS_BASE, "glCreateBuffers");
+
+            constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glNamedBufferStorage(_buffer, size, nullptr, flags);
+            _data = static_cast<char*>(glMapNamedBufferRange(_buffer, 0, size, flags));
+            if (!_data) {
+                glDeleteBuffers(1, &_buffer);
+                throw exception(except_e::GRAPHICS_BASE, "glMapNamedBufferRange");
+            }
+            current() = this;
+        }
+
+        stagingBuffer(const stagingBuffer& rhs) = delete;
+
+        stagingBuffer(stagingBuffer&& rhs) = delete;
+
+        ~stagingBuffer()
+        {
+            if (current() == this)
+                current() = nullptr;
+
+            for (auto& f : _fences)
+                glDeleteSync(f.sync);
+            glUnmapNamedBuffer(_buffer);
+            glDeleteBuffers(1, &_buffer);
+        }
+
+        static stagingBuffer*& current()
+        {
+            static stagingBuffer *ring = nullptr;
+            return ring;
+        }
+
+        /*
+         * Reserves size bytes at the given alignment, waiting for the GPU when the ring is full. Returns an empty
+         * region when size does not fit in the ring at all. A full ring fences the regions allocated before, so
+         * their copies have to be recorded before the next allocate().
+         */
+
+        region allocate(GLsizeiptr size, GLsizeiptr alignment = 16)
+        {
+            if (size > _size)
+                return {};
+
+            GLsizeiptr start, need;
+            for (;;) {
+                // Nothing in flight, so start over at the front and keep the ring from wrapping needlessly
+                if (_used == 0)
+                    _head = 0;
+
+                // A region that does not fit before the end wraps around, the rest of the ring counts as used
+                start = (_head + alignment - 1) / alignment * alignment;
+                if (start + size > _size)
+                    start = 0;
+                need = (start >= _head ? start - _head : _size - _head) + size;
+                if (_used + need <= _size)
+                    break;
+
+                // Regions written since the last fence have to get one before they can be waited for
+                if (_unfenced)
+                    fence();
+                else
+                    retire(true);
+            }
+
+            _head = start + size;
+            _used += need;
+            _unfenced += need;
+            _stats.bytes += size;
+            return {_data + start, start, size};
+        }
+
+        // Marks the end of the copies that read the regions allocated so far, and frees the ones the GPU is done with
+        void fence()
+        {
+            if (_unfenced) {
+                _fences.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), _unfenced});
+                _unfenced = 0;
+            }
+            while (!_fences.empty() && retire(false));
+        }
+
+        void copy(const region& src, GLuint buffer, GLintptr offset)
+        {
+            glCopyNamedBufferSubData(_buffer, buffer, src.offset, offset, src.size);
+        }
+
+        void copy(const region& src, GLuint texture, GLint level, GLsizei width, GLsizei height, GLenum format, GLenum type)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffer);
+            glTextureSubImage2D(texture, level, 0, 0, width, height, format, type, reinterpret_cast<const void*>(src.offset));
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        void copyCompressed(const region& src, GLuint texture, GLint level, GLsizei width, GLsizei height, GLenum format)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffer);
+            glCompressedTextureSubImage2D(texture, level, 0, 0, width, height, format, static_cast<GLsizei>(src.size),
+                reinterpret_cast<const void*>(src.offset));
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        // Uploads into a buffer through the ring, data larger than a quarter of the ring goes in several copies. Without
+        // a ring the buffer has to allow glNamedBufferSubData, immutable storage needs GL_DYNAMIC_STORAGE_BIT for it
+        static void upload(GLuint buffer, GLintptr offset, const void *data, GLsizeiptr size)
+        {
+            auto ring = current();
+            if (!ring) {
+                glNamedBufferSubData(buffer, offset, size, data);
+                return;
+            }
+
+            auto chunk = std::max<GLsizeiptr>(ring->_size / 4, 1);
+            for (GLsizeiptr done = 0; done < size; done += chunk) {
+                auto part = ring->allocate(std::min(chunk, size - done));
+                std::memcpy(part.data, static_cast<const char*>(data) + done, part.size);
+                ring->copy(part, buffer, offset + done);
+            }
+            ring->finish();
+        }
+
+        // Uploads a whole texture level, levels that do not fit in half of the ring go straight from client memory
+        static void upload(GLuint texture, GLint level, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *data,
+            GLsizeiptr size)
+        {
+            auto ring = current();
+            if (!ring || size > ring->_size / 2) {
+                glTextureSubImage2D(texture, level, 0, 0, width, height, format, type, data);
+                return;
+            }
+
+            auto part = ring->allocate(size);
+            std::memcpy(part.data, data, size);
+            ring->copy(part, texture, level, width, height, format, type);
+            ring->finish();
+        }
+
+        static void uploadCompressed(GLuint texture, GLint level, GLsizei width, GLsizei height, GLenum format, const void *data,
+            GLsizeiptr size)
+        {
+            auto ring = current();
+            if (!ring || size > ring->_size / 2) {
+                glCompressedTextureSubImage2D(texture, level, 0, 0, width, height, format, static_cast<GLsizei>(size), data);
+                return;
+            }
+
+            auto part = ring->allocate(size);
+            std::memcpy(part.data, data, size);
+            ring->copyCompressed(part, texture, level, width, height, format);
+            ring->finish();
+        }
+
+        const statistics& stats() const
+        {
+            return _stats;
+        }
+
+        GLsizeiptr size() const
+        {
+            return _size;
+        }
+
+    private:
+
+        void finish()
+        {
+            ++_stats.uploads;
+            fence();
+        }
+
+        // Frees the oldest fenced part of the ring, returns false when wait is false and the GPU is not done with it
+        bool retire(bool wait)
+        {
+            auto& f = _fences.front();
+            auto result = glClientWaitSync(f.sync, 0, 0);
+            if (result == GL_TIMEOUT_EXPIRED) {
+                if (!wait)
+                    return false;
+
+                auto start = std::chrono::steady_clock::now();
+                while ((result = glClientWaitSync(f.sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000)) == GL_TIMEOUT_EXPIRED);
+                ++_stats.stalls;
+                _stats.stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+            if (result == GL_WAIT_FAILED)
+                throw exception(except_e::GRAPHICS_BASE, "glClientWaitSync");
+
+            glDeleteSync(f.sync);
+            _used -= f.bytes;
+            _fences.pop_front();
+            return true;
+        }
+
+        struct pendingFence
+        {
+            GLsync sync;
+
+            // Bytes of the ring, padding included, that were allocated before the fence
+            GLsizeiptr bytes;
+        };
+
+        GLuint _buffer = 0;
+
+        char *_data = nullptr;
+
+        GLsizeiptr _size, _head = 0, _used = 0, _unfenced = 0;
+
+        std::deque<pendingFence> _fences;
+
+        statistics _stats;
+    };
+}
\ No newline at end of file
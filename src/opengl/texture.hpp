@@ -1,9 +1,31 @@
 #pragma once
 
 #include "glbase.hpp"
+#include "staging.hpp"
+#include "base/assetpack.hpp"
+#include "base/asyncio.hpp"
+#include "application/texfile.hpp"
+#include "application/bcdecode.hpp"
+#include <fstream>
+#include <memory>
 #include <string>
+#include <vector>
 #include <stb_image.h>
 
+// S3TC is an extension that gl3w does not define, every desktop driver supports it
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
 namespace game::opengl
 {
     class texture
@@ -15,29 +37,136 @@ namespace game::opengl
             return _texture;
         }
 
-        texture(std::string_view name)
+        /*
+         * What a texture is created from, read and decoded by prepare() without the OpenGL context so a loader thread
+         * can do it. Either the preprocessed file or the pixels of the image are set.
+         */
+
+        struct source
         {
-            int width, height, channels;
+            std::unique_ptr<texfile> file;
+
+            // The file contents when they were read into memory, file points into them
+            std::vector<char> bytes;
+
+            std::unique_ptr<stbi_uc, void(*)(void*)> pixels{nullptr, stbi_image_free};
+
+            int width = 0, height = 0;
+
+            // Bytes the upload copies to the driver
+            size_t size() const
+            {
+                if (!file)
+                    return size_t(width) * height * 4;
+
+                size_t total = 0;
+                for (const auto& l : file->levels)
+                    total += l.size;
+                return total;
+            }
+        };
 
-            stbi_uc *pixels = stbi_load(name.data(), &width, &height, &channels, STBI_rgb_alpha);
-            if (!pixels)
+        static source prepare(std::string_view name)
+        {
+            source out;
+
+            // A preprocessed texture next to the image, or in the asset pack, is uploaded as it is
+            auto processed = std::string(name.substr(0, name.find_last_of('.'))).append(".tex");
+            if (auto packed = assetPack::lookup(processed); packed.data()) {
+                out.file = std::make_unique<texfile>(packed.data(), packed.size());
+                return out;
+            }
+            if (std::ifstream(processed).is_open()) {
+                out.file = std::make_unique<texfile>(processed);
+                return out;
+            }
+
+            // Images in the asset pack are decoded straight from the mapping
+            int channels;
+            if (auto packed = assetPack::lookup(name); packed.data())
+                out.pixels.reset(stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(packed.data()), static_cast<int>(packed.size()),
+                    &out.width, &out.height, &channels, STBI_rgb_alpha));
+            else
+                out.pixels.reset(stbi_load(std::string(name).c_str(), &out.width, &out.height, &channels, STBI_rgb_alpha));
+            if (!out.pixels)
                 throw exception(except_e::GRAPHICS_BASE, "stbi_load");
-            
+            return out;
+        }
+
+        // The file on disk prepare() reads for name, empty when the asset pack has the texture
+        static std::string file(std::string_view name)
+        {
+            auto processed = std::string(name.substr(0, name.find_last_of('.'))).append(".tex");
+            if (assetPack::lookup(processed).data())
+                return {};
+            if (std::ifstream(processed).is_open())
+                return processed;
+            if (assetPack::lookup(name).data())
+                return {};
+            return std::string(name);
+        }
+
+        // Creates the source from the contents of file(name), which were read by the caller
+        static source prepare(std::string_view name, std::vector<char>&& bytes)
+        {
+            source out;
+            out.bytes = std::move(bytes);
+
+            auto path = file(name);
+            if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".tex") == 0) {
+                out.file = std::make_unique<texfile>(out.bytes.data(), out.bytes.size());
+                return out;
+            }
+
+            int channels;
+            out.pixels.reset(stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(out.bytes.data()), static_cast<int>(out.bytes.size()),
+                &out.width, &out.height, &channels, STBI_rgb_alpha));
+            out.bytes.clear();
+            out.bytes.shrink_to_fit();
+            if (!out.pixels)
+                throw exception(except_e::GRAPHICS_BASE, "stbi_load_from_memory");
+            return out;
+        }
+
+        // Takes the contents of file(name) from files read ahead, anything that was not read is loaded here
+        static source prepare(std::string_view name, native::asyncReader::files& files)
+        {
+            auto it = files.find(file(name));
+            if (it == files.end())
+                return prepare(name);
+            return prepare(name, std::move(it->second));
+        }
+
+        texture(std::string_view name)
+            : texture(prepare(name))
+        {
+        }
+
+        texture(const source& src)
+        {
+            if (src.file) {
+                upload(*src.file);
+                return;
+            }
+
             glCreateTextures(GL_TEXTURE_2D, 1, &_texture);
             if (!_texture)
                 throw exception(except_e::GRAPHICS_BASE, "glCreateTextures");
 
-            auto miplevels = static_cast<GLuint>(std::floor(std::log2(std::max(width, height)))) + 1;
+            auto miplevels = static_cast<GLuint>(std::floor(std::log2(std::max(src.width, src.height)))) + 1;
 
-            glTextureStorage2D(_texture, miplevels, GL_RGBA8, width, height);
-            glTextureSubImage2D(_texture, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            glTextureStorage2D(_texture, miplevels, GL_RGBA8, src.width, src.height);
+            stagingBuffer::upload(_texture, 0, src.width, src.height, GL_RGBA, GL_UNSIGNED_BYTE, src.pixels.get(), src.size());
             glTextureParameteri(_texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
             glTextureParameteri(_texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
             glTextureParameteri(_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
             glTextureParameteri(_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
             glGenerateTextureMipmap(_texture);
+        }
 
-            stbi_image_free(pixels);
+        // No texture yet, binding it unbinds the unit
+        texture()
+        {
         }
 
         // This function is only meant to be used for font rendering
@@ -49,7 +178,7 @@ namespace game::opengl
             
 			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
             glTextureStorage2D(_texture, 1, GL_R8, width, height);
-            glTextureSubImage2D(_texture, 0, 0, 0, width, height, GL_RED, GL_UNSIGNED_BYTE, data);
+            stagingBuffer::upload(_texture, 0, width, height, GL_RED, GL_UNSIGNED_BYTE, data, GLsizeiptr(width) * height);
             glTextureParameteri(_texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
             glTextureParameteri(_texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
             glTextureParameteri(_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -65,6 +194,12 @@ namespace game::opengl
             rhs._texture = 0;
         }
 
+        texture& operator=(texture&& rhs) noexcept
+        {
+            std::swap(_texture, rhs._texture);
+            return *this;
+        }
+
         ~texture()
         {
             if (_texture)
@@ -73,6 +208,87 @@ namespace game::opengl
 
     private:
 
+        // Textures flagged srgb are decoded to linear light when sampled, the way their mips were filtered
+        static GLenum internalFormat(texfile::pixelFormat format, bool srgb)
+        {
+            switch (format) {
+            case texfile::pixelFormat::bc1:
+                return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+            case texfile::pixelFormat::bc3:
+                return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case texfile::pixelFormat::bc7:
+                return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+            default:
+                return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+            }
+        }
+
+        // Asks the driver once per format, the answer does not change while the context lives
+        static bool supported(texfile::pixelFormat format, bool srgb)
+        {
+            static GLint known[2][5] = {{-1, -1, -1, -1, -1}, {-1, -1, -1, -1, -1}};
+
+            auto& answer = known[srgb][static_cast<uint32_t>(format)];
+            if (answer < 0) {
+                answer = GL_FALSE;
+                glGetInternalformativ(GL_TEXTURE_2D, internalFormat(format, srgb), GL_INTERNALFORMAT_SUPPORTED, 1, &answer);
+            }
+            return answer == GL_TRUE;
+        }
+
+        // Block compressed levels the driver cannot sample are decoded, the texture then takes as much memory as rgba8
+        static std::vector<uint8_t> decode(texfile::pixelFormat format, const char *blocks, uint32_t width, uint32_t height)
+        {
+            auto decodeBlock = format == texfile::pixelFormat::bc1 ? bc::decodeBC1
+                : format == texfile::pixelFormat::bc3 ? bc::decodeBC3 : bc::decodeBC7;
+            auto size = texfile::levelSize(format, 4, 4);
+
+            std::vector<uint8_t> out(size_t(width) * height * 4);
+            uint8_t texels[64];
+            for (uint32_t by = 0; by < (height + 3) / 4; ++by) {
+                for (uint32_t bx = 0; bx < (width + 3) / 4; ++bx, blocks += size) {
+                    decodeBlock(reinterpret_cast<const uint8_t*>(blocks), texels);
+                    for (uint32_t y = by*4; y < std::min(by*4 + 4, height); ++y)
+                        std::copy_n(texels + (y - by*4) * 16, std::min(4u, width - bx*4) * 4, &out[(size_t(y) * width + bx*4) * 4]);
+                }
+            }
+            return out;
+        }
+
+        // Every level comes from the file, nothing is generated here
+        void upload(const texfile& file)
+        {
+            glCreateTextures(GL_TEXTURE_2D, 1, &_texture);
+            if (!_texture)
+                throw exception(except_e::GRAPHICS_BASE, "glCreateTextures");
+
+            auto format = file.head.format;
+            auto srgb = (file.head.flags & texfile::srgb) != 0;
+            auto compressed = format != texfile::pixelFormat::rgba8 && supported(format, srgb);
+
+            auto levels = static_cast<GLsizei>(file.levels.size());
+            glTextureStorage2D(_texture, levels, internalFormat(compressed ? format : texfile::pixelFormat::rgba8, srgb), file.head.width,
+                file.head.height);
+            for (GLsizei i = 0; i < levels; ++i) {
+                const auto& l = file.levels[i];
+                if (compressed) {
+                    stagingBuffer::uploadCompressed(_texture, i, l.width, l.height, internalFormat(format, srgb), file.pixels(i), l.size);
+                }
+                else if (format != texfile::pixelFormat::rgba8) {
+                    auto pixels = decode(format, file.pixels(i), l.width, l.height);
+                    stagingBuffer::upload(_texture, i, l.width, l.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data(), pixels.size());
+                }
+                else {
+                    stagingBuffer::upload(_texture, i, l.width, l.height, GL_RGBA, GL_UNSIGNED_BYTE, file.pixels(i), l.size);
+                }
+            }
+            glTextureParameteri(_texture, GL_TEXTURE_MAX_LEVEL, levels - 1);
+            glTextureParameteri(_texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTextureParameteri(_texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTextureParameteri(_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTextureParameteri(_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        }
+
         GLuint _texture = 0;
     };
 }
\ No newline at end of file
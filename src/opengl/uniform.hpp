@@ -32,13 +32,16 @@ namespace game::opengl
 			else if constexpr (std::is_same_v<T, glm::vec3>)
 				glProgramUniform3fv(program, location, 1, glm::value_ptr(value));
 
+			else if constexpr (std::is_same_v<T, glm::vec2>)
+				glProgramUniform2fv(program, location, 1, glm::value_ptr(value));
+
 			else if constexpr (std::is_same_v<T, GLint>)
 				glProgramUniform1i(program, location, value);
 
 			else if constexpr (std::is_same_v<T, GLfloat>)
 				glProgramUniform1f(program, location, value);
 			
-			static_assert(std::is_same_v<T, glm::mat4> || std::is_same_v<T, glm::mat3> || std::is_same_v<T, glm::vec3> || std::is_same_v<T, GLint>
+			static_assert(std::is_same_v<T, glm::mat4> || std::is_same_v<T, glm::mat3> || std::is_same_v<T, glm::vec3> || std::is_same_v<T, glm::vec2> || std::is_same_v<T, GLint>
 				|| std::is_same_v<T, GLfloat>, "Unkown type");
 		}
 
@@ -153,6 +156,20 @@ namespace game::opengl
 				static constexpr auto name = "material.shininess";
 			} shin;
 
+			struct diffuseColor
+			{
+				using type = glm::vec3;
+
+				static constexpr auto name = "material.diffuseColor";
+			} difColor;
+
+			struct specularColor
+			{
+				using type = glm::vec3;
+
+				static constexpr auto name = "material.specularColor";
+			} specColor;
+
 			static constexpr auto MaterialTrait = true;
 
 			template<class T>
@@ -161,6 +178,8 @@ namespace game::opengl
 				uboBlocks::update<diffuse>(program, value.diffuse);
 				uboBlocks::update<specular>(program, value.specular);
 				uboBlocks::update<shininess>(program, value.shininess);
+				uboBlocks::update<diffuseColor>(program, value.diffuseColor);
+				uboBlocks::update<specularColor>(program, value.specularColor);
 			}
 		};
 		struct EmptyMaterial
@@ -205,13 +224,61 @@ namespace game::opengl
 		{
 			static constexpr auto LightTrait = false;
 		};
+
+		// Bounds to dequantize packed positions and texcoords: offset + value*scale
+		struct Decode
+		{
+			struct positionOffset
+			{
+				using type = glm::vec3;
+
+				static constexpr auto name = "decode.positionOffset";
+			} posOff;
+
+			struct positionScale
+			{
+				using type = glm::vec3;
+
+				static constexpr auto name = "decode.positionScale";
+			} posScale;
+
+			struct texCoordOffset
+			{
+				using type = glm::vec2;
+
+				static constexpr auto name = "decode.texCoordOffset";
+			} texOff;
+
+			struct texCoordScale
+			{
+				using type = glm::vec2;
+
+				static constexpr auto name = "decode.texCoordScale";
+			} texScale;
+
+			static constexpr auto DecodeTrait = true;
+
+			template<class T>
+			static void update(GLuint program, const T& value)
+			{
+				uboBlocks::update<positionOffset>(program, value.positionOffset);
+				uboBlocks::update<positionScale>(program, value.positionScale);
+				uboBlocks::update<texCoordOffset>(program, value.texCoordOffset);
+				uboBlocks::update<texCoordScale>(program, value.texCoordScale);
+			}
+		};
+		struct EmptyDecode
+		{
+			static constexpr auto DecodeTrait = false;
+		};
 	}
 
 	/*
 	 * Object to update the uniform buffer
 	*/
 	
-    template<bool mvpEnabled, bool vsEnabled, bool tcEnabled, bool txtcEnabled, bool ambientEnabled, bool materialEnabled, bool lightEnabled> 
+    template<bool mvpEnabled, bool vsEnabled, bool tcEnabled, bool txtcEnabled, bool ambientEnabled, bool materialEnabled, bool lightEnabled,
+		bool decodeEnabled> 
 	struct uniformBufferObject :
 		// MVP = Projection * View * Model enabled
         std::conditional_t<mvpEnabled, uboBlocks::mvp, uboBlocks::emptyMvp>,						// index = 0
@@ -233,7 +300,10 @@ namespace game::opengl
 		std::conditional_t<materialEnabled, uboBlocks::Material, uboBlocks::EmptyMaterial>,			// index = 5
 
 		// Light struct enabled
-		std::conditional_t<lightEnabled, uboBlocks::Light, uboBlocks::EmptyLight>					// index = 6
+		std::conditional_t<lightEnabled, uboBlocks::Light, uboBlocks::EmptyLight>,					// index = 6
+
+		// Decode struct for packed vertices enabled
+		std::conditional_t<decodeEnabled, uboBlocks::Decode, uboBlocks::EmptyDecode>				// index = 7
 	{
 		template<class T, class... Args>
 		static FORCEINLINE void update(GLuint program, const T& arg, Args... args)
@@ -259,6 +329,13 @@ namespace game::opengl
 			updateInternalIgnorant<0>(program, arg);
 		}
 
+		// Updates only the element with index I in the list above, for values that change between draws
+		template<int I, class T>
+		static FORCEINLINE void updateElement(GLuint program, const T& arg)
+		{
+			updateInternalValue<I>(program, arg);
+		}
+
 	private:
 
 		static constexpr int calcDisabled(int i)
@@ -331,6 +408,15 @@ namespace game::opengl
 					return result;
 			}
 
+			// Decode
+			if (!decodeEnabled)
+				++result;
+			else {
+				++index;
+				if (index == i+1)
+					return result;
+			}
+
 			return result;
 		}
 
@@ -368,6 +454,10 @@ namespace game::opengl
 			// Light
 			else if constexpr (I == 6 && lightEnabled)
 				uboBlocks::Light::update(program, arg);
+
+			// Decode
+			else if constexpr (I == 7 && decodeEnabled)
+				uboBlocks::Decode::update(program, arg);
 		}
 
 		template<int I, class T>
@@ -397,6 +487,6 @@ namespace game::opengl
 			updateInternalIgnorant<I+1>(program, args...);
 		}
 
-		static constexpr int totalElements = 7;
+		static constexpr int totalElements = 8;
     };
 }
\ No newline at end of file
@@ -1,11 +1,93 @@
 #pragma once
 
 #include "glbase.hpp"
+#include "application/mesh.hpp"
 #include <type_traits>
 #include <vector>
 
 namespace game::opengl
 {
+	/*
+	 * Attribute formats, size is the number of bytes the attribute takes in the vertex
+	 */
+
+	namespace vioFormats
+	{
+		struct none
+		{
+			static constexpr GLuint size = 0;
+
+			static constexpr auto file = meshfile::attribFormat::none;
+		};
+
+		struct float2
+		{
+			static constexpr GLint components = 2;
+
+			static constexpr GLenum type = GL_FLOAT;
+
+			static constexpr GLboolean normalized = GL_FALSE;
+
+			static constexpr GLuint size = 2*sizeof(GLfloat);
+
+			static constexpr auto file = meshfile::attribFormat::float2;
+		};
+
+		struct float3
+		{
+			static constexpr GLint components = 3;
+
+			static constexpr GLenum type = GL_FLOAT;
+
+			static constexpr GLboolean normalized = GL_FALSE;
+
+			static constexpr GLuint size = 3*sizeof(GLfloat);
+
+			static constexpr auto file = meshfile::attribFormat::float3;
+		};
+
+		// Three components read from four shorts, the fourth one is padding
+		struct unorm16x3
+		{
+			static constexpr GLint components = 3;
+
+			static constexpr GLenum type = GL_UNSIGNED_SHORT;
+
+			static constexpr GLboolean normalized = GL_TRUE;
+
+			static constexpr GLuint size = 4*sizeof(GLushort);
+
+			static constexpr auto file = meshfile::attribFormat::unorm16x3;
+		};
+
+		struct unorm16x2
+		{
+			static constexpr GLint components = 2;
+
+			static constexpr GLenum type = GL_UNSIGNED_SHORT;
+
+			static constexpr GLboolean normalized = GL_TRUE;
+
+			static constexpr GLuint size = 2*sizeof(GLushort);
+
+			static constexpr auto file = meshfile::attribFormat::unorm16x2;
+		};
+
+		// Octahedral encoded normal, the shader decodes it into a vec3
+		struct octSnorm16
+		{
+			static constexpr GLint components = 2;
+
+			static constexpr GLenum type = GL_SHORT;
+
+			static constexpr GLboolean normalized = GL_TRUE;
+
+			static constexpr GLuint size = 2*sizeof(GLshort);
+
+			static constexpr auto file = meshfile::attribFormat::octSnorm16;
+		};
+	}
+
 	namespace vioBlocks
 	{
 		struct position
@@ -13,11 +95,24 @@ namespace game::opengl
 			glm::vec3 inputPosition;
 
 			static constexpr bool positionTrait = true;
+
+			using positionFormat = vioFormats::float3;
+		};
+
+		struct packedPosition
+		{
+			glm::u16vec4 inputPosition;
+
+			static constexpr bool positionTrait = true;
+
+			using positionFormat = vioFormats::unorm16x3;
 		};
 
 		struct emptyPosition
 		{
 			static constexpr bool positionTrait = false;
+
+			using positionFormat = vioFormats::none;
 		};
 
 		struct color
@@ -25,11 +120,15 @@ namespace game::opengl
 			glm::vec3 inputColor;
 
 			static constexpr bool colorTrait = true;
+
+			using colorFormat = vioFormats::float3;
 		};
 
 		struct emptyColor
 		{
 			static constexpr bool colorTrait = false;
+
+			using colorFormat = vioFormats::none;
 		};
 
 		struct texCoord
@@ -37,11 +136,24 @@ namespace game::opengl
 			glm::vec2 inputTexCoord;
 
 			static constexpr bool texCoordTrait = true;
+
+			using texCoordFormat = vioFormats::float2;
+		};
+
+		struct packedTexCoord
+		{
+			glm::u16vec2 inputTexCoord;
+
+			static constexpr bool texCoordTrait = true;
+
+			using texCoordFormat = vioFormats::unorm16x2;
 		};
 
 		struct emptyTexCoord
 		{
 			static constexpr bool texCoordTrait = false;
+
+			using texCoordFormat = vioFormats::none;
 		};
 
 		struct normal
@@ -49,56 +161,82 @@ namespace game::opengl
 			glm::vec3 inputNormal;
 
 			static constexpr bool normalTrait = true;
+
+			using normalFormat = vioFormats::float3;
+		};
+
+		struct packedNormal
+		{
+			glm::i16vec2 inputNormal;
+
+			static constexpr bool normalTrait = true;
+
+			using normalFormat = vioFormats::octSnorm16;
 		};
 
 		struct emptyNormal
 		{
 			static constexpr bool normalTrait = false;
+
+			using normalFormat = vioFormats::none;
 		};
+
+		template<bool enabled, bool packed, class Full, class Packed, class Empty>
+		using select = std::conditional_t<enabled, std::conditional_t<packed, Packed, Full>, Empty>;
 	}
 
-    template<bool p, bool c, bool t, bool n>
+	/*
+	 * When packed is set the position, texcoord and normal use the quantized formats of meshfile::packedVertex,
+	 * the color has no packed format.
+	 */
+
+    template<bool p, bool c, bool t, bool n, bool packed = false>
     struct vertexInputObject :
-        std::conditional_t<p, vioBlocks::position, vioBlocks::emptyPosition>,
-        std::conditional_t<c, vioBlocks::color, vioBlocks::emptyColor>,
-        std::conditional_t<t, vioBlocks::texCoord, vioBlocks::emptyTexCoord>,
-        std::conditional_t<n, vioBlocks::normal, vioBlocks::emptyNormal>
+        vioBlocks::select<p, packed, vioBlocks::position, vioBlocks::packedPosition, vioBlocks::emptyPosition>,
+        vioBlocks::select<c, false, vioBlocks::color, vioBlocks::color, vioBlocks::emptyColor>,
+        vioBlocks::select<t, packed, vioBlocks::texCoord, vioBlocks::packedTexCoord, vioBlocks::emptyTexCoord>,
+        vioBlocks::select<n, packed, vioBlocks::normal, vioBlocks::packedNormal, vioBlocks::emptyNormal>
     {
+        using positionBlock = vioBlocks::select<p, packed, vioBlocks::position, vioBlocks::packedPosition, vioBlocks::emptyPosition>;
+        using colorBlock = vioBlocks::select<c, false, vioBlocks::color, vioBlocks::color, vioBlocks::emptyColor>;
+        using texCoordBlock = vioBlocks::select<t, packed, vioBlocks::texCoord, vioBlocks::packedTexCoord, vioBlocks::emptyTexCoord>;
+        using normalBlock = vioBlocks::select<n, packed, vioBlocks::normal, vioBlocks::packedNormal, vioBlocks::emptyNormal>;
+
         vertexInputObject(
-				const std::conditional_t<p, vioBlocks::position, vioBlocks::emptyPosition>& pb = {},
-                const std::conditional_t<c, vioBlocks::color, vioBlocks::emptyColor>& cb = {},
-                const std::conditional_t<t, vioBlocks::texCoord, vioBlocks::emptyTexCoord>& tb = {},
-                const std::conditional_t<n, vioBlocks::normal, vioBlocks::emptyNormal>& nb = {}
+				const positionBlock& pb = {},
+                const colorBlock& cb = {},
+                const texCoordBlock& tb = {},
+                const normalBlock& nb = {}
             ) :
-            std::conditional_t<p, vioBlocks::position, vioBlocks::emptyPosition>(pb),
-            std::conditional_t<c, vioBlocks::color, vioBlocks::emptyColor>(cb),
-            std::conditional_t<t, vioBlocks::texCoord, vioBlocks::emptyTexCoord>(tb),
-            std::conditional_t<n, vioBlocks::normal, vioBlocks::emptyNormal>(nb)
+            positionBlock(pb),
+            colorBlock(cb),
+            texCoordBlock(tb),
+            normalBlock(nb)
         {
         }
 
         vertexInputObject(const vertexInputObject& rhs)
         {
             if constexpr (p)
-                vioBlocks::position::inputPosition = rhs.inputPosition;
+                positionBlock::inputPosition = rhs.inputPosition;
             if constexpr (c)
-                vioBlocks::color::inputColor = rhs.inputColor;
+                colorBlock::inputColor = rhs.inputColor;
             if constexpr (t)
-                vioBlocks::texCoord::inputTexCoord = rhs.inputTexCoord;
+                texCoordBlock::inputTexCoord = rhs.inputTexCoord;
             if constexpr (n)
-                vioBlocks::normal::inputNormal = rhs.inputNormal;
+                normalBlock::inputNormal = rhs.inputNormal;
         }
 
         vertexInputObject(vertexInputObject&& rhs) noexcept
         {
             if constexpr (p)
-                vioBlocks::position::inputPosition = std::move(rhs.inputPosition);
+                positionBlock::inputPosition = std::move(rhs.inputPosition);
             if constexpr (c)
-                vioBlocks::color::inputColor = std::move(rhs.inputColor);
+                colorBlock::inputColor = std::move(rhs.inputColor);
             if constexpr (t)
-                vioBlocks::texCoord::inputTexCoord = std::move(rhs.inputTexCoord);
+                texCoordBlock::inputTexCoord = std::move(rhs.inputTexCoord);
             if constexpr (n)
-                vioBlocks::normal::inputNormal = std::move(rhs.inputNormal);
+                normalBlock::inputNormal = std::move(rhs.inputNormal);
         }
 
         ~vertexInputObject()
@@ -108,45 +246,45 @@ namespace game::opengl
 		vertexInputObject& operator=(const vertexInputObject& rhs)
 		{
 			if constexpr (p)
-				vioBlocks::position::inputPosition = rhs.inputPosition;
+				positionBlock::inputPosition = rhs.inputPosition;
 			if constexpr (c)
-				vioBlocks::color::inputColor = rhs.inputColor;
+				colorBlock::inputColor = rhs.inputColor;
 			if constexpr (t)
-				vioBlocks::texCoord::inputTexCoord = rhs.inputTexCoord;
+				texCoordBlock::inputTexCoord = rhs.inputTexCoord;
 			if constexpr (n)
-				vioBlocks::normal::inputNormal = rhs.inputNormal;
+				normalBlock::inputNormal = rhs.inputNormal;
 			return *this;
 		}
 
 		vertexInputObject& operator=(vertexInputObject&& rhs) noexcept
 		{
 			if constexpr (p)
-				vioBlocks::position::inputPosition = std::move(rhs.inputPosition);
+				positionBlock::inputPosition = std::move(rhs.inputPosition);
 			if constexpr (c)
-				vioBlocks::color::inputColor = std::move(rhs.inputColor);
+				colorBlock::inputColor = std::move(rhs.inputColor);
 			if constexpr (t)
-				vioBlocks::texCoord::inputTexCoord = std::move(rhs.inputTexCoord);
+				texCoordBlock::inputTexCoord = std::move(rhs.inputTexCoord);
 			if constexpr (n)
-				vioBlocks::normal::inputNormal = std::move(rhs.inputNormal);
+				normalBlock::inputNormal = std::move(rhs.inputNormal);
 			return *this;
 		}
 
         bool operator==(const vertexInputObject& rhs) const
         {
             if constexpr (p) {
-                if (vioBlocks::position::inputPosition != rhs.inputPosition)
+                if (positionBlock::inputPosition != rhs.inputPosition)
                     return false;
             }
             if constexpr (c) {
-                if (vioBlocks::color::inputColor != rhs.inputColor)
+                if (colorBlock::inputColor != rhs.inputColor)
                     return false;
             }
             if constexpr (t) {
-                if (vioBlocks::texCoord::inputTexCoord != rhs.inputTexCoord)
+                if (texCoordBlock::inputTexCoord != rhs.inputTexCoord)
                     return false;
             }
 			if constexpr (n) {
-				if (vioBlocks::normal::inputNormal != rhs.inputNormal)
+				if (normalBlock::inputNormal != rhs.inputNormal)
 					return false;
 			}
             return true;
@@ -174,30 +312,14 @@ namespace game::opengl
             if (!_vao)
                 throw exception(except_e::GRAPHICS_BASE, "glCreateVertexArrays");
 
-            if constexpr (VIO::positionTrait) {
-                constexpr GLuint binding = 0;
-                glEnableVertexArrayAttrib(_vao, binding);
-                glVertexArrayAttribFormat(_vao, binding, 3, GL_FLOAT, GL_FALSE, 0);
-                glVertexArrayAttribBinding(_vao, binding, binding);
-            }
-            if constexpr (VIO::colorTrait) {
-                constexpr GLuint binding = VIO::positionTrait;
-                glEnableVertexArrayAttrib(_vao, binding);
-                glVertexArrayAttribFormat(_vao, binding, 3, GL_FLOAT, GL_FALSE, 0);
-                glVertexArrayAttribBinding(_vao, binding, binding);
-            }
-            if constexpr (VIO::texCoordTrait) {
-                constexpr GLuint binding = VIO::positionTrait + VIO::colorTrait;
-                glEnableVertexArrayAttrib(_vao, binding);
-                glVertexArrayAttribFormat(_vao, binding, 2, GL_FLOAT, GL_TRUE, 0);
-                glVertexArrayAttribBinding(_vao, binding, binding);
-            }
-			if constexpr (VIO::normalTrait) {
-				constexpr GLuint binding = VIO::positionTrait + VIO::colorTrait + VIO::texCoordTrait;
-				glEnableVertexArrayAttrib(_vao, binding);
-				glVertexArrayAttribFormat(_vao, binding, 3, GL_FLOAT, GL_TRUE, 0);
-				glVertexArrayAttribBinding(_vao, binding, binding);
-			}
+            if constexpr (VIO::positionTrait)
+                enable<typename VIO::positionFormat>(0);
+            if constexpr (VIO::colorTrait)
+                enable<typename VIO::colorFormat>(VIO::positionTrait);
+            if constexpr (VIO::texCoordTrait)
+                enable<typename VIO::texCoordFormat>(VIO::positionTrait + VIO::colorTrait);
+			if constexpr (VIO::normalTrait)
+				enable<typename VIO::normalFormat>(VIO::positionTrait + VIO::colorTrait + VIO::texCoordTrait);
         }
 
         VAO(const VAO& rhs) = delete;
@@ -208,6 +330,12 @@ namespace game::opengl
             rhs._vao = 0;
         }
 
+        VAO& operator=(VAO&& rhs) noexcept
+        {
+            std::swap(_vao, rhs._vao);
+            return *this;
+        }
+
         ~VAO()
         {
             if (_vao)
@@ -217,8 +345,9 @@ namespace game::opengl
         template<class Buffer>
         void bind(Buffer& buffer)
         {
-            constexpr GLsizei stride = VIO::positionTrait*sizeof(glm::vec3) + VIO::colorTrait*sizeof(glm::vec3) + VIO::texCoordTrait*sizeof(glm::vec2)
-				+ VIO::normalTrait*sizeof(glm::vec3);
+            constexpr GLuint positionSize = VIO::positionFormat::size, colorSize = VIO::colorFormat::size, texCoordSize = VIO::texCoordFormat::size;
+            constexpr GLsizei stride = positionSize + colorSize + texCoordSize + VIO::normalFormat::size;
+            static_assert(stride == sizeof(VIO), "VIO is not tightly packed");
 
             if constexpr (VIO::positionTrait) {
                 constexpr GLuint binding = 0;
@@ -227,17 +356,17 @@ namespace game::opengl
             }
             if constexpr (VIO::colorTrait) {
                 constexpr GLuint binding = VIO::positionTrait;
-                constexpr GLintptr offset = VIO::positionTrait*sizeof(glm::vec3);
+                constexpr GLintptr offset = positionSize;
                 glVertexArrayVertexBuffer(_vao, binding, buffer.getVertexInputBuffer(), offset, stride);
             }
             if constexpr (VIO::texCoordTrait) {
                 constexpr GLuint binding = VIO::positionTrait + VIO::colorTrait;
-                constexpr GLintptr offset = VIO::positionTrait*sizeof(glm::vec3) + VIO::colorTrait*sizeof(glm::vec3);
+                constexpr GLintptr offset = positionSize + colorSize;
                 glVertexArrayVertexBuffer(_vao, binding, buffer.getVertexInputBuffer(), offset, stride);
             }
 			if constexpr (VIO::normalTrait) {
 				constexpr GLuint binding = VIO::positionTrait + VIO::colorTrait + VIO::texCoordTrait;
-				constexpr GLintptr offset = VIO::positionTrait*sizeof(glm::vec3) + VIO::colorTrait*sizeof(glm::vec3) + VIO::texCoordTrait*sizeof(glm::vec2);
+				constexpr GLintptr offset = positionSize + colorSize + texCoordSize;
 				glVertexArrayVertexBuffer(_vao, binding, buffer.getVertexInputBuffer(), offset, stride);
 			}
 
@@ -248,6 +377,14 @@ namespace game::opengl
 
     private:
 
+        template<class Format>
+        void enable(GLuint binding)
+        {
+            glEnableVertexArrayAttrib(_vao, binding);
+            glVertexArrayAttribFormat(_vao, binding, Format::components, Format::type, Format::normalized, 0);
+            glVertexArrayAttribBinding(_vao, binding, binding);
+        }
+
         GLuint _vao = 0;
     };
 }
\ No newline at end of file
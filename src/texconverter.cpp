@@ -0,0 +1,218 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "application/texfile.hpp"
+#include "converter/mips.hpp"
+#include "converter/bcencode.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+using namespace std;
+
+namespace
+{
+    template<class F>
+    double measure(F&& f)
+    {
+        auto start = chrono::steady_clock::now();
+        f();
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    /*
+     * What the texture constructor costs on the CPU without and with the preprocessed file. The old path also
+     * runs glGenerateTextureMipmap on the driver thread, that is not part of the decode time.
+     */
+
+    void compareLoad(const string& image, const string& tex)
+    {
+        constexpr size_t runs = 10;
+        volatile size_t sink = 0;
+
+        auto decode = measure([&]() {
+            for (size_t r = 0; r < runs; ++r) {
+                int width, height, channels;
+                auto pixels = stbi_load(image.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+                sink = sink + (pixels ? pixels[0] : 0);
+                stbi_image_free(pixels);
+            }
+        });
+
+        // Reads every byte of every level, the same amount of work as the upload does with the mapping
+        auto mapped = measure([&]() {
+            for (size_t r = 0; r < runs; ++r) {
+                game::texfile file(tex);
+                size_t sum = 0;
+                for (size_t i = 0; i < file.levels.size(); ++i) {
+                    auto p = file.pixels(i);
+                    for (size_t j = 0; j < file.levels[i].size; j += 64)
+                        sum += static_cast<unsigned char>(p[j]);
+                }
+                sink = sink + sum;
+            }
+        });
+
+        cout << fixed << setprecision(3) << "load: stbi_load " << decode / runs * 1000.0 << " ms, texfile " << mapped / runs * 1000.0
+            << " ms, " << setprecision(1) << decode / mapped << "x faster" << defaultfloat << endl;
+    }
+
+    struct formatName
+    {
+        string_view name;
+
+        game::texfile::pixelFormat format;
+    };
+
+    constexpr formatName formats[] = {
+        {"rgba8", game::texfile::pixelFormat::rgba8},
+        {"bc1", game::texfile::pixelFormat::bc1},
+        {"bc3", game::texfile::pixelFormat::bc3},
+        {"bc7", game::texfile::pixelFormat::bc7}
+    };
+
+    game::converter::blockFormat toBlockFormat(game::texfile::pixelFormat format)
+    {
+        switch (format) {
+        case game::texfile::pixelFormat::bc1:
+            return game::converter::blockFormat::bc1;
+        case game::texfile::pixelFormat::bc3:
+            return game::converter::blockFormat::bc3;
+        default:
+            return game::converter::blockFormat::bc7;
+        }
+    }
+
+    // Signal to noise ratio of the compressed level against the level it was encoded from, over all four channels
+    double psnr(game::texfile::pixelFormat format, const vector<uint8_t>& blocks, const vector<uint8_t>& rgba, uint32_t width, uint32_t height)
+    {
+        auto decode = format == game::texfile::pixelFormat::bc1 ? game::bc::decodeBC1
+            : format == game::texfile::pixelFormat::bc3 ? game::bc::decodeBC3 : game::bc::decodeBC7;
+        auto columns = (width + 3) / 4;
+        auto size = game::texfile::levelSize(format, 4, 4);
+
+        double error = 0.0;
+        uint8_t texels[64];
+        for (uint32_t y = 0; y < height; ++y) {
+            for (uint32_t x = 0; x < width; ++x) {
+                if (x % 4 == 0)
+                    decode(&blocks[((y/4) * columns + x/4) * size], texels);
+                for (auto c = 0; c < 4; ++c) {
+                    double d = double(texels[((y%4)*4 + x%4)*4 + c]) - rgba[(size_t(y) * width + x) * 4 + c];
+                    error += d*d;
+                }
+            }
+        }
+
+        error /= double(width) * height * 4;
+        return error > 0.0 ? 10.0 * log10(255.0 * 255.0 / error) : 99.0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    ios_base::sync_with_stdio(false);
+
+    vector<const char*> inputs;
+    unsigned threads = game::converter::defaultThreads();
+    bool srgb = true, compare = false;
+    auto format = game::texfile::pixelFormat::rgba8;
+
+    for (auto i = 1; i < argc; ++i) {
+        string_view arg(argv[i]);
+        if (arg == "-j" && i+1 < argc) {
+            threads = static_cast<unsigned>(max(1, atoi(argv[++i])));
+        }
+        else if (arg == "-l") {
+            srgb = false;
+        }
+        else if (arg == "-t") {
+            compare = true;
+        }
+        else if (arg == "-f" && i+1 < argc) {
+            auto f = find_if(begin(formats), end(formats), [&](const formatName& n) { return n.name == argv[i+1]; });
+            if (f == end(formats)) {
+                inputs.clear();
+                break;
+            }
+            format = f->format;
+            ++i;
+        }
+        else if (arg[0] != '-') {
+            inputs.push_back(argv[i]);
+        }
+        else {
+            inputs.clear();
+            break;
+        }
+    }
+
+    if (inputs.empty()) {
+        cout << "Usage: img2tex [-j threads] [-l] [-t] [-f rgba8|bc1|bc3|bc7] <image>..." << endl;
+        cout << "  writes <image>.tex with the full mip chain next to every image, the texture loader prefers it" << endl;
+        cout << "  -l  linear data such as specular maps, color textures are filtered in linear light by default" << endl;
+        cout << "  -t  compare the load time of the image and the texture file" << endl;
+        cout << "  -f  pixel format, bc1 has no alpha, bc3 and bc7 take the same space as bc1 with alpha. Default rgba8" << endl;
+        return 0;
+    }
+
+    for (auto input : inputs) {
+        string name(input);
+        auto outname = name.substr(0, name.find_last_of('.')).append(".tex");
+
+        int width, height, channels;
+        auto pixels = stbi_load(input, &width, &height, &channels, STBI_rgb_alpha);
+        if (!pixels) {
+            cout << name << ": unable to load image" << endl;
+            continue;
+        }
+
+        vector<vector<uint8_t>> levels;
+        auto seconds = measure([&]() {
+            // The base level is stored as loaded, only the generated levels go through the premultiplied float image
+            auto chain = game::converter::buildMips(game::converter::toImage(pixels, width, height, srgb), threads);
+            levels.emplace_back(pixels, pixels + size_t(width) * height * 4);
+            for (size_t i = 1; i < chain.size(); ++i)
+                levels.push_back(game::converter::toBytes(chain[i], srgb));
+        });
+        stbi_image_free(pixels);
+
+        // Block compression works on the finished 8 bit levels so the decoded texels are compared against what rgba8 stores
+        double encodeSeconds = 0.0, quality = 0.0;
+        if (format != game::texfile::pixelFormat::rgba8) {
+            auto blockFormat = toBlockFormat(format);
+            encodeSeconds = measure([&]() {
+                for (size_t i = 0; i < levels.size(); ++i) {
+                    auto w = max(1u, static_cast<uint32_t>(width) >> i), h = max(1u, static_cast<uint32_t>(height) >> i);
+                    auto blocks = game::converter::encodeBlocks(blockFormat, levels[i].data(), w, h, threads);
+                    if (i == 0)
+                        quality = psnr(format, blocks, levels[i], w, h);
+                    levels[i] = move(blocks);
+                }
+            });
+        }
+
+        try {
+            game::texfile::toFile(outname, format, srgb ? uint32_t(game::texfile::srgb) : 0u, width, height, levels);
+        }
+        catch (const std::exception& e) {
+            cout << name << ": " << e.what() << endl;
+            continue;
+        }
+
+        size_t bytes = 0;
+        for (const auto& l : levels)
+            bytes += l.size();
+        cout << name << ": " << width << "x" << height << ", " << levels.size() << " levels, " << bytes << " bytes, mips in "
+            << fixed << setprecision(1) << seconds * 1000.0 << " ms";
+        if (format != game::texfile::pixelFormat::rgba8)
+            cout << ", encoded in " << encodeSeconds * 1000.0 << " ms, " << setprecision(2) << quality << " dB";
+        cout << defaultfloat << endl;
+
+        if (compare)
+            compareLoad(name, outname);
+    }
+    return 0;
+}
\ No newline at end of file